@@ -74,6 +74,9 @@
 #include "src/system/SoC.h"
 #include "src/system/OTA.h"
 #include "src/system/Time.h"
+#include "src/system/Sched.h"
+#include "src/system/Perf.h"
+#include "src/system/LinkQ.h"
 #include "src/driver/LED.h"
 #include "src/driver/GNSS.h"
 #include "src/driver/RF.h"
@@ -87,6 +90,7 @@
 #include "src/protocol/data/GNS5892.h"
 #include "src/protocol/data/NMEA.h"
 #include "src/protocol/data/IGC.h"
+#include "src/protocol/data/Recorder.h"
 #include "src/protocol/data/D1090.h"
 #include "src/driver/WiFi.h"
 #include "src/ui/Web.h"
@@ -114,7 +118,6 @@
 
 #define isTimeToDisplay() (millis() > LEDTimeMarker    + 1000)
 #define isTimeToExport()  (millis() > ExportTimeMarker + 1000)
-#define isTimeToIGC()     (millis() > IGCTimeMarker    + (FLIGHT_LOG_INTERVAL*1000))
 
 ufo_t ThisAircraft;
 
@@ -135,7 +138,50 @@ uint32_t LEDTimeMarker = 0;
 uint32_t ExportTimeMarker = 0;
 uint32_t GNSSTimeMarker = 0;
 uint32_t SetupTimeMarker = 0;
-uint32_t IGCTimeMarker = 0;
+
+/* the periodic part of normal(), run by Sched_run() */
+static bool normal_validfix = false;
+
+static void normal_display()
+{
+  if (normal_validfix) {
+    LED_DisplayTraffic();
+  } else {
+    LED_Clear();
+  }
+}
+
+static void normal_export()
+{
+  PERF_SCOPE(PERF_EXPORT);
+
+  NMEA_Export();
+  GDL90_Export();
+
+  if (normal_validfix) {
+    D1090_Export();
+  }
+}
+
+#if defined(USE_SD_CARD)
+static void normal_flightlog()
+{
+  if (settings->logflight != FLIGHT_LOG_NONE && normal_validfix) {
+    logFlightPosition();
+    if (settings->logflight == FLIGHT_LOG_TRAFFIC)
+      logCloseTraffic();
+  }
+}
+#endif
+
+/* the once-a-second work follows the PPS, where there is one */
+static sched_task_t normal_tasks[] = {
+  SCHED_TASK("display", normal_display,   1000, SCHED_EV_PPS),
+  SCHED_TASK("export",  normal_export,    1000, SCHED_EV_PPS),
+#if defined(USE_SD_CARD)
+  SCHED_TASK("igc",     normal_flightlog, FLIGHT_LOG_INTERVAL*1000, 0),
+#endif
+};
 
 void setup()
 {
@@ -143,6 +189,9 @@ void setup()
 
   hw_info.soc = SoC_setup(); // Has to be very first procedure in the execution order
 
+  Perf_setup();
+  LinkQ_setup();
+
   // ESP32_setup() now initializes the buzzer and strobe pins to avoid early output
 
   resetInfo = (rst_info *) SoC->getResetInfoPtr();
@@ -266,6 +315,8 @@ Serial.println(F("... Baro_setup() returned"));
     SD_setup();
     delay(200);
     FlightLog_setup();
+    if (Geoid_load("/sd/GEOID.BIN"))
+      Serial.println(F("Regional geoid grid loaded"));
   }
 #endif
 
@@ -370,6 +421,14 @@ Serial.println(F("... Baro_setup() returned"));
 //Serial.print(", revision=");
 //Serial.println(hw_info.revision);
 
+  for (size_t i=0; i < sizeof(normal_tasks)/sizeof(normal_tasks[0]); i++)
+    Sched_add(&normal_tasks[i]);
+
+#if defined(USE_RF_TASK)
+  if (settings->mode == SOFTRF_MODE_NORMAL)
+    RF_Task_start();
+#endif
+
   SetupTimeMarker = millis();
 }
 
@@ -437,6 +496,16 @@ void normal()
   bool rx_tried   = false;
   bool rx_success = false;
   bool tx_success = false;
+  static bool tx_queued = false;
+
+  /* the own frame RF_task() had queued: sent, or dropped past TxEndMarker */
+  if (tx_queued) {
+    int sent = RF_Transmit_Result();
+    if (sent >= 0) {
+      tx_success = (sent > 0);
+      tx_queued  = false;
+    }
+  }
 
   Baro_loop();
 
@@ -444,7 +513,10 @@ void normal()
   AHRS_loop();
 #endif /* ENABLE_AHRS */
 
-  GNSS_loop();
+  {
+    PERF_SCOPE(PERF_GNSS);
+    GNSS_loop();
+  }
 
   Time_loop();   /* this is where GNSS time data is processed for Legacy protocol */
 
@@ -599,6 +671,10 @@ void normal()
         time_to_estimate_wind = ThisAircraft.gnsstime_ms + 666;
       }
 
+#if defined(USE_SD_CARD)
+      Recorder_own();
+#endif
+
       /* generate a random aircraft ID if necessary */
       /* doing it here (after some delay) allows use of millis() as seed for random ID */
       if (ThisAircraft.addr == 0)
@@ -618,10 +694,11 @@ void normal()
         //   (this only happens once in 5 or more seconds)
         if (settings->relay != RELAY_ONLY && leap_seconds_valid()) {
           size_t s = RF_Encode(&ThisAircraft);  // returns 0 if implausible data
-          if (s != 0) {
-            RF_Transmit(s, true);
-            // if actually transmitted, time-slot is then locked out
-            if (RF_Transmit_Ready()==false || TxEndMarker==0)
+          if (s != 0 && RF_Transmit(s, true)) {
+            // with the RF task it is only queued, the outcome comes later
+            if (RF_Transmit_Result() < 0)
+              tx_queued = true;
+            else
               tx_success = true;
           }
         }
@@ -654,7 +731,10 @@ void normal()
 #endif
 
   /* process received data - only if we know where we are */
-  if (rx_success && validfix)  ParseData();
+  if (rx_success && validfix) {
+    PERF_SCOPE(PERF_PARSE);
+    ParseData();
+  }
 
 #if defined(ENABLE_TTN)
   TTN_loop();
@@ -662,18 +742,10 @@ void normal()
 
   if (validfix) {
     /* handle the known traffic - only if we know where we are */
+    PERF_SCOPE(PERF_TRAFFIC);
     Traffic_loop();
   }
 
-  if (isTimeToDisplay()) {
-    if (validfix) {
-      LED_DisplayTraffic();
-    } else {
-      LED_Clear();
-    }
-    LEDTimeMarker = millis();
-  }
-
   Buzzer_loop();   /* may sound collision alarms */
 
   Strobe_loop();
@@ -684,29 +756,12 @@ void normal()
 #endif
 #endif
 
-  if (isTimeToExport()) {
-    NMEA_Export();
-    GDL90_Export();
+  /* LED display, exports and flight log, when due */
+  normal_validfix = validfix;
+  Sched_run();
 
-    if (validfix) {
-      D1090_Export();
-    }
-    ExportTimeMarker = millis();
-  }
-
-#if defined(ESP32)
 #if defined(USE_SD_CARD)
-  if (settings->logflight != FLIGHT_LOG_NONE) {
-    if (isTimeToIGC()) {
-      if (validfix) {
-          logFlightPosition();
-          if (settings->logflight == FLIGHT_LOG_TRAFFIC)
-              logCloseTraffic();
-      }
-      IGCTimeMarker = millis();
-    }
-  }
-#endif
+  Recorder_loop();
 #endif
 
   // Handle Air Connect
@@ -999,9 +1054,13 @@ void gpsbridge()
 
 void loop()
 {
+  uint32_t loop_start = perf_cycles();
+
   // Do common RF stuff first
-  if (settings->mode != SOFTRF_MODE_GPSBRIDGE)
+  if (settings->mode != SOFTRF_MODE_GPSBRIDGE) {
+    PERF_SCOPE(PERF_RF);
     RF_loop();
+  }
 
   switch (settings->mode)
   {
@@ -1037,7 +1096,10 @@ void loop()
   }
 
   // Show status info on tiny OLED display
-  SoC->Display_loop();
+  {
+    PERF_SCOPE(PERF_DISPLAY);
+    SoC->Display_loop();
+  }
 
   // battery status LED
   LED_loop();
@@ -1046,7 +1108,10 @@ void loop()
   WiFi_loop();
 
   // Handle Web
-  Web_loop();
+  {
+    PERF_SCOPE(PERF_WEB);
+    Web_loop();
+  }
 
   // Handle OTA update.
   OTA_loop();
@@ -1073,6 +1138,17 @@ void loop()
 
   SoC->Button_loop();
 
+  Perf_add(PERF_LOOP, perf_cycles() - loop_start);
+
+  /*
+   * nothing to do until the next deadline, PPS, or a slice of time - only
+   * while the RF task services the radio, the UARTs are buffered by the core
+   */
+#if defined(USE_RF_TASK)
+  if (settings->mode == SOFTRF_MODE_NORMAL && RF_Task_active())
+    Sched_sleep();
+#endif
+
 #if defined(TAKE_CARE_OF_MILLIS_ROLLOVER)
   /* restart the device when uptime is more than 47 days */
   if (millis() > (47 * 24 * 3600 * 1000UL)) {
@@ -0,0 +1,127 @@
+/*
+ * BenchStubs.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Just enough of the rest of the firmware (and of the Arduino core)
+ * for the traffic and projection code to link on a Linux host,
+ * without bcm2835, a radio or a GNSS module.
+ * Time is virtual and is driven by the bench.
+ * Also the PRNG, clock and usage helpers the benches share.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../SoftRF.h"
+#include "../src/system/SoC.h"
+#include "../src/TrafficHelper.h"
+#include "../src/driver/EEPROM.h"
+#include "../src/driver/RF.h"
+#include "../src/driver/Buzzer.h"
+#include "../src/protocol/data/NMEA.h"
+#include "../src/system/LinkQ.h"
+
+#include "BenchStubs.h"
+
+static settings_t bench_settings;
+settings_t *settings = &bench_settings;
+
+ufo_t ThisAircraft;
+uint32_t GNSSTimeMarker = 0;
+
+char NMEABuffer[NMEA_BUFFER_SIZE];
+
+byte TxBuffer[MAX_PKT_SIZE], RxBuffer[MAX_PKT_SIZE];
+time_t RF_time = 0;
+uint8_t RF_current_slot = 0;
+int8_t RF_last_rssi = 0;
+uint8_t RF_last_fixed = 0;
+bool (*protocol_decode)(void *, ufo_t *, ufo_t *) = NULL;
+
+static uint32_t bench_ms = 0;
+
+void bench_set_millis(uint32_t ms) { bench_ms = ms; }
+
+unsigned int millis() { return bench_ms; }
+unsigned int micros() { return bench_ms * 1000; }
+time_t now()          { return bench_ms / 1000; }
+
+static uint32_t rnd_state = 1;
+
+void rnd_seed(uint32_t seed) { rnd_state = seed ? seed : 1; }
+
+uint32_t rnd()
+{
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+
+float rnd_rangef(float lo, float hi)
+{
+  return lo + (hi - lo) * (float) (rnd() & 0xFFFFFF) * (1.0f / 16777216.0f);
+}
+
+double rnd_range(double lo, double hi)
+{
+  return lo + (hi - lo) * (double) (rnd() & 0xFFFFFF) * (1.0 / 16777216.0);
+}
+
+uint64_t bench_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void bench_usage(const char *prog, const char *args)
+{
+  fprintf(stderr, "usage: %s %s", prog, args);
+  exit(1);
+}
+
+String Bin2Hex(byte *buffer, size_t size)  { return String(""); }
+
+size_t  RF_Encode(ufo_t *fop)                   { return 0; }
+bool    RF_Transmit_Ready()                     { return false; }
+bool    RF_Transmit(size_t size, bool wait)     { return false; }
+int     RF_Transmit_Result()                    { return 1; }
+uint8_t RF_Payload_Size(uint8_t protocol)       { return 0; }
+bool    RF_Queue_Get()                          { return false; }
+
+void LinkQ_Packet(ufo_t *fop)                   { }
+
+bool Buzzer_Notify(int8_t level, bool multi)    { return false; }
+
+/* NMEA output is turned off in the bench settings, these are never reached */
+void NMEA_Outs(bool out1, bool out2, const char *buf, size_t size, bool nl) { }
+unsigned int NMEA_add_checksum() { return strlen(NMEABuffer); }
+void sendPFLAJ() { }
+
+/* console output of the raspi shim, kept off the benchmark report */
+size_t SerialSimulator::print(String s)          { return 0; }
+size_t SerialSimulator::print(const char *s)     { return 0; }
+size_t SerialSimulator::print(unsigned long n)   { return 0; }
+size_t SerialSimulator::print(int n)             { return 0; }
+size_t SerialSimulator::print(unsigned char n, int base) { return 0; }
+size_t SerialSimulator::println(void)            { return 0; }
+size_t SerialSimulator::println(const char *s)   { return 0; }
+size_t SerialSimulator::println(int8_t n)        { return 0; }
@@ -0,0 +1,39 @@
+/*
+ * BenchStubs.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BENCHSTUBS_H
+#define BENCHSTUBS_H
+
+#include <stdint.h>
+
+/* virtual clock behind millis(), micros() and now() */
+void bench_set_millis(uint32_t);
+
+/* deterministic PRNG (xorshift32), so that runs are repeatable */
+void     rnd_seed(uint32_t);
+uint32_t rnd(void);
+float    rnd_rangef(float, float);
+double   rnd_range(double, double);
+
+/* the real, monotonic clock, for the timings */
+uint64_t bench_ns(void);
+
+/* "usage: <prog> <args>", then exit(1) */
+void     bench_usage(const char *, const char *);
+
+#endif /* BENCHSTUBS_H */
@@ -0,0 +1,339 @@
+/*
+ * D1090Bench.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host-side benchmark of the dump1090 aircraft.json intake.
+ *
+ * Writes a synthetic aircraft.json, as dump1090 would near a busy
+ * airport, and times two ways of taking it in:
+ *   "document"  deserializeJson() into a JSON_BUFFER_SIZE document, then
+ *               the array, the loops and the store logic of parseD1090()
+ *               (copied here, as JSON.cpp is built for the ArduinoJson 5
+ *               API): Traffic_Update(), and a slot that is free, expired,
+ *               or already has the same address over ADS-B;
+ *   "stream"    parseD1090_stream(), which ends in AddTraffic().
+ * Before timing, both are run once without an own position, so with
+ * nothing filtered, and the traffic stores they leave are compared.  They
+ * match only while all of the aircraft fit in MAX_TRACKING_OBJECTS: past
+ * that parseD1090() keeps those it saw first, AddTraffic() the nearest.
+ *
+ *   make bench
+ *   ./d1090-bench -n 100 -i 200
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <TimeLib.h>
+#include <TinyGPS++.h>
+
+#include "../SoftRF.h"
+#include "../src/system/SoC.h"
+#include "../src/TrafficHelper.h"
+#include "../src/TrafficStore.h"
+#include "../src/driver/EEPROM.h"
+#include "../src/protocol/radio/Legacy.h"
+#include "../src/protocol/data/JSON.h"
+
+#include "BenchStubs.h"
+
+#define BENCH_LAT0          46.0f
+#define BENCH_LON0          8.0f
+#define BENCH_ALT0          1500.0f
+#define BENCH_SPAN          1.0f        /* degrees around the origin */
+#define BENCH_MAX_AIRCRAFT  2000
+#define BENCH_BYTES_PER_AC  320
+
+static int      count      = 100;
+static int      iterations = 200;
+static uint32_t seed       = 1;
+
+static char    *json;
+static size_t   json_len;
+static int      in_range;
+
+static StaticJsonDocument<JSON_BUFFER_SIZE> bench_doc;
+
+/* aircraft.json with the fields of dump1090 1.x, some without a position */
+static void json_make()
+{
+  size_t size = 128 + (size_t) count * BENCH_BYTES_PER_AC;
+  char *p;
+
+  json = (char *) malloc(size);
+  if (json == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  p = json;
+  p += sprintf(p, "{ \"now\" : 1700000000.1,\n  \"messages\" : 48170341,\n"
+                  "  \"aircraft\" : [\n");
+
+  rnd_seed(seed);
+  in_range  = 0;
+
+  for (int i=0; i < count; i++) {
+    uint32_t addr  = 0x300000 + (rnd() & 0x0FFFFF);
+    bool     tisb  = (rnd() % 20) == 0;
+    bool     haspos = (rnd() % 10) != 0;
+    bool     ground = (rnd() % 30) == 0;
+    float    lat   = BENCH_LAT0 + rnd_rangef(-BENCH_SPAN, BENCH_SPAN);
+    float    lon   = BENCH_LON0 + rnd_rangef(-BENCH_SPAN, BENCH_SPAN);
+    int      alt   = (int) rnd_rangef(500, 41000);
+
+    p += sprintf(p, "    {\"hex\":\"%s%06x\",\"squawk\":\"%04o\",\"flight\":\"BNC%04d \",",
+                 tisb ? "~" : "", addr, rnd() & 07777, i);
+    if (haspos)
+      p += sprintf(p, "\"lat\":%.6f,\"lon\":%.6f,\"nucp\":7,\"seen_pos\":%.1f,",
+                   lat, lon, rnd_rangef(0, 30));
+    if (ground)
+      p += sprintf(p, "\"altitude\":\"ground\",");
+    else
+      p += sprintf(p, "\"altitude\":%d,\"vert_rate\":%d,", alt,
+                   (int) rnd_rangef(-2000, 2000));
+    p += sprintf(p, "\"track\":%d,\"speed\":%d,\"category\":\"A3\","
+                    "\"mlat\":[],\"tisb\":[],\"messages\":%u,\"seen\":%.1f,"
+                    "\"rssi\":%.1f}%s\n",
+                 (int) rnd_rangef(0, 360), (int) rnd_rangef(60, 480),
+                 rnd() % 100000, rnd_rangef(0, 60), rnd_rangef(-35, -3),
+                 i + 1 < count ? "," : "");
+
+    float dy = (lat - BENCH_LAT0) * 111300.0f;
+    float dx = (lon - BENCH_LON0) * 111300.0f * 0.6947f;
+    if (haspos && !ground && dx * dx + dy * dy < 30000.0f * 30000.0f &&
+        fabsf(alt / 3.28084f - BENCH_ALT0) < D1090_MAX_ALT_DIFF)
+      in_range++;
+  }
+  p += sprintf(p, "  ]\n}\n");
+  json_len = p - json;
+}
+
+/* parseD1090() of JSON.cpp, on the ArduinoJson 6 API; -1 if the document overflows */
+static int d1090_document(const char *str)
+{
+  if (deserializeJson(bench_doc, str) != DeserializationError::Ok)
+    return -1;
+
+  JsonObject root = bench_doc.as<JsonObject>();
+  if (!root.containsKey("now") || !root.containsKey("messages") ||
+      !root.containsKey("aircraft"))
+    return -1;
+
+  JsonArray aircraft = root["aircraft"];
+  int size = aircraft.size();
+  time_t timestamp = now();
+
+  dump1090_aircraft_t *aircraft_array = (dump1090_aircraft_t *)
+                    malloc(sizeof(dump1090_aircraft_t) * size);
+  if (aircraft_array == NULL)
+    return -1;
+
+  for (int i=0; i < size; i++) {
+    JsonObject aircraft_obj = aircraft[i];
+
+    aircraft_array[i].hex = aircraft_obj["hex"];
+    aircraft_array[i].squawk = aircraft_obj["squawk"];
+    aircraft_array[i].flight = aircraft_obj["flight"];
+    aircraft_array[i].lat = aircraft_obj["lat"];
+    aircraft_array[i].lon = aircraft_obj["lon"];
+    aircraft_array[i].nucp = aircraft_obj["nucp"];
+    aircraft_array[i].seen_pos = aircraft_obj["seen_pos"];
+    aircraft_array[i].altitude = aircraft_obj["altitude"];
+    aircraft_array[i].vert_rate = aircraft_obj["vert_rate"];
+    aircraft_array[i].track = aircraft_obj["track"];
+    aircraft_array[i].speed = aircraft_obj["speed"];
+    aircraft_array[i].messages = aircraft_obj["messages"];
+    aircraft_array[i].seen = aircraft_obj["seen"];
+    aircraft_array[i].rssi = aircraft_obj["rssi"];
+  }
+
+  for (int i=0; i < size; i++) {
+    if (aircraft_array[i].hex &&
+        aircraft_array[i].lat != 0.0 &&
+        aircraft_array[i].lon != 0.0 &&
+        aircraft_array[i].altitude != 0.0) {
+
+      fo = EmptyFO;
+      memset(fo.raw, 0, sizeof(fo.raw));
+      fo.timestamp = timestamp;
+      fo.protocol = RF_PROTOCOL_ADSB_1090;
+
+      if (aircraft_array[i].hex[0] == '~') {
+        fo.addr = strtoul (&aircraft_array[i].hex[1], NULL, 16);
+        fo.addr_type = ADDR_TYPE_ANONYMOUS;
+      } else {
+        fo.addr = strtoul (&aircraft_array[i].hex[0], NULL, 16);
+        fo.addr_type = ADDR_TYPE_ICAO;
+      }
+
+      fo.latitude = aircraft_array[i].lat;
+      fo.longitude = aircraft_array[i].lon;
+      fo.pressure_altitude = aircraft_array[i].altitude / _GPS_FEET_PER_METER;
+      fo.altitude = fo.pressure_altitude;
+      fo.course = aircraft_array[i].track;
+      fo.speed = aircraft_array[i].speed;
+      fo.aircraft_type = AIRCRAFT_TYPE_JET;
+      fo.vs = aircraft_array[i].vert_rate;
+      fo.stealth = false;
+      fo.no_track = false;
+      fo.rssi = aircraft_array[i].rssi;
+
+      Traffic_Update(&fo);
+
+      int j = TrafficStore_Find(fo.addr);
+      if (j >= 0) {
+        if (Container[j].protocol == fo.protocol ||
+            timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
+          Container[j] = fo;
+          TrafficStore_Commit(j);
+        }
+        continue;
+      }
+
+      j = TrafficStore_Alloc();
+      if (j < 0) {
+        j = TrafficStore_Oldest();
+        if (j >= 0 && timestamp - Container[j].timestamp <= ENTRY_EXPIRATION_TIME)
+          j = -1;
+      }
+
+      if (j >= 0) {
+        Container[j] = fo;
+        TrafficStore_Commit(j);
+      }
+    }
+  }
+
+  free(aircraft_array);
+  return size;
+}
+
+/* order-independent digest of what is in the traffic store */
+static uint32_t store_digest()
+{
+  uint32_t digest = 0;
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    if (Container[i].addr == 0)
+      continue;
+    uint32_t h = Container[i].addr * 2654435761u;
+    h ^= (uint32_t) (int32_t) (Container[i].latitude  * 1e5) * 40503u;
+    h ^= (uint32_t) (int32_t) (Container[i].longitude * 1e5) * 2246822519u;
+    h ^= (uint32_t) (int32_t) Container[i].altitude;
+    digest += h;
+  }
+  return digest;
+}
+
+static void store_clear()
+{
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++)
+    Container[i] = EmptyFO;
+  Traffic_setup();
+}
+
+static void own_at(float lat, float lon)
+{
+  ThisAircraft = EmptyFO;
+  ThisAircraft.latitude  = lat;
+  ThisAircraft.longitude = lon;
+  ThisAircraft.altitude  = BENCH_ALT0;
+  ThisAircraft.timestamp = now();
+}
+
+static const char usage_args[] = "[-n aircraft] [-i iterations] [-r seed]\n";
+
+int main(int argc, char *argv[])
+{
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:i:r:h")) != -1) {
+    switch (opt)
+    {
+    case 'n':  count      = atoi(optarg);            break;
+    case 'i':  iterations = atoi(optarg);            break;
+    case 'r':  seed       = strtoul(optarg, NULL, 0); break;
+    default:
+      bench_usage(argv[0], usage_args);
+    }
+  }
+  if (count < 1 || count > BENCH_MAX_AIRCRAFT || iterations < 1)
+    bench_usage(argv[0], usage_args);
+
+  memset(settings, 0, sizeof(settings_t));
+  settings->rf_protocol = RF_PROTOCOL_LATEST;
+  settings->relay       = RELAY_OFF;
+  GNSSTimeMarker        = 1;
+
+  bench_set_millis(1700000000UL % 100000 * 1000);
+  json_make();
+
+  printf("aircraft.json: %d aircraft, %u bytes, %d within %d m and %d m of altitude\n"
+         "JSON_BUFFER_SIZE %d, MAX_TRACKING_OBJECTS %d\n\n",
+         count, (unsigned) json_len, in_range, D1090_MAX_RANGE,
+         D1090_MAX_ALT_DIFF, JSON_BUFFER_SIZE, MAX_TRACKING_OBJECTS);
+
+  /* same result with nothing filtered out */
+  own_at(0, 0);
+  store_clear();
+  bool doc_ok = d1090_document(json) >= 0;
+  uint32_t doc_digest = store_digest();
+
+  store_clear();
+  bool stream_ok = parseD1090_stream(json);
+  uint32_t stream_digest = store_digest();
+
+  if (!doc_ok)
+    printf("document: does not fit in JSON_BUFFER_SIZE, aircraft.json is lost\n");
+  else
+    printf("store digests, unfiltered: document %08x, stream %08x, %s\n",
+           doc_digest, stream_digest,
+           doc_digest == stream_digest ? "same" : "DIFFERENT");
+  if (doc_ok && count > MAX_TRACKING_OBJECTS)
+    printf("  store full: parseD1090() keeps the first, AddTraffic() the nearest\n");
+  if (!stream_ok)
+    printf("stream: not taken as aircraft.json\n");
+
+  /* timing, with the own position at the center */
+  own_at(BENCH_LAT0, BENCH_LON0);
+
+  printf("\n%-10s %12s %12s\n", "path", "us/file", "ns/aircraft");
+
+  if (doc_ok) {
+    store_clear();
+    uint64_t t0 = bench_ns();
+    for (int i=0; i < iterations; i++)
+      d1090_document(json);
+    double us = (bench_ns() - t0) / 1000.0 / iterations;
+    printf("%-10s %12.1f %12.1f\n", "document", us, us * 1000.0 / count);
+  }
+
+  store_clear();
+  uint64_t t0 = bench_ns();
+  for (int i=0; i < iterations; i++)
+    parseD1090_stream(json);
+  double us = (bench_ns() - t0) / 1000.0 / iterations;
+  printf("%-10s %12.1f %12.1f\n", "stream", us, us * 1000.0 / count);
+
+  free(json);
+
+  return 0;
+}
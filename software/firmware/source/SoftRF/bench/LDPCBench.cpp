@@ -0,0 +1,141 @@
+/*
+ * LDPCBench.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host-side round trip of the OGNTP LDPC correction.
+ *
+ * Random 20-byte payloads are LDPC_Encode()d, damaged and handed to
+ * ogntp_ldpc_correct().  Per row: frames recovered to the original,
+ * miscorrected into another valid frame, and dropped.
+ *   flips     random hard bit errors, as from the sx12xx
+ *   erasures  bits marked invalid, half of them wrong, as from the
+ *             software Manchester decoders
+ * Then random noise frames, which must not be accepted.
+ *
+ *   make bench
+ *   ./ldpc-bench -n 2000 -x 200000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "../SoftRF.h"
+#include "../src/driver/RF.h"
+#include "../src/protocol/radio/OGNTP.h"
+
+#include "BenchStubs.h"
+
+#define CODE_BYTES  LDPC_Decoder::CodeBytes
+#define CODE_BITS   (CODE_BYTES * 8)
+
+static int      frames  = 2000;
+static int      noise   = 200000;
+static uint32_t seed    = 1;
+
+static void frame_make(uint8_t *frame)
+{
+  for (int i=0; i < OGNTP_PAYLOAD_SIZE; i++)
+    frame[i] = rnd();
+  LDPC_Encode(frame);
+}
+
+/* n distinct bits of a code word */
+static void bits_pick(uint8_t *mask, int n)
+{
+  memset(mask, 0, CODE_BYTES);
+  while (n > 0) {
+    int b = rnd() % CODE_BITS;
+    if (mask[b >> 3] & (1 << (b & 7)))
+      continue;
+    mask[b >> 3] |= 1 << (b & 7);
+    n--;
+  }
+}
+
+static void row(const char *name, int n, bool erase)
+{
+  uint8_t sent[CODE_BYTES], frame[CODE_BYTES], mask[CODE_BYTES];
+  int recovered = 0, wrong = 0, lost = 0;
+
+  uint64_t t0 = bench_ns();
+  for (int f=0; f < frames; f++) {
+    frame_make(sent);
+    bits_pick(mask, n);
+    for (int i=0; i < CODE_BYTES; i++)
+      frame[i] = sent[i] ^ (erase ? (mask[i] & rnd()) : mask[i]);
+
+    if (ogntp_ldpc_correct(frame, erase ? mask : NULL) < 0)
+      lost++;
+    else if (memcmp(frame, sent, CODE_BYTES) == 0)
+      recovered++;
+    else
+      wrong++;
+  }
+  double us = (bench_ns() - t0) / 1000.0 / frames;
+
+  printf("%-9s %3d %10.2f%% %10.3f%% %8.2f%% %8.1f\n", name, n,
+         100.0 * recovered / frames, 100.0 * wrong / frames,
+         100.0 * lost / frames, us);
+}
+
+static const char usage_args[] = "[-n frames] [-x noise frames] [-r seed]\n";
+
+int main(int argc, char *argv[])
+{
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:x:r:h")) != -1) {
+    switch (opt)
+    {
+    case 'n':  frames = atoi(optarg);             break;
+    case 'x':  noise  = atoi(optarg);             break;
+    case 'r':  seed   = strtoul(optarg, NULL, 0); break;
+    default:
+      bench_usage(argv[0], usage_args);
+    }
+  }
+  if (frames < 1 || noise < 0)
+    bench_usage(argv[0], usage_args);
+
+  rnd_seed(seed);
+
+  printf("%d frames per row, OGNTP_LDPC_ITER %d, OGNTP_LDPC_MAX_COST %d\n\n",
+         frames, OGNTP_LDPC_ITER, OGNTP_LDPC_MAX_COST);
+  printf("%-9s %3s %11s %11s %9s %8s\n",
+         "damage", "n", "recovered", "miscorr.", "dropped", "us/frame");
+
+  for (int n=1; n <= 6; n++)
+    row("flips", n, false);
+  for (int n=4; n <= 16; n += 4)
+    row("erasures", n, true);
+
+  int accepted = 0;
+  uint8_t frame[CODE_BYTES];
+
+  for (int f=0; f < noise; f++) {
+    for (int i=0; i < CODE_BYTES; i++)
+      frame[i] = rnd();
+    if (LDPC_Check(frame) == 0 || ogntp_ldpc_correct(frame, NULL) >= 0)
+      accepted++;
+  }
+  printf("\nnoise: %d of %d random frames accepted\n", accepted, noise);
+
+  return 0;
+}
@@ -0,0 +1,290 @@
+/*
+ * MathBench.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Accuracy and throughput of the ApproxMath functions against libm.
+ *
+ *   make bench [BENCH_FIXED=1]
+ *   ./math-bench [-n samples] [-r rounds] [-m cpu_mhz]
+ *
+ * With BENCH_FIXED=1 the float API runs on the fixed-point kernels,
+ * as it does on SoCs without an FPU.  Errors are absolute, in the unit
+ * given, or relative for the hypotenuse and reciprocal.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "../src/ApproxMath.h"
+
+#include "BenchStubs.h"
+
+#define RAD2DEG     (180.0 / M_PI)
+#define DEG2RAD     (M_PI / 180.0)
+
+static int      samples = 4096;
+static int      rounds  = 200;
+static float    cpu_mhz = 0.0f;
+
+static float    *fa, *fb;           /* float arguments */
+static int32_t  *ia, *ib;           /* the same, as integers */
+static volatile float    fsink;
+static volatile int32_t  isink;
+
+typedef struct math_err_struct {
+  double max;
+  double sum2;
+  int    n;
+} math_err_t;
+
+static void err_add(math_err_t *ep, double e)
+{
+  e = fabs(e);
+  if (e > ep->max)
+    ep->max = e;
+  ep->sum2 += e * e;
+  ++ep->n;
+}
+
+/* angles in degrees, folded into -180...180 */
+static double angle_diff(double a, double b)
+{
+  double d = fmod(a - b, 360.0);
+  if (d >  180.0)  d -= 360.0;
+  if (d < -180.0)  d += 360.0;
+  return d;
+}
+
+static void row(const char *name, const char *unit, math_err_t *ep, uint64_t ns)
+{
+  double per_call = (double) ns / ((double) samples * rounds);
+  char cycles[16] = "-";
+  if (cpu_mhz > 0)
+    snprintf(cycles, sizeof(cycles), "%.0f", per_call * cpu_mhz / 1000.0);
+  if (ep)
+    printf("%-22s %-5s %12.3g %12.3g %9.2f %8s\n", name, unit,
+           ep->max, sqrt(ep->sum2 / ep->n), per_call, cycles);
+  else
+    printf("%-22s %-5s %12s %12s %9.2f %8s\n", name, "", "-", "-", per_call, cycles);
+}
+
+/* time one expression over all samples, "rounds" times */
+#define TIME_F(expr)                                       \
+  do {                                                     \
+    float acc = 0;                                         \
+    uint64_t t0 = bench_ns();                              \
+    for (int r=0; r < rounds; r++)                         \
+      for (int i=0; i < samples; i++)                      \
+        acc += (expr);                                     \
+    ns = bench_ns() - t0;                                  \
+    fsink = acc;                                           \
+  } while (0)
+
+#define TIME_I(expr)                                       \
+  do {                                                     \
+    int32_t acc = 0;                                       \
+    uint64_t t0 = bench_ns();                              \
+    for (int r=0; r < rounds; r++)                         \
+      for (int i=0; i < samples; i++)                      \
+        acc += (expr);                                     \
+    ns = bench_ns() - t0;                                  \
+    isink = acc;                                           \
+  } while (0)
+
+static void bench_sin()
+{
+  math_err_t e1 = {0}, e2 = {0};
+  uint64_t ns;
+
+  for (int i=0; i < samples; i++) {
+    fa[i] = rnd_range(-360.0, 360.0);
+    ia[i] = (int32_t) lrint(fa[i] * 65536.0);             /* q16_t degrees */
+  }
+  for (int i=0; i < samples; i++) {
+    double ref = sin(fa[i] * DEG2RAD);
+    err_add(&e1, sin_approx(fa[i]) - ref);
+    err_add(&e2, isin_q15(QDEG_TO_BAM(ia[i])) / (double) Q15_ONE - ref);
+  }
+
+  TIME_F(sinf(fa[i] * (float) DEG2RAD));
+  row("sinf", "", NULL, ns);
+  TIME_F(sin_approx(fa[i]));
+  row("sin_approx", "", &e1, ns);
+  TIME_I(isin_q15(QDEG_TO_BAM(ia[i])));
+  row("isin_q15", "", &e2, ns);
+}
+
+static void bench_atan2()
+{
+  math_err_t e1 = {0}, e2 = {0}, e3 = {0};
+  uint64_t ns;
+
+  for (int i=0; i < samples; i++) {
+    fa[i] = rnd_range(-20000.0, 20000.0);                 /* meters */
+    fb[i] = rnd_range(-20000.0, 20000.0);
+    ia[i] = (int32_t) lrint(fa[i]);
+    ib[i] = (int32_t) lrint(fb[i]);
+  }
+  for (int i=0; i < samples; i++) {
+    /* clockwise from North, arguments (ns, ew) as in ApproxMath */
+    double ref  = atan2(fb[i], fa[i]) * RAD2DEG;
+    double iref = atan2((double) ib[i], (double) ia[i]) * RAD2DEG;
+    err_add(&e1, angle_diff(atan2_approx(fa[i], fb[i]), ref));
+    err_add(&e2, angle_diff(iatan2_approx(ia[i], ib[i]), iref));
+    err_add(&e3, angle_diff(iatan2_bam(ia[i], ib[i]) * (360.0 / 65536.0), iref));
+  }
+
+  TIME_F(atan2f(fb[i], fa[i]));
+  row("atan2f", "", NULL, ns);
+  TIME_F(atan2_approx(fa[i], fb[i]));
+  row("atan2_approx", "deg", &e1, ns);
+  TIME_I(iatan2_approx(ia[i], ib[i]));
+  row("iatan2_approx", "deg", &e2, ns);
+  TIME_I(iatan2_bam(ia[i], ib[i]));
+  row("iatan2_bam", "deg", &e3, ns);
+}
+
+static void bench_hypot()
+{
+  math_err_t e1 = {0}, e2 = {0}, e3 = {0};
+  uint64_t ns;
+
+  for (int i=0; i < samples; i++) {
+    fa[i] = rnd_range(-20000.0, 20000.0);
+    fb[i] = rnd_range(-20000.0, 20000.0);
+    ia[i] = (int32_t) lrint(fa[i]);
+    ib[i] = (int32_t) lrint(fb[i]);
+  }
+  for (int i=0; i < samples; i++) {
+    double ref  = hypot(fa[i], fb[i]);
+    double iref = hypot((double) ia[i], (double) ib[i]);
+    err_add(&e1, approxHypotenuse(fa[i], fb[i]) / ref - 1.0);
+    err_add(&e2, iapproxHypotenuse1(ia[i], ib[i]) / iref - 1.0);
+    err_add(&e3, iapproxHypotenuse0(ia[i], ib[i]) / iref - 1.0);
+  }
+
+  TIME_F(hypotf(fa[i], fb[i]));
+  row("hypotf", "", NULL, ns);
+  TIME_F(sqrtf(fa[i] * fa[i] + fb[i] * fb[i]));
+  row("sqrtf", "", NULL, ns);
+  TIME_F(approxHypotenuse(fa[i], fb[i]));
+  row("approxHypotenuse", "rel", &e1, ns);
+  TIME_I(iapproxHypotenuse1(ia[i], ib[i]));
+  row("iapproxHypotenuse1", "rel", &e2, ns);
+  TIME_I(iapproxHypotenuse0(ia[i], ib[i]));
+  row("iapproxHypotenuse0", "rel", &e3, ns);
+}
+
+static void bench_recip()
+{
+  math_err_t e1 = {0}, e2 = {0};
+  uint64_t ns;
+
+  for (int i=0; i < samples; i++) {
+    fa[i] = rnd_range(0.01, 100.0) * ((rnd() & 1) ? 1 : -1);
+    fb[i] = rnd_range(0.0, 20000.0);                      /* meters */
+    ia[i] = (int32_t) lrint(fa[i] * Q16_ONE);
+  }
+  for (int i=0; i < samples; i++) {
+    double ref = Q16_ONE / (double) ia[i];
+    err_add(&e1, irecip_q16(ia[i]) / (double) Q16_ONE / ref - 1.0);
+    if (fb[i] != 0.0f)
+      err_add(&e2, div_approx(fb[i], fa[i]) / ((double) fb[i] / fa[i]) - 1.0);
+  }
+
+  TIME_F(1.0f / fa[i]);
+  row("1.0f / x", "", NULL, ns);
+  TIME_I(irecip_q16(ia[i]));
+  row("irecip_q16", "rel", &e1, ns);
+  TIME_F(div_approx(fb[i], fa[i]));
+  row("div_approx", "rel", &e2, ns);
+}
+
+static void bench_coslat()
+{
+  math_err_t e1 = {0}, e2 = {0};
+  uint64_t ns;
+
+  /* a slow drift, so that the cache in CosLat() is exercised as in flight */
+  double lat = -60.0;
+  for (int i=0; i < samples; i++) {
+    lat += 120.0 / samples;
+    fa[i] = lat;
+    ia[i] = (int32_t) lrint(lat * Q16_ONE);
+  }
+  for (int i=0; i < samples; i++) {
+    double ref = cos(fa[i] * DEG2RAD);
+    err_add(&e1, CosLat(fa[i]) - ref);
+    err_add(&e2, iCosLat(ia[i]) / (double) Q15_ONE - ref);
+  }
+
+  TIME_F(cosf(fa[i] * (float) DEG2RAD));
+  row("cosf", "", NULL, ns);
+  TIME_F(CosLat(fa[i]));
+  row("CosLat", "", &e1, ns);
+  TIME_I(iCosLat(ia[i]));
+  row("iCosLat", "", &e2, ns);
+}
+
+static const char usage_args[] = "[-n samples] [-r rounds] [-m cpu_mhz]\n";
+
+int main(int argc, char *argv[])
+{
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:r:m:h")) != -1) {
+    switch (opt)
+    {
+    case 'n':  samples = atoi(optarg);  break;
+    case 'r':  rounds  = atoi(optarg);  break;
+    case 'm':  cpu_mhz = atof(optarg);  break;
+    default:
+      bench_usage(argv[0], usage_args);
+    }
+  }
+  if (samples < 1 || rounds < 1)
+    bench_usage(argv[0], usage_args);
+
+  fa = (float *)   malloc(samples * sizeof(float));
+  fb = (float *)   malloc(samples * sizeof(float));
+  ia = (int32_t *) malloc(samples * sizeof(int32_t));
+  ib = (int32_t *) malloc(samples * sizeof(int32_t));
+
+#if defined(APPROX_FIXED_POINT)
+  printf("float API on fixed-point kernels (APPROX_FIXED_POINT)\n");
+#else
+  printf("float API in floating point\n");
+#endif
+  printf("%d samples x %d rounds, errors against libm in double\n\n", samples, rounds);
+  printf("%-22s %-5s %12s %12s %9s %8s\n",
+         "", "unit", "max err", "rms err", "ns/call", "cycles");
+
+  bench_sin();
+  bench_atan2();
+  bench_hypot();
+  bench_recip();
+  bench_coslat();
+
+  free(fa);  free(fb);
+  free(ia);  free(ib);
+
+  return 0;
+}
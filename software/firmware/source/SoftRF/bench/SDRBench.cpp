@@ -0,0 +1,494 @@
+/*
+ * SDRBench.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host-side benchmark of the SDR ingest of the Raspberry Pi build.
+ *
+ * Writes synthetic 8-bit I/Q, as rtl_sdr would: on 1090 MHz, aircraft
+ * sending DF17 positions, velocity and identification, one frame in four
+ * with a bad bit; on 978 MHz, UAT long ADS-B frames, one in four with
+ * bytes for the FEC to fix.  Then runs SDR_setup() ... SDR_loop() on both
+ * and reports the frames and the AddTraffic() calls against what was
+ * sent, and the speed against real time.  With -p the I/Q goes through a
+ * FIFO at the real sample rate, as from rtl_sdr, and the latency from
+ * the samples to AddTraffic() is the one to expect on the air.
+ *
+ *   make bench
+ *   ./sdr-bench -s 10 -n 40 [-p]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <TimeLib.h>
+#include <TinyGPS++.h>
+#include <adsb_encoder.h>
+#include <uat.h>
+#include <fec/rs.h>
+
+#include "../SoftRF.h"
+#include "../src/system/SoC.h"
+#include "../src/system/SDR.h"
+#include "../src/TrafficHelper.h"
+#include "../src/driver/EEPROM.h"
+#include "../src/protocol/radio/Legacy.h"
+#include "../src/protocol/data/GDL90.h"
+#include "../src/protocol/data/JSON.h"
+
+#include "BenchStubs.h"
+
+#define BENCH_LAT0          46.0
+#define BENCH_LON0          8.0
+#define BENCH_ALT0          1500.0f
+#define BENCH_RADIUS        20000.0     /* m, inside D1090_MAX_RANGE */
+#define BENCH_MAX_AIRCRAFT  500
+
+#define ES_RATE             2000000
+#define ES_FRAME_SAMPLES    ((8 + 112) * 2)
+#define UAT_RATE            2083334
+#define UAT_SYNC_WORD       0xEACDDA4E2ULL
+#define UAT_SYNC_BITS       36
+#define UAT_FRAME_SAMPLES   ((UAT_SYNC_BITS + LONG_FRAME_BITS) * 2)
+#define UAT_DATA_BYTES      (LONG_FRAME_BYTES - 14)
+#define SLOT_SAMPLES        1024        /* one frame at most in each */
+
+#define FIFO_CHUNK_MS       4
+
+typedef struct bench_aircraft_struct {
+  uint32_t  addr;
+  double    lat;
+  double    lon;
+  double    alt_ft;
+  double    ns_kt;
+  double    ew_kt;
+  double    vs_fpm;
+  bool      uat;
+} bench_aircraft_t;
+
+typedef struct bench_band_struct {
+  const char *name;
+  uint32_t    rate;
+  char        path[64];
+  uint8_t    *iq;
+  size_t      len;
+  uint32_t    sent;                     /* frames */
+  uint32_t    damaged;
+  uint32_t    positions;                /* that should reach AddTraffic() */
+  uint64_t    done_ns;
+} bench_band_t;
+
+static int      seconds = 10;
+static int      count   = 40;
+static bool     paced   = false;
+static uint32_t seed    = 1;
+
+static bench_aircraft_t aircraft[BENCH_MAX_AIRCRAFT];
+static bench_band_t     band[SDR_BAND_COUNT] = {
+  { "1090", ES_RATE  },
+  { "978",  UAT_RATE },
+};
+static void *rs_long;
+
+/* as in GDL90.cpp, which brings the rest of the outputs along */
+const uint8_t gdl90_to_aircraft_type[] PROGMEM = {
+  AIRCRAFT_TYPE_UNKNOWN,    AIRCRAFT_TYPE_POWERED,  AIRCRAFT_TYPE_POWERED,
+  AIRCRAFT_TYPE_JET,        AIRCRAFT_TYPE_JET,      AIRCRAFT_TYPE_JET,
+  AIRCRAFT_TYPE_POWERED,    AIRCRAFT_TYPE_HELICOPTER, AIRCRAFT_TYPE_RESERVED,
+  AIRCRAFT_TYPE_GLIDER,     AIRCRAFT_TYPE_BALLOON,  AIRCRAFT_TYPE_PARACHUTE,
+  AIRCRAFT_TYPE_HANGGLIDER, AIRCRAFT_TYPE_RESERVED, AIRCRAFT_TYPE_UAV,
+  AIRCRAFT_TYPE_RESERVED
+};
+
+bool isValidGNSSFix() { return true; }
+bool hasValidGPSDFix = false;
+
+static inline uint8_t clamp(int v)
+{
+  return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/* small noise, roughly gaussian */
+static inline int noise()
+{
+  return (int) (rnd() % 5) + (int) (rnd() % 5) - 4;
+}
+
+/* a free slot of the second, so that frames never overlap */
+static size_t slot_take(uint8_t *used, int slots)
+{
+  int s = rnd() % slots;
+
+  while (used[s])
+    s = (s + 1) % slots;
+  used[s] = 1;
+  return (size_t) s * SLOT_SAMPLES + rnd() % (SLOT_SAMPLES / 8);
+}
+
+/* PPM pulses of a DF17 frame, 2 samples per bit, at a random carrier phase */
+static void es_put(uint8_t *iq, unsigned char *msg)
+{
+  static const int preamble[16] = {1,0,1,0,0,0,0,1,0,1,0,0,0,0,0,0};
+  double phase = rnd_range(0, 2 * M_PI);
+  int a = 30 + rnd() % 90;
+  int ci = (int) (a * cos(phase)), cq = (int) (a * sin(phase));
+
+  for (int k = 0; k < ES_FRAME_SAMPLES; k++) {
+    int on;
+
+    if (k < 16) {
+      on = preamble[k];
+    } else {
+      int b = (k - 16) / 2;
+      int one = (msg[b / 8] >> (7 - (b % 8))) & 1;
+      on = ((k - 16) & 1) ? !one : one;
+    }
+    if (on) {
+      iq[2*k]   = clamp(127 + ci + noise());
+      iq[2*k+1] = clamp(127 + cq + noise());
+    }
+  }
+}
+
+static void es_frame(bench_band_t *bp, uint8_t *used, int slots,
+                     size_t second, frame_data_t f)
+{
+  if (rnd() % 4 == 0) {
+    int b = 5 + rnd() % (112 - 5);      /* not the DF */
+    f.msg[b / 8] ^= 1 << (7 - (b % 8));
+    bp->damaged++;
+  }
+  es_put(bp->iq + 2 * (second * bp->rate + slot_take(used, slots)), f.msg);
+  bp->sent++;
+}
+
+#include <fec/char.h>
+#include <fec/rs-common.h>
+
+/* the UAT long ADS-B frame of an aircraft: HDR and SV, and the RS parity */
+static void uat_payload(const bench_aircraft_t *ap, uint8_t *frame)
+{
+  uint32_t raw_lat = (uint32_t) lround(ap->lat / 360.0 * 16777216.0) & 0x7FFFFF;
+  uint32_t raw_lon = (uint32_t) lround(ap->lon / 360.0 * 16777216.0) & 0xFFFFFF;
+  uint32_t raw_alt = (uint32_t) lround((ap->alt_ft + 1000.0) / 25.0) + 1;
+
+  memset(frame, 0, LONG_FRAME_BYTES);
+  frame[0]  = 1 << 3;                   /* MDB type 1, ADS-B with ICAO address */
+  frame[1]  = ap->addr >> 16;
+  frame[2]  = ap->addr >> 8;
+  frame[3]  = ap->addr;
+  frame[4]  = raw_lat >> 15;
+  frame[5]  = raw_lat >> 7;
+  frame[6]  = (raw_lat << 1) | (raw_lon >> 23);
+  frame[7]  = raw_lon >> 15;
+  frame[8]  = raw_lon >> 7;
+  frame[9]  = raw_lon << 1;             /* barometric altitude */
+  frame[10] = raw_alt >> 4;
+  frame[11] = (raw_alt << 4) | 8;       /* NIC */
+
+  {
+    struct rs *rs = (struct rs *) rs_long;
+    data_t *data = frame, *parity = frame + UAT_DATA_BYTES;
+#include <fec/encode_rs.h>
+  }
+}
+
+/* continuous phase FSK, 2 samples per bit, +-0.3 pi per sample */
+static void uat_put(uint8_t *iq, const uint8_t *frame)
+{
+  double phase = rnd_range(0, 2 * M_PI);
+  int a = 30 + rnd() % 90;
+
+  for (int k = 0; k < UAT_FRAME_SAMPLES; k++) {
+    int b = k / 2, one;
+
+    if (b < UAT_SYNC_BITS) {
+      one = (UAT_SYNC_WORD >> (UAT_SYNC_BITS - 1 - b)) & 1;
+    } else {
+      b -= UAT_SYNC_BITS;
+      one = (frame[b / 8] >> (7 - (b % 8))) & 1;
+    }
+    phase += one ? 0.3 * M_PI : -0.3 * M_PI;
+    iq[2*k]   = clamp(127 + (int) lround(a * cos(phase)) + noise());
+    iq[2*k+1] = clamp(127 + (int) lround(a * sin(phase)) + noise());
+  }
+}
+
+static void uat_frame(bench_band_t *bp, uint8_t *used, int slots,
+                      size_t second, const bench_aircraft_t *ap)
+{
+  uint8_t frame[LONG_FRAME_BYTES];
+
+  uat_payload(ap, frame);
+  if (rnd() % 4 == 0) {
+    for (int i = 0; i < 3; i++)
+      frame[rnd() % LONG_FRAME_BYTES] ^= 1 + rnd() % 255;
+    bp->damaged++;
+  }
+  uat_put(bp->iq + 2 * (second * bp->rate + slot_take(used, slots)), frame);
+  bp->sent++;
+}
+
+static void iq_make()
+{
+  rnd_seed(seed);
+
+  for (int i = 0; i < count; i++) {
+    bench_aircraft_t *ap = &aircraft[i];
+    double r = BENCH_RADIUS * sqrt(rnd_range(0, 1));
+    double bearing = rnd_range(0, 2 * M_PI);
+
+    ap->addr   = 0x300000 + (rnd() & 0x0FFFFF);
+    ap->lat    = BENCH_LAT0 + r * cos(bearing) / 111300.0;
+    ap->lon    = BENCH_LON0 + r * sin(bearing) / 111300.0 /
+                              cos(BENCH_LAT0 * M_PI / 180.0);
+    ap->alt_ft = rnd_range(500, 3000) * 3.28084;
+    ap->ns_kt  = rnd_range(-200, 200);
+    ap->ew_kt  = rnd_range(-200, 200);
+    ap->vs_fpm = rnd_range(-1000, 1000);
+    ap->uat    = (i % 3) == 2;
+  }
+
+  for (int b = 0; b < SDR_BAND_COUNT; b++) {
+    bench_band_t *bp = &band[b];
+    int slots = bp->rate / SLOT_SAMPLES;
+    uint8_t *used = (uint8_t *) malloc(slots);
+
+    bp->len = (size_t) seconds * bp->rate * 2;
+    bp->iq  = (uint8_t *) malloc(bp->len);
+    if (bp->iq == NULL || used == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    for (size_t k = 0; k < bp->len; k++)
+      bp->iq[k] = clamp(127 + noise());
+
+    for (int s = 0; s < seconds; s++) {
+      memset(used, 0, slots);
+
+      for (int i = 0; i < count; i++) {
+        bench_aircraft_t *ap = &aircraft[i];
+
+        if (b == SDR_BAND_978) {
+          if (ap->uat) {
+            uat_frame(bp, used, slots, s, ap);
+            bp->positions++;
+          }
+          continue;
+        }
+        if (ap->uat)
+          continue;
+
+        double alt = ap->alt_ft;
+        es_frame(bp, used, slots, s,
+                 make_air_position_frame(11, ap->addr, ap->lat, ap->lon, alt,
+                                         CPR_EVEN, DF17));
+        es_frame(bp, used, slots, s,
+                 make_air_position_frame(11, ap->addr, ap->lat, ap->lon, alt,
+                                         CPR_ODD, DF17));
+        es_frame(bp, used, slots, s,
+                 make_velocity_frame(ap->addr, ap->ns_kt, ap->ew_kt,
+                                     ap->vs_fpm, DF17));
+        if ((s + i) % 5 == 0) {
+          unsigned char callsign[8];
+          char buf[9];
+
+          snprintf(buf, sizeof(buf), "BNC%04d ", i);
+          memcpy(callsign, buf, sizeof(callsign));
+          es_frame(bp, used, slots, s,
+                   make_aircraft_identification_frame(ap->addr, callsign,
+                                                      Category_Set_A, 3, DF17));
+        }
+        bp->positions += 2;
+      }
+    }
+    free(used);
+  }
+}
+
+/* of what is in the traffic store, from where the aircraft are, m */
+static double store_error()
+{
+  double worst = 0;
+
+  for (int i = 0; i < MAX_TRACKING_OBJECTS; i++) {
+    if (Container[i].addr == 0)
+      continue;
+    for (int j = 0; j < count; j++) {
+      if (aircraft[j].addr != Container[i].addr)
+        continue;
+      double dy = (Container[i].latitude  - aircraft[j].lat) * 111300.0;
+      double dx = (Container[i].longitude - aircraft[j].lon) * 111300.0 *
+                  cos(BENCH_LAT0 * M_PI / 180.0);
+      double d = sqrt(dx * dx + dy * dy);
+      if (d > worst)
+        worst = d;
+      break;
+    }
+  }
+  return worst;
+}
+
+/* rtl_sdr at its sample rate, into a FIFO */
+static void *fifo_writer(void *arg)
+{
+  bench_band_t *bp = (bench_band_t *) arg;
+  size_t chunk = (size_t) bp->rate * 2 * FIFO_CHUNK_MS / 1000;
+  int fd = open(bp->path, O_WRONLY);
+  uint64_t t0 = bench_ns();
+
+  if (fd < 0) {
+    perror(bp->path);
+    return NULL;
+  }
+  for (size_t off = 0, n = 0; off < bp->len; off += chunk, n++) {
+    uint64_t due = t0 + n * FIFO_CHUNK_MS * 1000000ULL;
+    uint64_t t = bench_ns();
+    size_t len = bp->len - off < chunk ? bp->len - off : chunk;
+
+    if (t < due)
+      usleep((due - t) / 1000);
+    if (write(fd, bp->iq + off, len) != (ssize_t) len)
+      break;
+  }
+  close(fd);
+  return NULL;
+}
+
+static const char usage_args[] =
+  "[-s seconds] [-n aircraft] [-r seed] [-p]\n"
+  "  -p  through a FIFO at the real sample rate, for the latency\n";
+
+int main(int argc, char *argv[])
+{
+  pthread_t writer[SDR_BAND_COUNT];
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:n:r:ph")) != -1) {
+    switch (opt)
+    {
+    case 's':  seconds = atoi(optarg);             break;
+    case 'n':  count   = atoi(optarg);             break;
+    case 'r':  seed    = strtoul(optarg, NULL, 0); break;
+    case 'p':  paced   = true;                     break;
+    default:
+      bench_usage(argv[0], usage_args);
+    }
+  }
+  if (seconds < 1 || count < 1 || count > BENCH_MAX_AIRCRAFT)
+    bench_usage(argv[0], usage_args);
+
+  memset(settings, 0, sizeof(settings_t));
+  settings->rf_protocol = RF_PROTOCOL_LATEST;
+  settings->relay       = RELAY_OFF;
+  GNSSTimeMarker        = 1;
+
+  bench_set_millis(1700000000UL % 100000 * 1000);
+  adsb_encoder_init();
+  rs_long = init_rs_char(8, 0x187, 120, 1, 14, 207);
+  iq_make();
+
+  ThisAircraft = EmptyFO;
+  ThisAircraft.latitude  = BENCH_LAT0;
+  ThisAircraft.longitude = BENCH_LON0;
+  ThisAircraft.altitude  = BENCH_ALT0;
+  ThisAircraft.timestamp = now();
+  Traffic_setup();
+
+  for (int b = 0; b < SDR_BAND_COUNT; b++) {
+    bench_band_t *bp = &band[b];
+
+    snprintf(bp->path, sizeof(bp->path), "/tmp/sdr-bench-%s-%d.iq",
+             bp->name, (int) getpid());
+    unlink(bp->path);
+    if (paced) {
+      if (mkfifo(bp->path, 0600) != 0) {
+        perror(bp->path);
+        return 1;
+      }
+    } else {
+      FILE *f = fopen(bp->path, "wb");
+      if (f == NULL || fwrite(bp->iq, 1, bp->len, f) != bp->len) {
+        perror(bp->path);
+        return 1;
+      }
+      fclose(f);
+    }
+    if (!SDR_setup(b, bp->path))
+      return 1;
+  }
+
+  printf("I/Q: %d s, %d aircraft, %s\n", seconds, count,
+         paced ? "FIFO at the sample rate" : "file, as fast as it goes");
+  printf("SDR_BUFFERS %d, SDR_BLOCK %d, MAX_TRACKING_OBJECTS %d\n\n",
+         SDR_BUFFERS, SDR_BLOCK, MAX_TRACKING_OBJECTS);
+
+  uint64_t t0 = bench_ns();
+  if (!SDR_start())
+    return 1;
+  if (paced) {
+    for (int b = 0; b < SDR_BAND_COUNT; b++)
+      pthread_create(&writer[b], NULL, fifo_writer, &band[b]);
+  }
+
+  /* the main loop of RPi.cpp, with the clock running */
+  for (bool active = true; active; ) {
+    active = false;
+    bench_set_millis(1700000000UL % 100000 * 1000 + (bench_ns() - t0) / 1000000);
+    SDR_loop();
+    for (int b = 0; b < SDR_BAND_COUNT; b++) {
+      if (SDR_active(b))
+        active = true;
+      else if (band[b].done_ns == 0)
+        band[b].done_ns = bench_ns();
+    }
+    usleep(1000);
+  }
+
+  if (paced) {
+    for (int b = 0; b < SDR_BAND_COUNT; b++)
+      pthread_join(writer[b], NULL);
+  }
+  SDR_fini();
+
+  printf("%-5s %7s %7s %7s %7s %7s %7s %7s %8s %8s\n", "band", "sent",
+         "damaged", "frames", "fixed", "dropped", "traffic", "of", "x real",
+         "lat max");
+  for (int b = 0; b < SDR_BAND_COUNT; b++) {
+    bench_band_t *bp = &band[b];
+    sdr_stats_t *sp = &SDR_stats[b];
+    double wall = (bp->done_ns - t0) / 1e9;
+
+    printf("%-5s %7u %7u %7u %7u %7u %7u %7u %8.1f %5u ms\n", bp->name,
+           bp->sent, bp->damaged, sp->frames, sp->fixed, sp->dropped,
+           sp->traffic, bp->positions, seconds / wall, sp->latency_max_ms);
+    unlink(bp->path);
+    free(bp->iq);
+  }
+  printf("\nin the traffic store: %.0f m from the aircraft at most\n",
+         store_error());
+
+  return 0;
+}
@@ -0,0 +1,526 @@
+/*
+ * TrafficBench.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host-side benchmark of the collision prediction code.
+ *
+ * Replays synthetic scenarios second by second on a virtual clock and
+ * times the alarm engines (Alarm_Distance, Alarm_Vector, Alarm_Legacy,
+ * via Traffic_Update()), project_this(), project_that(), AddTraffic()
+ * and complete Traffic_loop() passes.  The alarm levels produced are
+ * counted and hashed into a digest, so that an optimized engine can
+ * be checked for unchanged output against the previous one.
+ *
+ *   make bench [BENCH_MAX=64]
+ *   ./traffic-bench -s thermal -n 24 -e 600
+ *
+ * "cycles" are TSC ticks on x86 hosts, or ns * MHz if -m is given.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "../SoftRF.h"
+#include "../src/system/SoC.h"
+#include "../src/TrafficHelper.h"
+#include "../src/driver/EEPROM.h"
+#include "../src/protocol/radio/Legacy.h"
+#include "../src/Wind.h"
+
+#include "BenchStubs.h"
+
+#define BENCH_MAX_AIRCRAFT  1024
+
+#define BENCH_LAT0          46.0f
+#define BENCH_LON0          8.0f
+#define BENCH_ALT0          1500.0f
+#define BENCH_EPOCH         1700000000L   /* unix time of the first epoch */
+
+#define MPS_PER_KNOT        0.514444f
+#define DEG2RAD             (float)(M_PI / 180.0)
+
+enum
+{
+  SCENARIO_THERMAL,
+  SCENARIO_AEROTOW,
+  SCENARIO_HEADON,
+  SCENARIO_COUNT
+};
+
+static const char *scenario_name[SCENARIO_COUNT] = { "thermal", "aerotow", "headon" };
+
+enum
+{
+  STAT_DISTANCE,
+  STAT_VECTOR,
+  STAT_LEGACY,
+  STAT_PROJECT_THIS,
+  STAT_PROJECT_THAT,
+  STAT_ADDTRAFFIC,
+  STAT_LOOP,
+  STAT_COUNT
+};
+
+static const char *stat_name[STAT_COUNT] = {
+  "Alarm_Distance", "Alarm_Vector", "Alarm_Legacy",
+  "project_this", "project_that", "AddTraffic", "Traffic_loop"
+};
+
+typedef struct bench_stat_struct {
+  uint64_t  ns;
+  uint64_t  ticks;
+  uint32_t  calls;
+  uint32_t  levels[ALARM_LEVEL_URGENT+1];
+  uint32_t  digest;
+} bench_stat_t;
+
+/* kinematics of one aircraft, in meters and seconds relative to the origin */
+typedef struct bench_track_struct {
+  float     north, east, alt;
+  float     course;         /* degrees */
+  float     speed;          /* m/s */
+  float     turnrate;       /* degrees per second, right turns positive */
+  float     climb;          /* m/s */
+  uint8_t   type;
+} bench_track_t;
+
+/* scenario parameters of the other aircraft, drawn once per run */
+typedef struct bench_target_struct {
+  float     a, b, c, d, e;
+} bench_target_t;
+
+static int      scenario = SCENARIO_THERMAL;
+static int      count    = 16;
+static int      epochs   = 300;
+static uint32_t seed     = 1;
+static float    rx_ratio = 0.7f;
+static float    cpu_mhz  = 0.0f;
+static int      loop_alarm = TRAFFIC_ALARM_LEGACY;
+
+static bench_target_t targets[BENCH_MAX_AIRCRAFT];
+static ufo_t          scene[BENCH_MAX_AIRCRAFT];
+static ufo_t          work[BENCH_MAX_AIRCRAFT];
+static bench_stat_t   stats[STAT_COUNT];
+
+/*
+ * Timing
+ */
+static inline uint64_t bench_ticks()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void stat_add(int which, uint64_t ns, uint64_t ticks, uint32_t calls)
+{
+  stats[which].ns    += ns;
+  stats[which].ticks += ticks;
+  stats[which].calls += calls;
+}
+
+/* FNV-1a over everything that is expected to stay the same */
+static void stat_digest(int which, uint32_t value)
+{
+  stats[which].digest = (stats[which].digest ^ value) * 16777619U;
+}
+
+static void stat_level(int which, int level)
+{
+  if (level < ALARM_LEVEL_NONE)    level = ALARM_LEVEL_NONE;
+  if (level > ALARM_LEVEL_URGENT)  level = ALARM_LEVEL_URGENT;
+  ++stats[which].levels[level];
+  stat_digest(which, (uint32_t) level);
+}
+
+/*
+ * Scenarios
+ */
+
+static void track_to_ufo(const bench_track_t *tp, ufo_t *fop, uint32_t ms)
+{
+  fop->latitude  = BENCH_LAT0 + tp->north / 111300.0f;
+  fop->longitude = BENCH_LON0 + tp->east / (111300.0f * cosf(BENCH_LAT0 * DEG2RAD));
+  fop->altitude  = tp->alt;
+  fop->pressure_altitude = tp->alt;
+  fop->course    = tp->course;
+  fop->heading   = tp->course;    /* no wind */
+  fop->speed     = tp->speed / MPS_PER_KNOT;
+  fop->turnrate  = tp->turnrate;
+  fop->vs        = tp->climb * (60.0f / 0.3048f);
+  fop->aircraft_type = tp->type;
+  fop->airborne  = 1;
+  fop->timestamp = BENCH_EPOCH + ms / 1000;
+  fop->gnsstime_ms = ms;
+}
+
+/* position on a circle around the thermal centre; dir is +1 right, -1 left */
+static void circle(bench_track_t *tp, float radius, float phase, float speed,
+                   int dir, float alt, float t)
+{
+  float omega = speed / radius;                 /* rad/s */
+  float theta = phase + dir * omega * t;        /* bearing from centre */
+  tp->north    = radius * cosf(theta);
+  tp->east     = radius * sinf(theta);
+  tp->alt      = alt + 1.5f * t;                /* 1.5 m/s climb */
+  float course = theta / DEG2RAD + dir * 90.0f;
+  tp->course   = fmodf(course + 720.0f, 360.0f);
+  tp->speed    = speed;
+  tp->turnrate = dir * omega / DEG2RAD;
+  tp->climb    = 1.5f;
+  tp->type     = AIRCRAFT_TYPE_GLIDER;
+}
+
+/* straight line through (north, east) at time 0 */
+static void line(bench_track_t *tp, float north, float east, float course,
+                 float speed, float alt, float climb, float t)
+{
+  tp->north    = north + speed * t * cosf(course * DEG2RAD);
+  tp->east     = east  + speed * t * sinf(course * DEG2RAD);
+  tp->alt      = alt + climb * t;
+  tp->course   = fmodf(course + 720.0f, 360.0f);
+  tp->speed    = speed;
+  tp->turnrate = 0;
+  tp->climb    = climb;
+  tp->type     = AIRCRAFT_TYPE_GLIDER;
+}
+
+/*
+ * An aircraft whose path passes the own aircraft at time a,
+ * b meters to the side and c meters above, on relative course d.
+ */
+static void encounter(bench_track_t *tp, const bench_track_t *own0,
+                      float own_course, float own_speed,
+                      const bench_target_t *pp, float speed, float t)
+{
+  float oc = own_course * DEG2RAD;
+  float tc = (own_course + pp->d) * DEG2RAD;
+  /* own position at the time of closest approach, plus the miss offset */
+  float n = own0->north + own_speed * pp->a * cosf(oc) - pp->b * sinf(oc);
+  float e = own0->east  + own_speed * pp->a * sinf(oc) + pp->b * cosf(oc);
+  line(tp, n - speed * pp->a * cosf(tc), e - speed * pp->a * sinf(tc),
+       own_course + pp->d, speed, own0->alt + pp->c, 0, t);
+}
+
+static void scenario_setup()
+{
+  rnd_seed(seed);
+
+  for (int k=0; k < count; k++) {
+    bench_target_t *pp = &targets[k];
+    switch (scenario)
+    {
+    case SCENARIO_THERMAL:
+      pp->a = rnd_rangef(50, 150);               /* radius */
+      pp->b = rnd_rangef(0, 2 * M_PI);           /* phase */
+      pp->c = rnd_rangef(20, 27);                /* airspeed, m/s */
+      pp->d = (rnd() % 8 == 0) ? -1 : 1;        /* a few circle the wrong way */
+      pp->e = rnd_rangef(-250, 250);             /* height relative to own */
+      break;
+    case SCENARIO_AEROTOW:
+      /* other tows and gliders, crossing at up to 60 degrees */
+      pp->a = rnd_rangef(5, epochs);
+      pp->b = rnd_rangef(-400, 400);
+      pp->c = rnd_rangef(-120, 120);
+      pp->d = rnd_rangef(-60, 60);
+      pp->e = rnd_rangef(28, 38);
+      break;
+    case SCENARIO_HEADON:
+    default:
+      pp->a = rnd_rangef(5, epochs);
+      pp->b = rnd_rangef(-250, 250);
+      pp->c = rnd_rangef(-60, 60);
+      pp->d = 180 + rnd_rangef(-15, 15);
+      pp->e = rnd_rangef(25, 45);
+      break;
+    }
+  }
+}
+
+static void scenario_own(bench_track_t *tp, float t)
+{
+  switch (scenario)
+  {
+  case SCENARIO_THERMAL:
+    circle(tp, 90, 0, 24, 1, BENCH_ALT0, t);
+    break;
+  case SCENARIO_AEROTOW:
+    line(tp, 0, 0, 90, 33, BENCH_ALT0, 2.5f, t);
+    break;
+  case SCENARIO_HEADON:
+  default:
+    line(tp, 0, 0, 0, 28, BENCH_ALT0, 0, t);
+    break;
+  }
+}
+
+static void scenario_target(int k, bench_track_t *tp, float t)
+{
+  const bench_target_t *pp = &targets[k];
+  bench_track_t own0;
+
+  switch (scenario)
+  {
+  case SCENARIO_THERMAL:
+    circle(tp, pp->a, pp->b, pp->c, (int) pp->d, BENCH_ALT0 + pp->e, t);
+    break;
+  case SCENARIO_AEROTOW:
+    if (k == 0) {
+      /* the tug, 60 m ahead on the rope and a little higher */
+      line(tp, 0, 60, 90, 33, BENCH_ALT0 + 5, 2.5f, t);
+      tp->type = AIRCRAFT_TYPE_TOWPLANE;
+      break;
+    }
+    scenario_own(&own0, 0);
+    encounter(tp, &own0, 90, 33, pp, pp->e, t);
+    if (k & 1)
+      tp->type = AIRCRAFT_TYPE_TOWPLANE;
+    break;
+  case SCENARIO_HEADON:
+  default:
+    scenario_own(&own0, 0);
+    encounter(tp, &own0, 0, 28, pp, pp->e, t);
+    break;
+  }
+}
+
+/*
+ * Replay
+ */
+
+static void own_update(int epoch, uint32_t ms)
+{
+  bench_track_t now_t, prev_t;
+
+  scenario_own(&now_t, (float) epoch);
+  scenario_own(&prev_t, (float) (epoch - 1));
+
+  track_to_ufo(&prev_t, &ThisAircraft, ms - 1000);
+  ThisAircraft.prevcourse   = ThisAircraft.course;
+  ThisAircraft.prevheading  = ThisAircraft.heading;
+  ThisAircraft.prevaltitude = ThisAircraft.altitude;
+  ThisAircraft.prevtime_ms  = ms - 1000;
+  track_to_ufo(&now_t, &ThisAircraft, ms);
+  ThisAircraft.circling = (scenario == SCENARIO_THERMAL) ? 1 : 0;
+
+  uint64_t t0 = bench_ns();
+  uint64_t c0 = bench_ticks();
+  project_this(&ThisAircraft);
+  stat_add(STAT_PROJECT_THIS, bench_ns() - t0, bench_ticks() - c0, 1);
+
+  /* airborne detection wants a history of fixes, skip it */
+  ThisAircraft.airborne = 1;
+}
+
+static void scene_update(int epoch, uint32_t ms)
+{
+  for (int k=0; k < count; k++) {
+    bench_track_t tr;
+    ufo_t *fop = &scene[k];
+
+    memset(fop, 0, sizeof(ufo_t));
+    scenario_target(k, &tr, (float) (epoch - 1));
+    fop->prevcourse  = tr.course;
+    fop->prevheading = tr.course;
+    fop->prevtime_ms = ms - 1000;
+    scenario_target(k, &tr, (float) epoch);
+    track_to_ufo(&tr, fop, ms);
+    fop->protocol  = RF_PROTOCOL_LATEST;
+    fop->addr_type = ADDR_TYPE_FLARM;
+    fop->addr      = 0xD00000 + k + 1;
+    fop->projtime_ms = ms;
+  }
+}
+
+static void bench_engine(int which, int alarm)
+{
+  settings->alarm = alarm;
+  Traffic_setup();
+
+  memcpy(work, scene, count * sizeof(ufo_t));
+
+  uint64_t t0 = bench_ns();
+  uint64_t c0 = bench_ticks();
+  for (int k=0; k < count; k++)
+    Traffic_Update(&work[k]);
+  stat_add(which, bench_ns() - t0, bench_ticks() - c0, count);
+
+  for (int k=0; k < count; k++) {
+    stat_level(which, work[k].alarm_level);
+    stat_digest(which, (uint8_t) work[k].alert_level);
+  }
+}
+
+static void bench_project_that()
+{
+  memcpy(work, scene, count * sizeof(ufo_t));
+
+  uint64_t t0 = bench_ns();
+  uint64_t c0 = bench_ticks();
+  for (int k=0; k < count; k++)
+    project_that(&work[k]);
+  stat_add(STAT_PROJECT_THAT, bench_ns() - t0, bench_ticks() - c0, count);
+}
+
+static void bench_loop()
+{
+  settings->alarm = loop_alarm;
+  Traffic_setup();
+
+  /* not every packet is received, the rest age in Container[] */
+  uint32_t fed = 0;
+  uint64_t ns = 0, ticks = 0;
+  for (int k=0; k < count; k++) {
+    if (rnd_rangef(0, 1) >= rx_ratio)
+      continue;
+    fo = scene[k];
+    uint64_t t0 = bench_ns();
+    uint64_t c0 = bench_ticks();
+    AddTraffic(&fo);
+    ns    += bench_ns() - t0;
+    ticks += bench_ticks() - c0;
+    ++fed;
+  }
+  stat_add(STAT_ADDTRAFFIC, ns, ticks, fed);
+
+  /* force a pass regardless of TRAFFIC_UPDATE_INTERVAL_MS */
+  UpdateTrafficTimeMarker = millis() - TRAFFIC_UPDATE_INTERVAL_MS - 1;
+
+  uint64_t t0 = bench_ns();
+  uint64_t c0 = bench_ticks();
+  Traffic_loop();
+  stat_add(STAT_LOOP, bench_ns() - t0, bench_ticks() - c0, 1);
+
+  stat_level(STAT_LOOP, max_alarm_level);
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    if (Container[i].addr == 0)
+      continue;
+    stat_digest(STAT_LOOP, Container[i].addr);
+    stat_digest(STAT_LOOP, (uint8_t) Container[i].alarm_level);
+    stat_digest(STAT_LOOP, (uint8_t) Container[i].alert_level);
+  }
+}
+
+static void report()
+{
+  printf("scenario %s, %d aircraft, %d epochs, seed %u, MAX_TRACKING_OBJECTS %d\n\n",
+         scenario_name[scenario], count, epochs, seed, MAX_TRACKING_OBJECTS);
+  printf("%-15s %9s %10s %10s   %7s %7s %7s %7s %7s  %8s\n",
+         "", "calls", "ns/call", "cycles", "NONE", "CLOSE", "LOW", "IMPORT", "URGENT", "digest");
+
+  for (int i=0; i < STAT_COUNT; i++) {
+    bench_stat_t *sp = &stats[i];
+    if (sp->calls == 0)
+      continue;
+
+    double ns = (double) sp->ns / sp->calls;
+    char cycles[16] = "-";
+#if defined(__i386__) || defined(__x86_64__)
+    snprintf(cycles, sizeof(cycles), "%.0f", (double) sp->ticks / sp->calls);
+#endif
+    if (cpu_mhz > 0)
+      snprintf(cycles, sizeof(cycles), "%.0f", ns * cpu_mhz / 1000.0);
+
+    printf("%-15s %9u %10.1f %10s", stat_name[i], sp->calls, ns, cycles);
+
+    uint32_t nlevels = 0;
+    for (int l=ALARM_LEVEL_NONE; l <= ALARM_LEVEL_URGENT; l++)
+      nlevels += sp->levels[l];
+    if (nlevels) {
+      printf("  ");
+      for (int l=ALARM_LEVEL_NONE; l <= ALARM_LEVEL_URGENT; l++)
+        printf(" %7u", sp->levels[l]);
+      printf("  %08x", sp->digest);
+    }
+    printf("\n");
+  }
+  printf("\nTraffic_loop levels are max_alarm_level per pass (alarm method %d),\n"
+         "its digest also covers alarm and alert levels of every slot\n", loop_alarm);
+}
+
+static const char usage_args[] =
+  "[-s thermal|aerotow|headon] [-n aircraft] [-e epochs]\n"
+  "          [-r seed] [-x rx_ratio] [-a 1|2|3] [-m cpu_mhz]\n"
+  "  -a  alarm method used for the Traffic_loop() passes:\n"
+  "      1 distance, 2 vector, 3 legacy (default)\n";
+
+int main(int argc, char *argv[])
+{
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:n:e:r:x:a:m:h")) != -1) {
+    switch (opt)
+    {
+    case 's':
+      for (scenario=0; scenario < SCENARIO_COUNT; scenario++)
+        if (strcmp(optarg, scenario_name[scenario]) == 0)
+          break;
+      if (scenario == SCENARIO_COUNT)
+        bench_usage(argv[0], usage_args);
+      break;
+    case 'n':  count    = atoi(optarg);        break;
+    case 'e':  epochs   = atoi(optarg);        break;
+    case 'r':  seed     = strtoul(optarg, NULL, 0); break;
+    case 'x':  rx_ratio = atof(optarg);        break;
+    case 'a':  loop_alarm = atoi(optarg);      break;
+    case 'm':  cpu_mhz  = atof(optarg);        break;
+    default:
+      bench_usage(argv[0], usage_args);
+    }
+  }
+  if (count < 1 || count > BENCH_MAX_AIRCRAFT || epochs < 1
+      || loop_alarm < TRAFFIC_ALARM_DISTANCE || loop_alarm > TRAFFIC_ALARM_LEGACY)
+    bench_usage(argv[0], usage_args);
+
+  memset(settings, 0, sizeof(settings_t));
+  settings->rf_protocol = RF_PROTOCOL_LATEST;
+  settings->relay       = RELAY_OFF;
+  GNSSTimeMarker        = 1;
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++)
+    Container[i] = EmptyFO;
+
+  scenario_setup();
+
+  for (int epoch=1; epoch <= epochs; epoch++) {
+    uint32_t ms = 10000 + epoch * 1000;
+    bench_set_millis(ms);
+
+    own_update(epoch, ms);
+    scene_update(epoch, ms);
+
+    bench_engine(STAT_DISTANCE, TRAFFIC_ALARM_DISTANCE);
+    bench_engine(STAT_VECTOR,   TRAFFIC_ALARM_VECTOR);
+    bench_engine(STAT_LEGACY,   TRAFFIC_ALARM_LEGACY);
+    bench_project_that();
+    bench_loop();
+  }
+
+  report();
+
+  return 0;
+}
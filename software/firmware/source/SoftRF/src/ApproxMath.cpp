@@ -17,12 +17,15 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include "../SoftRF.h"
 #include "ApproxMath.h"
 
 /* For the purposes used here, trig functions don't need much precision */
 /* - on the other hand can save CPU time by using faster approximations */
 
+#if !defined(APPROX_FIXED_POINT)
+
 /* helper function, only valid for positive arguments      */
 /* quadratic fit on 0-45 range, results within +-0.25 deg  */
 static float atan_positive(float ns, float ew)
@@ -56,6 +59,8 @@ float atan2_approx(float ns, float ew)
   }
 }
 
+#endif /* APPROX_FIXED_POINT */
+
 // even faster integer version (but cannot avoid one integer division)
 // - accurate to within about 1 degree
 
@@ -90,6 +95,8 @@ int32_t iatan2_approx(int32_t ns, int32_t ew)
   }
 }
 
+#if !defined(APPROX_FIXED_POINT)
+
 /* approximate sin(), argument in degrees, meant for +-360deg range */
 /*   https://scholarworks.umt.edu/cgi/viewcontent.cgi?article=1313&context=tme     */
 float sin_approx(float degs)
@@ -147,6 +154,8 @@ float approxHypotenuse(float x, float y)
    }
 }
 
+#endif /* APPROX_FIXED_POINT */
+
 
 // faster integer version (including "iteration"):
 //   - faster because integer division instead of float
@@ -238,6 +247,8 @@ uint32_t iapproxHypotenuse0( int32_t x, int32_t y )
    return (( approx + 512 ) >> 10 );
 }
 
+#if !defined(APPROX_FIXED_POINT)
+
 /* cos(latitude) is used to convert longitude difference into linear distance. */
 /* Once computed, accurate enough through a significant range of latitude. */
 
@@ -257,3 +268,249 @@ float CosLat(float latitude)
 }
 
 float InvCosLat() { return inv_cos_lat; }
+
+float div_approx(float n, float d) { return n / d; }
+
+#endif /* APPROX_FIXED_POINT */
+
+/*
+ * Fixed-point kernels, for SoCs without an FPU.
+ * Quarter-wave tables with linear interpolation, 2 x 514 bytes of flash.
+ */
+
+/* sin() of 0...90 degrees in 256 steps, q15_t */
+static const int16_t sin_q15_lut[257] = {
+      0,   201,   402,   603,   804,  1005,  1206,  1407,  1608,  1809,
+   2009,  2210,  2411,  2611,  2811,  3012,  3212,  3412,  3612,  3812,
+   4011,  4211,  4410,  4609,  4808,  5007,  5205,  5404,  5602,  5800,
+   5998,  6195,  6393,  6590,  6787,  6983,  7180,  7376,  7571,  7767,
+   7962,  8157,  8351,  8546,  8740,  8933,  9127,  9319,  9512,  9704,
+   9896, 10088, 10279, 10469, 10660, 10850, 11039, 11228, 11417, 11605,
+  11793, 11980, 12167, 12354, 12540, 12725, 12910, 13095, 13279, 13463,
+  13646, 13828, 14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269,
+  15447, 15624, 15800, 15976, 16151, 16326, 16500, 16673, 16846, 17018,
+  17190, 17361, 17531, 17700, 17869, 18037, 18205, 18372, 18538, 18703,
+  18868, 19032, 19195, 19358, 19520, 19681, 19841, 20001, 20160, 20318,
+  20475, 20632, 20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+  22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028, 23170, 23312,
+  23453, 23593, 23732, 23870, 24008, 24144, 24279, 24414, 24548, 24680,
+  24812, 24943, 25073, 25202, 25330, 25457, 25583, 25708, 25833, 25956,
+  26078, 26199, 26320, 26439, 26557, 26674, 26791, 26906, 27020, 27133,
+  27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002, 28106, 28209,
+  28311, 28411, 28511, 28610, 28707, 28803, 28899, 28993, 29086, 29178,
+  29269, 29359, 29448, 29535, 29622, 29707, 29792, 29875, 29957, 30038,
+  30118, 30196, 30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784,
+  30853, 30920, 30986, 31050, 31114, 31177, 31238, 31298, 31357, 31415,
+  31471, 31527, 31581, 31634, 31686, 31737, 31786, 31834, 31881, 31927,
+  31972, 32015, 32058, 32099, 32138, 32177, 32214, 32251, 32286, 32319,
+  32352, 32383, 32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+  32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718, 32729, 32738,
+  32746, 32753, 32758, 32762, 32766, 32767, 32767
+};
+
+/* atan() of 0...1 in 256 steps, binary angle (8192 = 45 degrees) */
+static const uint16_t atan_bam_lut[257] = {
+      0,    41,    81,   122,   163,   204,   244,   285,   326,   367,
+    407,   448,   489,   529,   570,   610,   651,   692,   732,   773,
+    813,   854,   894,   935,   975,  1015,  1056,  1096,  1136,  1177,
+   1217,  1257,  1297,  1337,  1377,  1417,  1457,  1497,  1537,  1577,
+   1617,  1656,  1696,  1736,  1775,  1815,  1854,  1894,  1933,  1973,
+   2012,  2051,  2090,  2129,  2168,  2207,  2246,  2285,  2324,  2363,
+   2401,  2440,  2478,  2517,  2555,  2594,  2632,  2670,  2708,  2746,
+   2784,  2822,  2860,  2897,  2935,  2973,  3010,  3047,  3085,  3122,
+   3159,  3196,  3233,  3270,  3307,  3344,  3380,  3417,  3453,  3490,
+   3526,  3562,  3599,  3635,  3670,  3706,  3742,  3778,  3813,  3849,
+   3884,  3920,  3955,  3990,  4025,  4060,  4095,  4129,  4164,  4199,
+   4233,  4267,  4302,  4336,  4370,  4404,  4438,  4471,  4505,  4539,
+   4572,  4605,  4639,  4672,  4705,  4738,  4771,  4803,  4836,  4869,
+   4901,  4933,  4966,  4998,  5030,  5062,  5094,  5125,  5157,  5188,
+   5220,  5251,  5282,  5313,  5344,  5375,  5406,  5437,  5467,  5498,
+   5528,  5559,  5589,  5619,  5649,  5679,  5708,  5738,  5768,  5797,
+   5826,  5856,  5885,  5914,  5943,  5972,  6000,  6029,  6058,  6086,
+   6114,  6142,  6171,  6199,  6227,  6254,  6282,  6310,  6337,  6365,
+   6392,  6419,  6446,  6473,  6500,  6527,  6554,  6580,  6607,  6633,
+   6660,  6686,  6712,  6738,  6764,  6790,  6815,  6841,  6867,  6892,
+   6917,  6943,  6968,  6993,  7018,  7043,  7068,  7092,  7117,  7141,
+   7166,  7190,  7214,  7238,  7262,  7286,  7310,  7334,  7358,  7381,
+   7405,  7428,  7451,  7475,  7498,  7521,  7544,  7566,  7589,  7612,
+   7635,  7657,  7679,  7702,  7724,  7746,  7768,  7790,  7812,  7834,
+   7856,  7877,  7899,  7920,  7942,  7963,  7984,  8005,  8026,  8047,
+   8068,  8089,  8110,  8131,  8151,  8172,  8192
+};
+
+/* within +-1 LSB of libm */
+q15_t isin_q15(uint16_t angle)
+{
+  uint16_t r = angle & 0x3FFF;
+  if (angle & 0x4000)
+    r = 0x4000 - r;                 /* 2nd and 4th quadrant mirror the 1st */
+  uint16_t i = r >> 6;
+  uint16_t frac = r & 0x3F;
+  int32_t sine = sin_q15_lut[i];
+  if (frac)
+    sine += ((sin_q15_lut[i+1] - sine) * frac + 32) >> 6;
+  return (angle & 0x8000) ? -sine : sine;
+}
+
+q15_t icos_q15(uint16_t angle)
+{
+  return isin_q15(angle + 0x4000);
+}
+
+/* like iatan2_approx() (reverse argument order), to within about 0.01 degree */
+uint16_t iatan2_bam(int32_t ns, int32_t ew)
+{
+  uint32_t ans = (ns < 0 ? -ns : ns);
+  uint32_t aew = (ew < 0 ? -ew : ew);
+  if (ans == 0 && aew == 0)
+    return 0;
+
+  bool steep = (aew > ans);         /* closer to East-West than to North-South */
+  uint32_t big   = (steep ? aew : ans);
+  uint32_t small = (steep ? ans : aew);
+  while (small > 0xFFFF) {          /* the division below needs small < 2^16 */
+    small >>= 1;
+    big   >>= 1;
+  }
+  uint32_t t = (small << 16) / big; /* 0...65536 */
+  uint32_t i = t >> 8;
+  uint32_t frac = t & 0xFF;
+  uint32_t angle = atan_bam_lut[i];
+  if (frac)
+    angle += ((atan_bam_lut[i+1] - angle) * frac + 128) >> 8;
+  if (steep)
+    angle = 0x4000 - angle;
+
+  if (ew >= 0)
+    return (ns >= 0 ? angle : 0x8000 - angle);
+  return (ns < 0 ? 0x8000 + angle : 0x10000 - angle);
+}
+
+/* 1/x, saturated at +-32767.99998 */
+q16_t irecip_q16(q16_t x)
+{
+  uint32_t ax = (x < 0 ? -x : x);
+  uint32_t r = (ax > 1 ? 0xFFFFFFFFUL / ax : 0x7FFFFFFFUL);
+  if (r > 0x7FFFFFFFUL)
+    r = 0x7FFFFFFFUL;
+  return (x < 0 ? -(q16_t) r : (q16_t) r);
+}
+
+/* as CosLat() below, latitude in q16_t degrees */
+
+static q15_t icos_lat = 23170;      /* 0.7071 */
+static q16_t iinv_cos_lat = 92682;  /* 1.4142 */
+
+q15_t iCosLat(q16_t latitude)
+{
+  static q16_t oldlat = 45 * Q16_ONE;
+  q16_t dlat = latitude - oldlat;
+  if (dlat > 19661 || dlat < -19661) {       /* 0.3 degree */
+    icos_lat = icos_q15(QDEG_TO_BAM(latitude));
+    if (icos_lat > 327)                       /* 0.01 */
+        iinv_cos_lat = irecip_q16((q16_t) icos_lat << 1);
+    oldlat = latitude;
+  }
+  return icos_lat;
+}
+
+q16_t iInvCosLat() { return iinv_cos_lat; }
+
+#if defined(APPROX_FIXED_POINT)
+
+/*
+ * The float API on top of the kernels above.  Arguments of arbitrary
+ * scale are brought into 2^14...2^15 by their binary exponent, taken
+ * from the IEEE 754 bits with integer operations only.
+ */
+
+/* as frexpf(); -126 for zero, so a zero never sets approx_scale() */
+static int approx_exponent(float x)
+{
+  uint32_t b;
+  memcpy(&b, &x, sizeof(b));
+  return (int) ((b >> 23) & 0xFF) - 126;
+}
+
+static int approx_scale(float x, float y)
+{
+  int ex = approx_exponent(x);
+  int ey = approx_exponent(y);
+  return 15 - (ex > ey ? ex : ey);
+}
+
+/* x * 2^s, truncated to an integer */
+static int32_t approx_fix(float x, int s)
+{
+  uint32_t b;
+  memcpy(&b, &x, sizeof(b));
+  int e = (b >> 23) & 0xFF;
+  if (e == 0)
+    return 0;
+  int32_t m = (b & 0x7FFFFF) | 0x800000;
+  int shift = e - 150 + s;
+  if (shift >= 0)
+    m <<= shift;
+  else
+    m = (shift > -24 ? m >> -shift : 0);
+  return (b & 0x80000000) ? -m : m;
+}
+
+float atan2_approx(float ns, float ew)
+{
+  int s = approx_scale(ns, ew);
+  uint16_t angle = iatan2_bam(approx_fix(ns, s), approx_fix(ew, s));
+  return (float) angle * (360.0f / 65536.0f);
+}
+
+float sin_approx(float degs)
+{
+  return (float) isin_q15((uint16_t) (int32_t) (degs * (65536.0f / 360.0f)))
+           * (1.0f / Q15_ONE);
+}
+
+float cos_approx(float degs)
+{
+  return (float) icos_q15((uint16_t) (int32_t) (degs * (65536.0f / 360.0f)))
+           * (1.0f / Q15_ONE);
+}
+
+float approxHypotenuse(float x, float y)
+{
+  if (x == 0.0f)  return fabsf(y);
+  if (y == 0.0f)  return fabsf(x);
+  int s = approx_scale(x, y);
+  uint32_t h = iapproxHypotenuse1(approx_fix(fabsf(x), s), approx_fix(fabsf(y), s));
+  /* h * 2^-s, by the exponent bits */
+  float f = (float) h;
+  uint32_t b;
+  memcpy(&b, &f, sizeof(b));
+  b -= (uint32_t) s << 23;
+  memcpy(&f, &b, sizeof(f));
+  return f;
+}
+
+float CosLat(float latitude)
+{
+  return (float) iCosLat((q16_t) (latitude * Q16_ONE)) * (1.0f / Q15_ONE);
+}
+
+float InvCosLat() { return (float) iinv_cos_lat * (1.0f / Q16_ONE); }
+
+/* n / d, as n times irecip_q16() of d brought into 2^14...2^15 */
+float div_approx(float n, float d)
+{
+  int s = 15 - approx_exponent(d);
+  int32_t fd = approx_fix(d, s);
+  if (fd == 0)                              /* zero or denormal */
+    return (n == 0.0f ? 0.0f : (n < 0.0f) != (d < 0.0f) ? -HUGE_VALF : HUGE_VALF);
+  /* irecip_q16(fd) is 2^32 / fd, 1/d that times 2^(s-32), by the exponent bits */
+  float f = (float) irecip_q16(fd);
+  uint32_t b;
+  memcpy(&b, &f, sizeof(b));
+  b += (uint32_t) (s - 32) << 23;
+  memcpy(&f, &b, sizeof(f));
+  return n * f;
+}
+
+#endif /* APPROX_FIXED_POINT */
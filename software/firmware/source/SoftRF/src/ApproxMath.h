@@ -19,10 +19,27 @@
 #ifndef APPROXMATH_H
 #define APPROXMATH_H
 
+#include <stdint.h>
+
+/*
+ * SoCs without a hardware FPU run the float API below on top of the
+ * fixed-point kernels, so that no float division, polynomial or libm
+ * call is left in the traffic, wind and Legacy paths.
+ * Can also be forced with -DAPPROX_FIXED_POINT.
+ */
+#if !defined(APPROX_FIXED_POINT)
+#if defined(ENERGIA_ARCH_CC13XX)   || defined(ARDUINO_ARCH_SAMD)       || \
+    defined(__ASR6501__)           || defined(ARDUINO_ARCH_ASR650X)    || \
+    defined(ARDUINO_ARCH_ASR6601)
+#define APPROX_FIXED_POINT
+#endif
+#endif
+
 float atan2_approx(float, float);
 float sin_approx(float);
 float cos_approx(float);
 float approxHypotenuse(float, float);
+float div_approx(float, float);
 float CosLat(float);
 float InvCosLat(void);
 
@@ -30,4 +47,31 @@ int32_t iatan2_approx( int32_t ns, int32_t ew );
 uint32_t iapproxHypotenuse0( int32_t x, int32_t y );
 uint32_t iapproxHypotenuse1( int32_t x, int32_t y );
 
+/*
+ * Fixed-point kernels.
+ *   q15_t  - signed 1.15, +-1.0 is +-32768 (saturated to 32767)
+ *   q16_t  - signed 16.16, 1.0 is 65536
+ *   angles - binary angle, a full circle is 65536, clockwise from North
+ * Hypotenuse is scale-free, use iapproxHypotenuse1() on any Q format.
+ */
+typedef int16_t q15_t;
+typedef int32_t q16_t;
+
+#define Q15_ONE             32768
+#define Q16_ONE             65536
+#define Q15_MUL(a,b)        ((int32_t)(((int32_t)(a) * (b)) >> 15))
+#define Q16_MUL(a,b)        ((int32_t)(((int64_t)(a) * (b)) >> 16))
+
+/* degrees (int, or q16_t) to binary angle */
+#define IDEG_TO_BAM(d)      ((uint16_t)(((int32_t)(d) * 11651) >> 6))
+#define QDEG_TO_BAM(d)      ((uint16_t)((int32_t)(d) / 360))
+#define BAM_TO_QDEG(a)      ((q16_t)(a) * 360)
+
+q15_t isin_q15(uint16_t);
+q15_t icos_q15(uint16_t);
+uint16_t iatan2_bam(int32_t ns, int32_t ew);
+q16_t irecip_q16(q16_t);
+q15_t iCosLat(q16_t);
+q16_t iInvCosLat(void);
+
 #endif /* APPROXMATH_H */
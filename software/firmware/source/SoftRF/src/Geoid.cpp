@@ -0,0 +1,190 @@
+/*
+ * Geoid.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system/SoC.h"
+#include "Geoid.h"
+
+#if !defined(EXCLUDE_EGM96)
+
+#include <egm96s.h>
+
+#if defined(USE_GEOID_GRID)
+#include <stdio.h>
+#endif
+
+typedef struct geoid_grid_struct {
+  float  north;         /* latitude of row 0 */
+  float  west;          /* longitude of column 0 */
+  float  inv_step;      /* rows or columns per degree */
+  int    rows;
+  int    cols;
+  bool   wrap;          /* columns go all around the globe */
+} geoid_grid_t;
+
+/* egm96s_dem: 90 rows from 90N to 88S, 180 columns from 0E, meters + 127 */
+static const geoid_grid_t egm96s = { 90.0, 0.0, 0.5, 90, 180, true };
+
+#if defined(USE_GEOID_GRID)
+static geoid_grid_t regional;
+static int16_t *regional_cm = NULL;
+#endif
+
+/* the four corners around the last position looked up */
+static const geoid_grid_t *cell_grid = NULL;
+static int   cell_row = -1;
+static int   cell_col = -1;
+static float cell_nw, cell_ne, cell_sw, cell_se;
+
+static float grid_value(const geoid_grid_t *g, int row, int col)
+{
+  if (row >= g->rows)           /* south of the last row */
+    row = g->rows - 1;
+  if (g->wrap && col >= g->cols)
+    col -= g->cols;
+
+#if defined(USE_GEOID_GRID)
+  if (g == &regional)
+    return regional_cm[row * g->cols + col] * 0.01f;
+#endif
+
+  return (int) pgm_read_byte(&egm96s_dem[row * egm96s.cols + col]) - 127;
+}
+
+float LookupSeparation(float lat, float lon)
+{
+  const geoid_grid_t *g = &egm96s;
+  float y, x;
+
+#if defined(USE_GEOID_GRID)
+  if (regional_cm != NULL) {
+    y = (regional.north - lat) * regional.inv_step;
+    x = (lon - regional.west) * regional.inv_step;
+    if (y >= 0 && x >= 0 && y < regional.rows - 1 && x < regional.cols - 1)
+      g = &regional;
+  }
+#endif
+
+  if (g == &egm96s) {
+    if (lon < 0)
+      lon += 360.0;
+    y = (90.0 - lat) * egm96s.inv_step;
+    x = lon * egm96s.inv_step;
+    if (y < 0)
+      y = 0;
+    if (x < 0 || x >= egm96s.cols)
+      x = 0;
+  }
+
+  int row = (int) y;
+  int col = (int) x;
+
+  if (g != cell_grid || row != cell_row || col != cell_col) {
+    cell_nw = grid_value(g, row,     col);
+    cell_ne = grid_value(g, row,     col + 1);
+    cell_sw = grid_value(g, row + 1, col);
+    cell_se = grid_value(g, row + 1, col + 1);
+    cell_grid = g;
+    cell_row = row;
+    cell_col = col;
+  }
+
+  float fx = x - col;
+  float n = cell_nw + (cell_ne - cell_nw) * fx;
+  float s = cell_sw + (cell_se - cell_sw) * fx;
+  return n + (s - n) * (y - row);
+}
+
+#if defined(USE_GEOID_GRID)
+
+#if !defined(GEOID_GRID_MAX_CELLS)
+#define GEOID_GRID_MAX_CELLS  65536
+#endif
+
+static int32_t get_le32(const uint8_t *p)
+{
+  return (int32_t) (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+/* replaces the regional grid, if the file is good */
+bool Geoid_load(const char *path)
+{
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return false;
+
+  uint8_t hdr[20];
+  if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)
+      || memcmp(hdr, GEOID_GRID_MAGIC, 4) != 0) {
+    fclose(fp);
+    return false;
+  }
+
+  float north = get_le32(&hdr[4])  * 1e-6f;
+  float west  = get_le32(&hdr[8])  * 1e-6f;
+  float step  = get_le32(&hdr[12]) * 1e-6f;
+  int   rows  = hdr[16] | (hdr[17] << 8);
+  int   cols  = hdr[18] | (hdr[19] << 8);
+  size_t cells = (size_t) rows * cols;
+
+  if (step <= 0 || rows < 2 || cols < 2 || cells > GEOID_GRID_MAX_CELLS) {
+    fclose(fp);
+    return false;
+  }
+
+  size_t size = cells * sizeof(int16_t);
+  int16_t *cm;
+#if defined(ESP32)
+  cm = (int16_t *) (psramFound() ? ps_malloc(size) : malloc(size));
+#else
+  cm = (int16_t *) malloc(size);
+#endif
+  if (cm == NULL) {
+    fclose(fp);
+    return false;
+  }
+
+  uint8_t *p = (uint8_t *) cm;
+  bool ok = (fread(p, 1, size, fp) == size);
+  fclose(fp);
+  if (! ok) {
+    free(cm);
+    return false;
+  }
+  for (size_t i=0; i < cells; i++)        /* the file is little-endian */
+    cm[i] = (int16_t) (p[2*i] | (p[2*i+1] << 8));
+
+  int16_t *old = regional_cm;
+  regional_cm = NULL;
+  cell_grid = NULL;
+  if (old != NULL)
+    free(old);
+
+  regional.north    = north;
+  regional.west     = west;
+  regional.inv_step = 1.0f / step;
+  regional.rows     = rows;
+  regional.cols     = cols;
+  regional.wrap     = false;
+  regional_cm = cm;
+
+  return true;
+}
+
+#endif /* USE_GEOID_GRID */
+
+#endif /* EXCLUDE_EGM96 */
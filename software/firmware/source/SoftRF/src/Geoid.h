@@ -0,0 +1,43 @@
+/*
+ * Geoid.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GEOID_H
+#define GEOID_H
+
+/*
+ * Geoid separation (meters) interpolated bilinearly in the 2 degree EGM96
+ * grid, or in a finer regional grid if one was loaded and covers the spot.
+ *
+ * Regional grid file, little-endian (software/utils/geoid_grid.py):
+ *   char     magic[4]      "SRGD"
+ *   int32_t  north         latitude of the first row, 1e-6 degrees
+ *   int32_t  west          longitude of the first column, 1e-6 degrees
+ *   int32_t  step          1e-6 degrees, the same along both axes
+ *   uint16_t rows, cols
+ *   int16_t  cm[rows][cols]    north to south, west to east
+ */
+
+#define GEOID_GRID_MAGIC    "SRGD"
+
+float LookupSeparation(float lat, float lon);
+
+#if defined(USE_GEOID_GRID)
+bool Geoid_load(const char *path);
+#endif
+
+#endif /* GEOID_H */
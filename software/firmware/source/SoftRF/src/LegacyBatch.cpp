@@ -0,0 +1,194 @@
+/*
+ * LegacyBatch.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system/SoC.h"
+#include "TrafficHelper.h"
+#include "LegacyBatch.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LEGACY_BATCH_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#define LEGACY_BATCH_SSE2
+#endif
+
+/* nothing closer than this is an alarm */
+#define LEGACY_MINSQDIST_INIT   (200*200*4*4)
+
+legacy_batch_t LegacyBatch;
+
+/*
+ * The search as it was in Alarm_Legacy(), one lane at a time.
+ * Arithmetic is done unsigned so that it wraps the same way as the SIMD code.
+ */
+static void LegacyBatch_Scalar(int from, int to)
+{
+  for (int l=from; l < to; l++) {
+    uint32_t dx = LegacyBatch.dx[l];
+    uint32_t dy = LegacyBatch.dy[l];
+    uint32_t sqdz = LegacyBatch.sqdz[l];
+    uint32_t minsqdist = LEGACY_MINSQDIST_INIT;
+    int32_t  mintime = ALARM_TIME_CLOSE;
+    int32_t  vxmin = 0;
+    int32_t  vymin = 0;
+
+    for (int t=0; t<LEGACY_STEPS; t++) {
+      int32_t vx = LegacyBatch.vx[t][l];
+      int32_t vy = LegacyBatch.vy[t][l];
+      dx += vx;   /* change in relative position over this second */
+      dy += vy;
+      uint32_t sqdist = dx*dx + dy*dy + sqdz;
+      if (sqdist < minsqdist) {
+        minsqdist = sqdist;
+        vxmin = vx;
+        vymin = vy;
+        mintime = t;
+      }
+    }
+
+    LegacyBatch.minsqdist[l] = minsqdist;
+    LegacyBatch.mintime[l]   = mintime;
+    LegacyBatch.vxmin[l]     = vxmin;
+    LegacyBatch.vymin[l]     = vymin;
+  }
+}
+
+#if defined(LEGACY_BATCH_NEON)
+
+static int LegacyBatch_Vector(int n)
+{
+  int l;
+  for (l=0; l+4 <= n; l+=4) {
+    int32x4_t  dx      = vld1q_s32(&LegacyBatch.dx[l]);
+    int32x4_t  dy      = vld1q_s32(&LegacyBatch.dy[l]);
+    int32x4_t  sqdz    = vld1q_s32(&LegacyBatch.sqdz[l]);
+    uint32x4_t minsq   = vdupq_n_u32(LEGACY_MINSQDIST_INIT);
+    int32x4_t  mintime = vdupq_n_s32(ALARM_TIME_CLOSE);
+    int32x4_t  vxmin   = vdupq_n_s32(0);
+    int32x4_t  vymin   = vdupq_n_s32(0);
+
+    for (int t=0; t<LEGACY_STEPS; t++) {
+      int32x4_t vx = vld1q_s32(&LegacyBatch.vx[t][l]);
+      int32x4_t vy = vld1q_s32(&LegacyBatch.vy[t][l]);
+      dx = vaddq_s32(dx, vx);
+      dy = vaddq_s32(dy, vy);
+      uint32x4_t sq = vreinterpretq_u32_s32(
+                        vaddq_s32(vmlaq_s32(vmulq_s32(dx, dx), dy, dy), sqdz));
+      uint32x4_t lt = vcltq_u32(sq, minsq);
+      minsq   = vbslq_u32(lt, sq, minsq);
+      mintime = vbslq_s32(lt, vdupq_n_s32(t), mintime);
+      vxmin   = vbslq_s32(lt, vx, vxmin);
+      vymin   = vbslq_s32(lt, vy, vymin);
+    }
+
+    vst1q_u32(&LegacyBatch.minsqdist[l], minsq);
+    vst1q_s32(&LegacyBatch.mintime[l],   mintime);
+    vst1q_s32(&LegacyBatch.vxmin[l],     vxmin);
+    vst1q_s32(&LegacyBatch.vymin[l],     vymin);
+  }
+  return l;
+}
+
+#elif defined(LEGACY_BATCH_SSE2)
+
+/* low 32 bits of a 32x32 product - pmulld is SSE4.1 only */
+static inline __m128i mullo_epi32(__m128i a, __m128i b)
+{
+#if defined(__SSE4_1__)
+  return _mm_mullo_epi32(a, b);
+#else
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static inline __m128i select_epi32(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static int LegacyBatch_Vector(int n)
+{
+  /* SSE2 only compares signed, flip the sign bits for an unsigned compare */
+  const __m128i bias = _mm_set1_epi32(0x80000000);
+  int l;
+
+  for (l=0; l+4 <= n; l+=4) {
+    __m128i dx      = _mm_loadu_si128((const __m128i *) &LegacyBatch.dx[l]);
+    __m128i dy      = _mm_loadu_si128((const __m128i *) &LegacyBatch.dy[l]);
+    __m128i sqdz    = _mm_loadu_si128((const __m128i *) &LegacyBatch.sqdz[l]);
+    __m128i minsq_b = _mm_xor_si128(_mm_set1_epi32(LEGACY_MINSQDIST_INIT), bias);
+    __m128i mintime = _mm_set1_epi32(ALARM_TIME_CLOSE);
+    __m128i vxmin   = _mm_setzero_si128();
+    __m128i vymin   = _mm_setzero_si128();
+
+    for (int t=0; t<LEGACY_STEPS; t++) {
+      __m128i vx = _mm_loadu_si128((const __m128i *) &LegacyBatch.vx[t][l]);
+      __m128i vy = _mm_loadu_si128((const __m128i *) &LegacyBatch.vy[t][l]);
+      dx = _mm_add_epi32(dx, vx);
+      dy = _mm_add_epi32(dy, vy);
+      __m128i sq_b = _mm_xor_si128(_mm_add_epi32(_mm_add_epi32(mullo_epi32(dx, dx),
+                                                               mullo_epi32(dy, dy)),
+                                                 sqdz), bias);
+      __m128i lt = _mm_cmplt_epi32(sq_b, minsq_b);
+      minsq_b = select_epi32(lt, sq_b, minsq_b);
+      mintime = select_epi32(lt, _mm_set1_epi32(t), mintime);
+      vxmin   = select_epi32(lt, vx, vxmin);
+      vymin   = select_epi32(lt, vy, vymin);
+    }
+
+    _mm_storeu_si128((__m128i *) &LegacyBatch.minsqdist[l], _mm_xor_si128(minsq_b, bias));
+    _mm_storeu_si128((__m128i *) &LegacyBatch.mintime[l],   mintime);
+    _mm_storeu_si128((__m128i *) &LegacyBatch.vxmin[l],     vxmin);
+    _mm_storeu_si128((__m128i *) &LegacyBatch.vymin[l],     vymin);
+  }
+  return l;
+}
+
+#else
+
+/*
+ * No SIMD unit suitable for 32-bit lanes (ESP32, and the Cortex-M4 DSP
+ * extension of nRF52 which only packs 16-bit values): plain loops.
+ */
+static int LegacyBatch_Vector(int n)
+{
+  (void) n;
+
+  return 0;
+}
+
+#endif
+
+/* search lanes 0 ... n-1 */
+void LegacyBatch_Search(int n)
+{
+  if (n <= 0)
+    return;
+
+  /* whole SIMD groups, the spare lanes at the end are searched and ignored */
+  int done = (n > 1 ? LegacyBatch_Vector((n + 3) & ~3) : 0);
+  if (done < n)
+    LegacyBatch_Scalar(done, n);
+}
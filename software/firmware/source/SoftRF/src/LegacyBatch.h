@@ -0,0 +1,52 @@
+/*
+ * LegacyBatch.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LEGACYBATCH_H
+#define LEGACYBATCH_H
+
+#include "system/SoC.h"
+
+/*
+ * Closest-approach search of the Legacy alarm method (see Alarm_Legacy()),
+ * for many targets at once.  Each target is one lane of a
+ * structure-of-arrays, so that SIMD units can step 4 targets per instruction.
+ * All quantities are integers in quarter-meters (per second), as before.
+ */
+
+#define LEGACY_STEPS    18    /* 1-second time points searched */
+#define LEGACY_LANES    ((MAX_TRACKING_OBJECTS + 3) & ~3)
+
+typedef struct legacy_batch_struct {
+  /* inputs */
+  int32_t   dx[LEGACY_LANES];           /* relative position at the start */
+  int32_t   dy[LEGACY_LANES];
+  int32_t   sqdz[LEGACY_LANES];         /* squared vertical separation */
+  int32_t   vx[LEGACY_STEPS][LEGACY_LANES];  /* relative velocity, each second */
+  int32_t   vy[LEGACY_STEPS][LEGACY_LANES];
+  /* outputs */
+  uint32_t  minsqdist[LEGACY_LANES];
+  int32_t   mintime[LEGACY_LANES];
+  int32_t   vxmin[LEGACY_LANES];        /* relative velocity at that time */
+  int32_t   vymin[LEGACY_LANES];
+} legacy_batch_t;
+
+extern legacy_batch_t LegacyBatch;
+
+void LegacyBatch_Search(int);
+
+#endif /* LEGACYBATCH_H */
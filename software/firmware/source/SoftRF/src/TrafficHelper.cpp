@@ -20,7 +20,10 @@
 
 #include "../SoftRF.h"
 #include "system/SoC.h"
+#include "system/LinkQ.h"
 #include "TrafficHelper.h"
+#include "TrafficStore.h"
+#include "LegacyBatch.h"
 #include "driver/EEPROM.h"
 #include "driver/RF.h"
 #include "driver/GNSS.h"
@@ -30,6 +33,7 @@
 #include "protocol/radio/Legacy.h"
 #include "protocol/data/NMEA.h"
 #include "protocol/data/IGC.h"
+#include "protocol/data/Recorder.h"
 #include "ApproxMath.h"
 #include "Wind.h"
 
@@ -59,6 +63,9 @@ float average_baro_alt_diff = 0;
 
 static int8_t (*Alarm_Level)(ufo_t *, ufo_t *);
 
+/* an impossible latitude forces the first update */
+own_frame_t OwnFrame = { 999.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
 static uint32_t Alarm_timer = 0;
 
 /*
@@ -70,6 +77,28 @@ static int8_t Alarm_None(ufo_t *this_aircraft, ufo_t *fop)
   return ALARM_LEVEL_NONE;
 }
 
+/*
+ * Refresh OwnFrame if ThisAircraft has moved or turned since last time.
+ * Computed once per GNSS fix rather than once per target - and in single
+ * precision, double arithmetic is done in software on the ESP32 and nRF52.
+ */
+void OwnFrame_update()
+{
+  if (ThisAircraft.latitude  == OwnFrame.latitude
+   && ThisAircraft.longitude == OwnFrame.longitude
+   && ThisAircraft.course    == OwnFrame.course
+   && ThisAircraft.speed     == OwnFrame.speed)
+    return;
+
+  OwnFrame.latitude     = ThisAircraft.latitude;
+  OwnFrame.longitude    = ThisAircraft.longitude;
+  OwnFrame.course       = ThisAircraft.course;
+  OwnFrame.speed        = ThisAircraft.speed;
+  OwnFrame.m_per_deg_lon = OWN_M_PER_DEG_LAT * CosLat(ThisAircraft.latitude);
+  OwnFrame.vel_ns       = ThisAircraft.speed * cos_approx(ThisAircraft.course);
+  OwnFrame.vel_ew       = ThisAircraft.speed * sin_approx(ThisAircraft.course);
+}
+
 /*
  * Adjust relative altitude for relative vertical speed.
  */
@@ -151,7 +180,7 @@ static int8_t Alarm_Vector(ufo_t *this_aircraft, ufo_t *fop)
     /* save CPU cycles */
   }
 
-  if (distance / (fop->speed + this_aircraft->speed)
+  if (div_approx(distance, fop->speed + this_aircraft->speed)
          > ALARM_TIME_CLOSE * _GPS_MPS_PER_KNOT) {
     return ALARM_LEVEL_NONE;
     /* save CPU cycles */
@@ -167,7 +196,8 @@ static int8_t Alarm_Vector(ufo_t *this_aircraft, ufo_t *fop)
 //      return Alarm_Distance(this_aircraft, fop);
 //  }
 
-  float V_rel_magnitude, V_rel_direction, t;
+  float V_rel_magnitude, V_rel_direction;
+  float t = ALARM_TIME_CLOSE;   /* not computed if too high, too low or too slow */
 
   if (fabs(fop->adj_alt_diff) < VERTICAL_SEPARATION) {  /* no alarms if too high or too low */
 
@@ -178,10 +208,9 @@ static int8_t Alarm_Vector(ufo_t *this_aircraft, ufo_t *fop)
            adj_distance = distance;
 
     /* Subtract 2D velocity vector of traffic from 2D velocity vector of this aircraft */ 
-    float V_rel_y = this_aircraft->speed * cos_approx(this_aircraft->course) -
-                    fop->speed * cos_approx(fop->course);                      /* N-S */
-    float V_rel_x = this_aircraft->speed * sin_approx(this_aircraft->course) -
-                    fop->speed * sin_approx(fop->course);                      /* E-W */
+    /* - the latter from OwnFrame, this_aircraft is always &ThisAircraft here */
+    float V_rel_y = OwnFrame.vel_ns - fop->speed * cos_approx(fop->course);   /* N-S */
+    float V_rel_x = OwnFrame.vel_ew - fop->speed * sin_approx(fop->course);   /* E-W */
 
     V_rel_magnitude = approxHypotenuse(V_rel_x, V_rel_y) * _GPS_MPS_PER_KNOT;
     V_rel_direction = atan2_approx(V_rel_y, V_rel_x);     /* direction fop is coming from */
@@ -193,7 +222,7 @@ static int8_t Alarm_Vector(ufo_t *this_aircraft, ufo_t *fop)
       /* time is seconds prior to impact */
       /* take altitude difference into account */
 
-      t = adj_distance / V_rel_magnitude;
+      t = div_approx(adj_distance, V_rel_magnitude);
 
       float rel_angle = fabs(V_rel_direction - fop->bearing);
 
@@ -273,8 +302,16 @@ static int8_t Alarm_Vector(ufo_t *this_aircraft, ufo_t *fop)
  * The new 2024 protocol sends speed, direction, and turn rate explicitly instead.
  * Either way, this algorithm assumes that circling aircraft will keep circling
  * for the relevant time period (the next 19 seconds).
+ *
+ * The work is split in three so that Traffic_loop() can run the
+ * closest-approach search for all targets in one pass (LegacyBatch.cpp):
+ * Legacy_Prepare() fills one lane of LegacyBatch or returns a level
+ * right away, LegacyBatch_Search() does the search, and Legacy_Finish()
+ * turns the result into an alarm level.
  */
-static int8_t Alarm_Legacy(ufo_t *this_aircraft, ufo_t *fop)
+#define LEGACY_DEFERRED  (-1)   /* Legacy_Prepare(): level follows from the search */
+
+static int8_t Legacy_Prepare(ufo_t *this_aircraft, ufo_t *fop, int lane)
 {
   if (fop->distance > 2*ALARM_ZONE_CLOSE
       || fabs(fop->adj_alt_diff) > VERTICAL_SEPARATION) {
@@ -282,7 +319,7 @@ static int8_t Alarm_Legacy(ufo_t *this_aircraft, ufo_t *fop)
     /* save CPU cycles */
   }
 
-  if (fop->distance / (fop->speed + this_aircraft->speed)
+  if (div_approx(fop->distance, fop->speed + this_aircraft->speed)
          > ALARM_TIME_LOW * _GPS_MPS_PER_KNOT) {
     return ALARM_LEVEL_NONE;
     /* save CPU cycles */
@@ -420,11 +457,6 @@ static int8_t Alarm_Legacy(ufo_t *this_aircraft, ufo_t *fop)
   int dx = fop->dx << 2;
   int dy = fop->dy << 2;
 
-  /* project paths over time and find minimum 3D distance */
-  uint32_t minsqdist = 200*200*4*4;
-  int mintime = ALARM_TIME_CLOSE;
-  int vxmin = 0;
-  int vymin = 0;
   /* if projections are from different times, offset the arrays */
   if (fop->projtime_ms > this_aircraft->projtime_ms + 500) {
     /* this_aircraft projection is older, shift by 1 second */
@@ -442,25 +474,29 @@ static int8_t Alarm_Legacy(ufo_t *this_aircraft, ufo_t *fop)
     i = 0;
     j = 0;
   }
+  /* hand the relative path to the search, as one lane of LegacyBatch */
+  LegacyBatch.dx[lane]   = dx;
+  LegacyBatch.dy[lane]   = dy;
+  LegacyBatch.sqdz[lane] = (adjdz*adjdz) << 4;
   int t;
-  int sqdz = (adjdz*adjdz) << 4;
-  for (t=0; t<18; t++) {  /* loop over the 1-second time points prepared */
-    vx = thatvx[i] - thisvx[j];   /* relative velocity */
-    vy = thatvy[i] - thisvy[j];
-    dx += vx;   /* change in relative position over this second */
-    dy += vy;
-    /* dz += vz; */
-    uint32_t sqdist = dx*dx + dy*dy + sqdz;
-    if (sqdist < minsqdist) {
-      minsqdist = sqdist;
-      vxmin = vx;
-      vymin = vy;
-      mintime = t;
-    }
+  for (t=0; t<LEGACY_STEPS; t++) {  /* the 1-second time points prepared */
+    LegacyBatch.vx[t][lane] = thatvx[i] - thisvx[j];   /* relative velocity */
+    LegacyBatch.vy[t][lane] = thatvy[i] - thisvy[j];
     ++i;
     ++j;
   }
 
+  return LEGACY_DEFERRED;
+}
+
+static int8_t Legacy_Finish(ufo_t *this_aircraft, ufo_t *fop, int lane)
+{
+  /* minimum 3D distance along the projected paths, from LegacyBatch_Search() */
+  uint32_t minsqdist = LegacyBatch.minsqdist[lane];
+  int mintime = LegacyBatch.mintime[lane];
+  int vxmin = LegacyBatch.vxmin[lane];
+  int vymin = LegacyBatch.vymin[lane];
+
   int8_t rval = ALARM_LEVEL_NONE;
 
   /* try and set thresholds for alarms with gaggles - and tows - in mind */
@@ -525,13 +561,25 @@ static int8_t Alarm_Legacy(ufo_t *this_aircraft, ufo_t *fop)
   return rval;
 }
 
-void Traffic_Update(ufo_t *fop)
+static int8_t Alarm_Legacy(ufo_t *this_aircraft, ufo_t *fop)
+{
+  int8_t rval = Legacy_Prepare(this_aircraft, fop, 0);
+  if (rval != LEGACY_DEFERRED)
+    return rval;
+
+  LegacyBatch_Search(1);
+  return Legacy_Finish(this_aircraft, fop, 0);
+}
+
+/* relative position - returns false if no alarm is to be computed */
+/* OwnFrame must be up to date */
+static bool Traffic_Relative(ufo_t *fop)
 {
   /* use an approximation for distance & bearing between 2 points */
   float x, y;
   if (fop->protocol != RF_PROTOCOL_ADSB_1090) {
-    y = 111300.0 * (fop->latitude  - ThisAircraft.latitude);         /* meters */
-    x = 111300.0 * (fop->longitude - ThisAircraft.longitude) * CosLat(ThisAircraft.latitude);
+    y = OWN_M_PER_DEG_LAT * (fop->latitude - OwnFrame.latitude);          /* meters */
+    x = OwnFrame.m_per_deg_lon * (fop->longitude - OwnFrame.longitude);
     fop->distance = approxHypotenuse(x, y);      /* meters  */
     fop->bearing = atan2_approx(y, x);           /* degrees from ThisAircraft to fop */
     fop->dx = (int32_t) x;
@@ -555,34 +603,135 @@ void Traffic_Update(ufo_t *fop)
   if ((fop->airborne == 0 || ThisAircraft.airborne == 0)
             /* && (millis() - SetupTimeMarker > 60000) */ ) {
     fop->alarm_level = ALARM_LEVEL_NONE;
-    return;
+    return false;
   }
 
+  return true;
+}
+
+/* follows a new fop->alarm_level */
+static void Traffic_Alert(ufo_t *fop)
+{
+  /* Sound an alarm if new alert, or got closer than previous alert,     */
+  /* or (hysteresis) got two levels farther, and then closer.            */
+  /* E.g., if alarm was for LOW, alert_level was set to LOW.             */
+  /* A new alarm alert will sound if close enough to now be IMPORTANT.   */
+  /* If gone to CLOSE, then back to LOW, still no new alarm.             */
+  /* If now gone to NONE (farther than CLOSE), set alert_level to CLOSE, */
+  /* then next time returns to alarm_level LOW will give an alert.       */
+
+  if (fop->alarm_level < fop->alert_level) {    /* if just less by 1...   */
+      fop->alert_level = fop->alarm_level + 1;  /* ...then no change here */
+  }
+  if (Alarm_timer != 0 && fop->alert_level > ALARM_LEVEL_NONE && millis() > Alarm_timer) {
+      --fop->alert_level;
+      Alarm_timer = 0;
+  }
+}
+
+void Traffic_Update(ufo_t *fop)
+{
+  OwnFrame_update();
+
+  if (! Traffic_Relative(fop))
+    return;
+
   if (Alarm_Level) {
       fop->alarm_level = (*Alarm_Level)(&ThisAircraft, fop);
+      Traffic_Alert(fop);
+  }
+}
 
-      /* Sound an alarm if new alert, or got closer than previous alert,     */
-      /* or (hysteresis) got two levels farther, and then closer.            */
-      /* E.g., if alarm was for LOW, alert_level was set to LOW.             */
-      /* A new alarm alert will sound if close enough to now be IMPORTANT.   */
-      /* If gone to CLOSE, then back to LOW, still no new alarm.             */
-      /* If now gone to NONE (farther than CLOSE), set alert_level to CLOSE, */
-      /* then next time returns to alarm_level LOW will give an alert.       */
+/*
+ * Traffic_Update() of all entries that are due, for the Legacy alarm method.
+ * The closest-approach searches are done together in one LegacyBatch pass,
+ * everything else in slot order - same results as one entry at a time.
+ */
+static void Traffic_Update_Legacy()
+{
+  /* per slot: lane in LegacyBatch, or one of these */
+  enum { NOT_DUE = -1, NOT_AIRBORNE = -2, HAVE_LEVEL = -3 };
 
-      if (fop->alarm_level < fop->alert_level) {    /* if just less by 1...   */
-          fop->alert_level = fop->alarm_level + 1;  /* ...then no change here */
-      }
-      if (Alarm_timer != 0 && fop->alert_level > ALARM_LEVEL_NONE && millis() > Alarm_timer) {
-          --fop->alert_level;
-          Alarm_timer = 0;
-      }
+  int8_t  rval[MAX_TRACKING_OBJECTS];
+  int16_t lane[MAX_TRACKING_OBJECTS];
+  int     nlanes = 0;
+
+  OwnFrame_update();
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    ufo_t *fop = &Container[i];
+
+    lane[i] = NOT_DUE;
+    if (fop->addr == 0
+        || (ThisAircraft.timestamp - fop->timestamp) < TRAFFIC_VECTOR_UPDATE_INTERVAL)
+      continue;
+    /* else Traffic_Update(fop) was called last time a radio packet came in */
+
+    if (! Traffic_Relative(fop)) {
+      lane[i] = NOT_AIRBORNE;
+      continue;
+    }
+    rval[i] = Legacy_Prepare(&ThisAircraft, fop, nlanes);
+    lane[i] = (rval[i] == LEGACY_DEFERRED ? nlanes++ : HAVE_LEVEL);
+  }
+
+  LegacyBatch_Search(nlanes);
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    ufo_t *fop = &Container[i];
+
+    if (lane[i] == NOT_DUE)
+      continue;
+    if (lane[i] != NOT_AIRBORNE) {
+      fop->alarm_level = (lane[i] == HAVE_LEVEL ? rval[i]
+                          : Legacy_Finish(&ThisAircraft, fop, lane[i]));
+      Traffic_Alert(fop);
+    }
+    TrafficStore_Commit(i);
   }
 }
 
+static uint32_t lastrelay = 0;
+static uint32_t relay_pending = 0;  /* address of a relay RF_task() has not sent yet */
+
+/* the relayed frame of this aircraft went out */
+static void relay_sent(ufo_t *fop)
+{
+    fop->timerelayed = ThisAircraft.timestamp;
+    // Serial.print("Relayed packet from ");
+    // Serial.println(fop->addr, HEX);
+    if ((settings->nmea_d || settings->nmea2_d) && (settings->debug_flags)) {
+      snprintf_P(NMEABuffer, sizeof(NMEABuffer),
+        PSTR("$PSARL,1,%06X,%ld\r\n"),
+        fop->addr, fop->timerelayed);
+      NMEA_Outs(settings->nmea_d, settings->nmea2_d, NMEABuffer, strlen(NMEABuffer), false);
+    }
+}
+
+/* whether the frame air_relay() queued for RF_task() was sent */
+static void relay_check()
+{
+    if (relay_pending == 0)
+        return;
+
+    int sent = RF_Transmit_Result();
+    if (sent < 0)
+        return;
+    if (sent > 0) {
+        int i = TrafficStore_Find(relay_pending);
+        if (i >= 0)
+            relay_sent(&Container[i]);
+    } else {
+        lastrelay = 0;      /* dropped at the end of the slot, another may go */
+    }
+    relay_pending = 0;
+}
+
 /* relay landed-traffic if we are airborne */
 bool air_relay(ufo_t *fop)
 {
-    static uint32_t lastrelay = 0;
+    if (relay_pending != 0)
+        return true;
 
     //if (fop->airborne && (millis() > SetupTimeMarker + 60000)) {
     bool often = false;
@@ -621,17 +770,12 @@ bool air_relay(ufo_t *fop)
         relayed = RF_Transmit(sizeof(legacy_packet_t), true);
 
     if (relayed) {
-        fop->timerelayed = ThisAircraft.timestamp;
         lastrelay = millis();
         relay_waiting = false;
-        // Serial.print("Relayed packet from ");
-        // Serial.println(fop->addr, HEX);
-        if ((settings->nmea_d || settings->nmea2_d) && (settings->debug_flags)) {
-          snprintf_P(NMEABuffer, sizeof(NMEABuffer),
-            PSTR("$PSARL,1,%06X,%ld\r\n"),
-            fop->addr, fop->timerelayed);
-          NMEA_Outs(settings->nmea_d, settings->nmea2_d, NMEABuffer, strlen(NMEABuffer), false);
-        }
+        if (RF_Transmit_Result() < 0)
+            relay_pending = fop->addr;  /* RF_task() sends it later in the slot */
+        else
+            relay_sent(fop);
     } else {
 #if 0
         if ((settings->nmea_d || settings->nmea2_d) && (settings->debug_flags)) {
@@ -665,12 +809,11 @@ void AddTraffic(ufo_t *fop)
     }
 
     /* first check whether we are already tracking this object */
-    int i;
-    for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    int i = TrafficStore_Find(fop->addr);
 
-      cip = &Container[i];
+    if (i >= 0) {
 
-      if (cip->addr == fop->addr) {
+        cip = &Container[i];
 
         bool fop_adsb = fop->protocol == RF_PROTOCOL_GDL90 || fop->protocol == RF_PROTOCOL_ADSB_1090;
         bool cip_adsb = cip->protocol == RF_PROTOCOL_GDL90 || cip->protocol == RF_PROTOCOL_ADSB_1090;
@@ -682,6 +825,7 @@ void AddTraffic(ufo_t *fop)
             // was tracked via other means, but expired - take over this slot
             *cip = *fop;
             Traffic_Update(cip);
+            TrafficStore_Commit(i);
             return;
         }
 
@@ -689,6 +833,7 @@ void AddTraffic(ufo_t *fop)
         if (cip_adsb && ! fop_adsb) {
             *cip = *fop;
             Traffic_Update(cip);
+            TrafficStore_Commit(i);
             return;
         }
 
@@ -705,6 +850,7 @@ void AddTraffic(ufo_t *fop)
                 cip->last_crc    = fop->last_crc;      // so 2nd time slot packet will be ignored
                 cip->timestamp   = fop->timestamp;     // so it won't expire
                 cip->timerelayed = fop->timerelayed;   // in case relayed above
+                TrafficStore_Commit(i);
                 return;
         }
 
@@ -740,9 +886,9 @@ void AddTraffic(ufo_t *fop)
 
         /* Now old alert_level is in same structure, can update alarm_level:  */
         Traffic_Update(cip);    // also updates distance, alt_diff
+        TrafficStore_Commit(i);
 
         return;
-      }
     }
 
     /* new object, try and find a slot for it */
@@ -755,80 +901,62 @@ void AddTraffic(ufo_t *fop)
     // this updates fop->timerelayed, to be copied later into container[]
 
     /* replace an empty object if found */
-    for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (Container[i].addr == 0) {
+    i = TrafficStore_Alloc();
+    if (i >= 0) {
         Container[i] = *fop;
+        TrafficStore_Commit(i);
         return;
-      }
     }
     /* replace an expired object if found */
-    for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (timenow - Container[i].timestamp > ENTRY_EXPIRATION_TIME) {
+    i = TrafficStore_Oldest();
+    if (i >= 0 && timenow - Container[i].timestamp > ENTRY_EXPIRATION_TIME) {
         Container[i] = *fop;
+        TrafficStore_Commit(i);
         return;
-      }
     }
 
     /* may need to replace a non-expired object:   */
     /* identify the least important current object */
+    /*   - lowest alarm level, then farthest away (distance adjusted   */
+    /*     for altitude difference), the "followed" one last of equals */
 
     uint32_t follow_id = settings->follow_id;
 
+    i = TrafficStore_LeastImportant();
+    if (i < 0)
+        return;
+    cip = &Container[i];
+
     /* replace an object of lower alarm level if found */
 
     if (fop->alarm_level > ALARM_LEVEL_NONE) {
-      int min_level_ndx = 0;
-      int min_level = fop->alarm_level;
-      for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
-        if (Container[i].alarm_level < min_level) {
-          min_level_ndx = i;
-          min_level = Container[i].alarm_level;
-        } else if (Container[min_level_ndx].addr == follow_id
-                     && min_level < fop->alarm_level
-                     && Container[i].alarm_level == min_level) {
-          min_level_ndx = i;
-        }
-      }
-      if (min_level < fop->alarm_level) {
-          Container[min_level_ndx] = *fop;
+      if (cip->alarm_level < fop->alarm_level) {
+          *cip = *fop;
+          TrafficStore_Commit(i);
           return;
       }
     }
 
-    /* identify the farthest-away non-"followed" object */
-    /*    (distance adjusted for altitude difference)   */
-
-    int max_dist_ndx = MAX_TRACKING_OBJECTS;
-    float max_adj_dist = 0;
-    float adj_distance;
-    for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (Container[i].alarm_level == ALARM_LEVEL_NONE
-          && Container[i].addr != follow_id) {
-        adj_distance = Container[i].distance;
-        if (Container[i].adj_distance > adj_distance)
-              adj_distance = Container[i].adj_distance;
-        if (adj_distance > max_adj_dist)  {
-          max_dist_ndx = i;
-          max_adj_dist = adj_distance;
-        }
-      }
-    }
-
-    /* replace the farthest currently-tracked object, */
+    /* replace the farthest currently-tracked non-"followed" object, */
     /* but only if the new object is closer (or "followed", or relayed) */
-    adj_distance = fop->adj_distance;
-    if (max_dist_ndx < MAX_TRACKING_OBJECTS
-      && (adj_distance < max_adj_dist
+    if (cip->alarm_level == ALARM_LEVEL_NONE && cip->addr != follow_id) {
+      float max_adj_dist = cip->distance;
+      if (cip->adj_distance > max_adj_dist)
+            max_adj_dist = cip->adj_distance;
+      if (fop->adj_distance < max_adj_dist
           || fop->addr == follow_id
-          || (do_relay && fop->timerelayed > 0))) {
-      Container[max_dist_ndx] = *fop;
-      return;
+          || (do_relay && fop->timerelayed > 0)) {
+        *cip = *fop;
+        TrafficStore_Commit(i);
+        return;
+      }
     }
 
     /* otherwise, no slot found, ignore the new object */
 }
 
-void ParseData(void)
+/* the frame in RxBuffer */
+static void ParseFrame(void)
 {
     uint8_t rf_protocol = settings->rf_protocol;
     size_t rx_size = RF_Payload_Size(rf_protocol);
@@ -846,7 +974,12 @@ void ParseData(void)
       StdOut.print(F("$PSRFI,"));
       StdOut.print((unsigned long) now()); StdOut.print(F(","));
       StdOut.print(Bin2Hex(fo_raw, rx_size)); StdOut.print(F(","));
-      StdOut.println(RF_last_rssi);
+      StdOut.print(RF_last_rssi);
+      if (RF_last_fixed > 0) {
+        /* bits corrected by the FEC */
+        StdOut.print(F(",")); StdOut.print(RF_last_fixed);
+      }
+      StdOut.println();
     }
 
     fo = EmptyFO;  /* to ensure no data from past packets remains in any field */
@@ -858,12 +991,27 @@ void ParseData(void)
         return;
 
     fo.rssi = RF_last_rssi;
+    LinkQ_Packet(&fo);
+
+#if defined(USE_SD_CARD)
+    Recorder_traffic(&fo, REC_PACKET, 0);
+#endif
 
     AddTraffic(&fo);
 }
 
+/* the frame RF_Receive() returned, and all others queued since */
+void ParseData(void)
+{
+    do {
+        ParseFrame();
+    } while (RF_Queue_Get());
+}
+
 void Traffic_setup()
 {
+  TrafficStore_setup();
+
   switch (settings->alarm)
   {
   case TRAFFIC_ALARM_NONE:
@@ -927,6 +1075,8 @@ void logCloseTraffic()
 
 void Traffic_loop()
 {
+    relay_check();
+
     if (! isTimeToUpdateTraffic())
         return;
 
@@ -937,17 +1087,28 @@ void Traffic_loop()
     int sound_alarm_level = ALARM_LEVEL_NONE;    /* local, used for sound alerts */
     int alarmcount = 0;
 
+    /* purge expired ufos first, oldest-first off the expiry heap */
+    ClearExpired();
+
+    if (Alarm_Level == &Alarm_Legacy) {
+      Traffic_Update_Legacy();
+    } else {
+      for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+        ufo_t *fop = &Container[i];
+        if (fop->addr
+            && (ThisAircraft.timestamp - fop->timestamp) >= TRAFFIC_VECTOR_UPDATE_INTERVAL) {
+          Traffic_Update(fop);
+          TrafficStore_Commit(i);
+        }
+        /* else Traffic_Update(fop) was called last time a radio packet came in */
+      }
+    }
+
     for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
 
       ufo_t *fop = &Container[i];
 
       if (fop->addr) {  /* non-empty ufo */
-      
-        if (ThisAircraft.timestamp - fop->timestamp <= ENTRY_EXPIRATION_TIME) {
-
-          if ((ThisAircraft.timestamp - fop->timestamp) >= TRAFFIC_VECTOR_UPDATE_INTERVAL)
-              Traffic_Update(fop);
-          /* else Traffic_Update(fop) was called last time a radio packet came in */
 
           /* determine the highest alarm level seen at the moment */
           if (fop->alarm_level > max_alarm_level)
@@ -960,6 +1121,11 @@ void Traffic_loop()
                   alarm_ahead = true;
           }
 
+#if defined(USE_SD_CARD)
+          if (fop->alarm_level > ALARM_LEVEL_NONE)
+              Recorder_traffic(fop, REC_ALARM, fop->alarm_level);
+#endif
+
           /* figure out what is the highest alarm level needing a sound alert */
           if (fop->alarm_level > fop->alert_level
                    && fop->alarm_level > ALARM_LEVEL_CLOSE) {
@@ -969,21 +1135,6 @@ void Traffic_loop()
                   mfop = fop;
               }
           }
-
-        } else {   /* expired ufo */
-
-          fop->addr = 0;
-
-          //*fop = EmptyFO;
-
-          /* implied by emptyFO:
-          fop->addr = 0;
-          fop->alert = 0;
-          fop->alarm_level = 0;
-          fop->alert_level = 0;
-          fop->prevtime_ms = 0;
-          etc... */
-        }
       }
     }
 
@@ -1058,6 +1209,8 @@ Serial.println(NMEABuffer);
           }
         }
 #if defined(USE_SD_CARD)
+        Recorder_traffic(mfop, REC_NOTIFY,
+                         mfop->alarm_level + 16 * (alarmcount > 15 ? 15 : alarmcount));
         if (settings->logalarms || settings->logflight == FLIGHT_LOG_TRAFFIC) {
             logOneTraffic(mfop, "LPLTA");  // do not wait until logFlightPosition()
         //} else if (settings->logflight != FLIGHT_LOG_NONE) {
@@ -1076,30 +1229,23 @@ Serial.println(NMEABuffer);
     UpdateTrafficTimeMarker = millis();
 }
 
-// currently this function is not called from anywhere (in "normal" mode)
-//   - instead expired entries are purged in Traffic_loop()
+// called from Traffic_loop(), and directly from some other loops
+//   - only looks at the top of the expiry heap, so cheap when nothing expired
 void ClearExpired()
 {
-  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-    if (Container[i].addr &&
-         (ThisAircraft.timestamp - Container[i].timestamp) > ENTRY_EXPIRATION_TIME) {
-      //Container[i] = EmptyFO;
-      Container[i].addr = 0;
-    }
+  int i;
+  while ((i = TrafficStore_Oldest()) >= 0
+         && (ThisAircraft.timestamp - Container[i].timestamp) > ENTRY_EXPIRATION_TIME) {
+    /* only the addr is cleared, as before:
+       fop->alert, alarm_level, alert_level, prevtime_ms etc
+       are all overwritten when the slot is re-used */
+    TrafficStore_Remove(i);
   }
 }
 
 int Traffic_Count()
 {
-  int count = 0;
-
-  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-    if (Container[i].addr) {
-      count++;
-    }
-  }
-
-  return count;
+  return TrafficStore_Count();
 }
 
 /* this is used in Text_EPD.cpp for 'radar' display, */
@@ -52,6 +52,20 @@
 #define isTimeToUpdateTraffic() (millis() - UpdateTrafficTimeMarker > \
                                   TRAFFIC_UPDATE_INTERVAL_MS)
 
+/* meters per degree of latitude - and of longitude at the equator */
+#define OWN_M_PER_DEG_LAT   111300.0f
+
+/* ThisAircraft as seen by the per-target computations, see OwnFrame_update() */
+typedef struct own_frame_struct {
+  float latitude;         /* of the fix the rest was computed from */
+  float longitude;
+  float course;
+  float speed;            /* knots */
+  float m_per_deg_lon;    /* OWN_M_PER_DEG_LAT * CosLat(latitude) */
+  float vel_ns;           /* ground velocity, knots */
+  float vel_ew;
+} own_frame_t;
+
 typedef struct traffic_by_dist_struct {
   ufo_t *fop;
   float distance;
@@ -74,6 +88,7 @@ void Traffic_setup(void);
 void Traffic_loop(void);
 void ClearExpired(void);
 void Traffic_Update(ufo_t *fop);
+void OwnFrame_update(void);
 int  Traffic_Count(void);
 void logCloseTraffic(void);
 
@@ -84,6 +99,8 @@ void generate_random_id(void);
 extern ufo_t fo, Container[MAX_TRACKING_OBJECTS], EmptyFO;
 extern uint8_t fo_raw[34];
 extern traffic_by_dist_t traffic_by_dist[MAX_TRACKING_OBJECTS];
+extern own_frame_t OwnFrame;
+extern unsigned long UpdateTrafficTimeMarker;
 extern int max_alarm_level;
 extern bool alarm_ahead;
 extern bool relay_waiting;
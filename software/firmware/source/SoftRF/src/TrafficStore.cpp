@@ -0,0 +1,338 @@
+/*
+ * TrafficStore.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "system/SoC.h"
+#include "TrafficHelper.h"
+#include "TrafficStore.h"
+#include "driver/EEPROM.h"
+
+#define TS_NONE     ((ts_slot_t) -1)
+#define TS_MASK     (TRAFFIC_INDEX_SIZE - 1)
+
+/* hash buckets hold slot+1, so that 0 (as after reset) means empty */
+static ts_slot_t ts_index[TRAFFIC_INDEX_SIZE];
+static uint32_t  ts_key[MAX_TRACKING_OBJECTS];      /* addr as indexed, 0 = none */
+
+static ts_slot_t ts_free[MAX_TRACKING_OBJECTS];     /* stack of free slots */
+static ts_slot_t ts_free_pos[MAX_TRACKING_OBJECTS]; /* position in stack, or TS_NONE */
+static int       ts_nfree = 0;
+
+static ts_slot_t ts_age[MAX_TRACKING_OBJECTS];      /* heap: oldest timestamp on top */
+static ts_slot_t ts_age_pos[MAX_TRACKING_OBJECTS];
+static ts_slot_t ts_rank[MAX_TRACKING_OBJECTS];     /* heap: least important on top */
+static ts_slot_t ts_rank_pos[MAX_TRACKING_OBJECTS];
+static int       ts_nused = 0;
+
+static int       ts_count = 0;                      /* number of indexed addresses */
+
+static inline uint32_t ts_hash(uint32_t addr)
+{
+  /* Fibonacci hashing, ICAO & FLARM IDs are far from random in the low bits */
+  uint32_t h = addr * (uint32_t) 2654435761UL;
+  return (h >> 16) & TS_MASK;
+}
+
+/*
+ * Hash index
+ */
+
+static int ts_index_lookup(uint32_t addr)
+{
+  uint32_t h = ts_hash(addr);
+  for (int n=0; n < TRAFFIC_INDEX_SIZE; n++) {
+    ts_slot_t b = ts_index[h];
+    if (b == 0)
+      return -1;
+    if (ts_key[b-1] == addr)
+      return (b-1);
+    h = (h + 1) & TS_MASK;
+  }
+  return -1;
+}
+
+static void ts_index_insert(int slot, uint32_t addr)
+{
+  uint32_t h = ts_hash(addr);
+  while (ts_index[h] != 0)
+    h = (h + 1) & TS_MASK;
+  ts_index[h] = slot + 1;
+  ts_key[slot] = addr;
+  ++ts_count;
+}
+
+static void ts_index_delete(int slot)
+{
+  uint32_t addr = ts_key[slot];
+  if (addr == 0)
+    return;
+
+  uint32_t h = ts_hash(addr);
+  while (ts_index[h] != slot + 1) {
+    if (ts_index[h] == 0)
+      return;     /* not indexed - should not happen */
+    h = (h + 1) & TS_MASK;
+  }
+
+  /* backward-shift deletion keeps probe chains intact without tombstones */
+  uint32_t hole = h;
+  uint32_t j = h;
+  for (;;) {
+    j = (j + 1) & TS_MASK;
+    ts_slot_t b = ts_index[j];
+    if (b == 0)
+      break;
+    uint32_t home = ts_hash(ts_key[b-1]);
+    /* move entry back into the hole unless its home lies cyclically in (hole, j] */
+    if (((j - home) & TS_MASK) >= ((j - hole) & TS_MASK)) {
+      ts_index[hole] = b;
+      hole = j;
+    }
+  }
+  ts_index[hole] = 0;
+  ts_key[slot] = 0;
+  --ts_count;
+}
+
+/*
+ * Free list
+ */
+
+static void ts_free_push(int slot)
+{
+  if (ts_free_pos[slot] != TS_NONE)
+    return;
+  ts_free_pos[slot] = ts_nfree;
+  ts_free[ts_nfree++] = slot;
+}
+
+static void ts_free_take(int slot)
+{
+  int pos = ts_free_pos[slot];
+  if (pos == TS_NONE)
+    return;
+  ts_slot_t last = ts_free[--ts_nfree];
+  ts_free[pos] = last;
+  ts_free_pos[last] = pos;
+  ts_free_pos[slot] = TS_NONE;
+}
+
+/*
+ * Heaps
+ */
+
+/* true if slot a should be nearer the top of the expiry heap than slot b */
+static bool ts_older(int a, int b)
+{
+  return (Container[a].timestamp < Container[b].timestamp);
+}
+
+/*
+ * Replacement order, as in AddTraffic(): lower alarm level first,
+ * then farther (altitude-adjusted) distance, and the "followed"
+ * aircraft last among equals.
+ */
+static bool ts_less_important(int a, int b)
+{
+  ufo_t *fa = &Container[a];
+  ufo_t *fb = &Container[b];
+
+  if (fa->alarm_level != fb->alarm_level)
+    return (fa->alarm_level < fb->alarm_level);
+
+  bool fola = (fa->addr == settings->follow_id);
+  bool folb = (fb->addr == settings->follow_id);
+  if (fola != folb)
+    return folb;
+
+  float da = (fa->adj_distance > fa->distance ? fa->adj_distance : fa->distance);
+  float db = (fb->adj_distance > fb->distance ? fb->adj_distance : fb->distance);
+  return (da > db);
+}
+
+static void ts_heap_swap(ts_slot_t *heap, ts_slot_t *pos, int i, int j)
+{
+  ts_slot_t t = heap[i];
+  heap[i] = heap[j];
+  heap[j] = t;
+  pos[heap[i]] = i;
+  pos[heap[j]] = j;
+}
+
+static void ts_heap_fix(ts_slot_t *heap, ts_slot_t *pos,
+                        bool (*before)(int, int), int i)
+{
+  /* sift up */
+  while (i > 0) {
+    int parent = (i - 1) >> 1;
+    if (! (*before)(heap[i], heap[parent]))
+      break;
+    ts_heap_swap(heap, pos, i, parent);
+    i = parent;
+  }
+  /* sift down */
+  for (;;) {
+    int l = 2*i + 1;
+    int r = l + 1;
+    int m = i;
+    if (l < ts_nused && (*before)(heap[l], heap[m]))  m = l;
+    if (r < ts_nused && (*before)(heap[r], heap[m]))  m = r;
+    if (m == i)
+      break;
+    ts_heap_swap(heap, pos, i, m);
+    i = m;
+  }
+}
+
+static void ts_heaps_remove(int slot)
+{
+  int i = ts_age_pos[slot];
+  if (i == TS_NONE)
+    return;
+
+  int last = ts_nused - 1;
+  if (i != last) {
+    ts_heap_swap(ts_age, ts_age_pos, i, last);
+  }
+  int k = ts_rank_pos[slot];
+  if (k != last) {
+    ts_heap_swap(ts_rank, ts_rank_pos, k, last);
+  }
+  --ts_nused;
+  ts_age_pos[slot]  = TS_NONE;
+  ts_rank_pos[slot] = TS_NONE;
+
+  if (i < ts_nused)
+    ts_heap_fix(ts_age, ts_age_pos, ts_older, i);
+  if (k < ts_nused)
+    ts_heap_fix(ts_rank, ts_rank_pos, ts_less_important, k);
+}
+
+/*
+ * Public interface
+ */
+
+/* (re)build all index structures from the current contents of Container[] */
+void TrafficStore_setup()
+{
+  memset(ts_index, 0, sizeof(ts_index));
+  ts_nfree = 0;
+  ts_nused = 0;
+  ts_count = 0;
+
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    ts_key[i]      = 0;
+    ts_free_pos[i] = TS_NONE;
+    ts_age_pos[i]  = TS_NONE;
+    ts_rank_pos[i] = TS_NONE;
+  }
+
+  /* push in reverse so that low slots are handed out first */
+  for (int i=MAX_TRACKING_OBJECTS-1; i >= 0; i--) {
+    if (Container[i].addr == 0)
+      ts_free_push(i);
+  }
+  for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
+    if (Container[i].addr != 0)
+      TrafficStore_Commit(i);
+  }
+}
+
+/* slot tracking this addr, or -1 */
+int TrafficStore_Find(uint32_t addr)
+{
+  if (addr == 0)
+    return -1;
+  return ts_index_lookup(addr);
+}
+
+/* an empty slot, or -1 if all are in use - the slot remains free until committed */
+int TrafficStore_Alloc()
+{
+  if (ts_nfree == 0)
+    return -1;
+  return ts_free[ts_nfree - 1];
+}
+
+/* the in-use slot with the oldest timestamp, or -1 */
+int TrafficStore_Oldest()
+{
+  if (ts_nused == 0)
+    return -1;
+  return ts_age[0];
+}
+
+/* the in-use slot that AddTraffic() would replace first, or -1 */
+int TrafficStore_LeastImportant()
+{
+  if (ts_nused == 0)
+    return -1;
+  return ts_rank[0];
+}
+
+/* call after a Container[] entry was written or its sort keys changed */
+void TrafficStore_Commit(int slot)
+{
+  if (slot < 0 || slot >= MAX_TRACKING_OBJECTS)
+    return;
+
+  uint32_t addr = Container[slot].addr;
+
+  if (ts_key[slot] != addr) {
+    ts_index_delete(slot);
+    if (addr != 0) {
+      int other = ts_index_lookup(addr);
+      if (other >= 0) {
+        /* same aircraft in two slots - keep the newer one */
+        ts_index_delete(other);
+        ts_heaps_remove(other);
+        Container[other].addr = 0;
+        ts_free_push(other);
+      }
+      ts_index_insert(slot, addr);
+    }
+  }
+
+  if (ts_age_pos[slot] == TS_NONE) {
+    ts_free_take(slot);
+    ts_age[ts_nused]  = slot;
+    ts_rank[ts_nused] = slot;
+    ts_age_pos[slot]  = ts_nused;
+    ts_rank_pos[slot] = ts_nused;
+    ++ts_nused;
+  }
+
+  ts_heap_fix(ts_age,  ts_age_pos,  ts_older,          ts_age_pos[slot]);
+  ts_heap_fix(ts_rank, ts_rank_pos, ts_less_important, ts_rank_pos[slot]);
+}
+
+/* drop a slot: addr is cleared, the rest of the entry is left as-is */
+void TrafficStore_Remove(int slot)
+{
+  if (slot < 0 || slot >= MAX_TRACKING_OBJECTS)
+    return;
+
+  ts_index_delete(slot);
+  ts_heaps_remove(slot);
+  Container[slot].addr = 0;
+  ts_free_push(slot);
+}
+
+int TrafficStore_Count()
+{
+  return ts_count;
+}
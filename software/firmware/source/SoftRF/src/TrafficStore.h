@@ -0,0 +1,73 @@
+/*
+ * TrafficStore.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRAFFICSTORE_H
+#define TRAFFICSTORE_H
+
+#include "system/SoC.h"
+
+/*
+ * Index structures kept alongside Container[]:
+ *   - an open-addressing (linear probing) hash of addr -> slot
+ *   - a stack of free slots
+ *   - a min-heap of used slots ordered by timestamp (oldest on top)
+ *   - a min-heap of used slots ordered by importance (least important on top)
+ *
+ * Container[] remains the storage that everything else reads.
+ * Any code that changes addr, timestamp, alarm_level, distance or
+ * adj_distance of a Container[] entry must call TrafficStore_Commit()
+ * (or TrafficStore_Remove()) for that slot afterwards.
+ */
+
+#if MAX_TRACKING_OBJECTS < 255
+typedef uint8_t  ts_slot_t;
+#else
+typedef uint16_t ts_slot_t;
+#endif
+
+/* hash table size: a power of 2, at least twice MAX_TRACKING_OBJECTS */
+#if   MAX_TRACKING_OBJECTS <= 8
+#define TRAFFIC_INDEX_SIZE    16
+#elif MAX_TRACKING_OBJECTS <= 16
+#define TRAFFIC_INDEX_SIZE    32
+#elif MAX_TRACKING_OBJECTS <= 32
+#define TRAFFIC_INDEX_SIZE    64
+#elif MAX_TRACKING_OBJECTS <= 64
+#define TRAFFIC_INDEX_SIZE    128
+#elif MAX_TRACKING_OBJECTS <= 128
+#define TRAFFIC_INDEX_SIZE    256
+#elif MAX_TRACKING_OBJECTS <= 256
+#define TRAFFIC_INDEX_SIZE    512
+#elif MAX_TRACKING_OBJECTS <= 512
+#define TRAFFIC_INDEX_SIZE    1024
+#elif MAX_TRACKING_OBJECTS <= 1024
+#define TRAFFIC_INDEX_SIZE    2048
+#else
+#error "MAX_TRACKING_OBJECTS over 1024: extend TRAFFIC_INDEX_SIZE"
+#endif
+
+void TrafficStore_setup(void);
+int  TrafficStore_Find(uint32_t addr);
+int  TrafficStore_Alloc(void);
+int  TrafficStore_Oldest(void);
+int  TrafficStore_LeastImportant(void);
+void TrafficStore_Commit(int slot);
+void TrafficStore_Remove(int slot);
+int  TrafficStore_Count(void);
+
+#endif /* TRAFFICSTORE_H */
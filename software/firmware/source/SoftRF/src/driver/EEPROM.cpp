@@ -236,6 +236,7 @@ void EEPROM_defaults()
     settings->sd_card   = SD_CARD_NONE;
     settings->logflight = FLIGHT_LOG_NONE;
     settings->rx1090    = ADSB_RX_NONE;
+    settings->gdl90_batch = false;
 
     //strncpy(settings->ssid, MY_ACCESSPOINT_SSID, sizeof(settings->ssid)-1);
     settings->ssid[0] = '\0';   // default is empty string - speeds up booting
@@ -308,6 +309,7 @@ void show_settings_serial()
     Serial.print(F(" ADS-B Receiver "));Serial.println(settings->rx1090);
     Serial.print(F(" GDL90 in "));Serial.println(settings->gdl90_in);
     Serial.print(F(" GDL90 out "));Serial.println(settings->gdl90);
+    Serial.print(F(" GDL90 batch "));Serial.println(settings->gdl90_batch);
     Serial.print(F(" DUMP1090 "));Serial.println(settings->d1090);
     Serial.print(F(" Air-Relay "));Serial.println(settings->relay);
     Serial.print(F(" Stealth "));Serial.println(settings->stealth);
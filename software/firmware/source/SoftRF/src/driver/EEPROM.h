@@ -179,7 +179,8 @@ typedef struct __attribute__((packed)) Settings {
     uint8_t  gnss_pins:2;    // external GNSS added to T-Beam  // do not move
     uint8_t  sd_card:2;
     uint8_t  logflight:2;
-    uint8_t  resvd3:2;
+    bool     gdl90_batch:1; // all messages of an export in as few writes as possible
+    uint8_t  resvd3:1;
 
     int8_t   freq_corr; /* +/-, kHz */   // do not move
     uint8_t  relay:2;
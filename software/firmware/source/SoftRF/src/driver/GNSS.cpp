@@ -33,10 +33,6 @@
 #include "Battery.h"
 #include "../protocol/data/D1090.h"
 
-#if !defined(EXCLUDE_EGM96)
-#include <egm96s.h>
-#endif /* EXCLUDE_EGM96 */
-
 //#define DO_GNSS_DEBUG
 
 #if !defined(DO_GNSS_DEBUG)
@@ -1859,40 +1855,3 @@ void PickGNSSFix()
   }    // end of while()
 
 }
-
-#if !defined(EXCLUDE_EGM96)
-/*
- *  Algorithm of EGM96 geoid offset approximation was taken from XCSoar
- */
-
-static float AsBearing(float angle)
-{
-  float retval = angle;
-
-  while (retval < 0)
-    retval += 360.0;
-
-  while (retval >= 360.0)
-    retval -= 360.0;
-
-  return retval;
-}
-
-int LookupSeparation(float lat, float lon)
-{
-  int ilat, ilon;
-
-  ilat = round((90.0 - lat) / 2.0);
-  ilon = round(AsBearing(lon) / 2.0);
-
-  int offset = ilat * 180 + ilon;
-
-  if (offset >= egm96s_dem_len)
-    return 0;
-
-  if (offset < 0)
-    return 0;
-
-  return (int) pgm_read_byte(&egm96s_dem[offset]) - 127;
-}
-#endif /* EXCLUDE_EGM96 */
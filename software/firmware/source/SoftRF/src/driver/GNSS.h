@@ -23,6 +23,8 @@
 
 #include <TinyGPS++.h>
 
+#include "../Geoid.h"
+
 typedef enum
 {
   GNSS_MODULE_NONE,
@@ -66,7 +68,6 @@ void GNSS_loop       (void);
 void GNSS_fini       (void);
 void GNSSTimeSync    (void);
 void PickGNSSFix     (void);
-int LookupSeparation (float, float);
 bool leap_seconds_valid(void);
 
 extern const gnss_chip_ops_t *gnss_chip;  // added
@@ -23,6 +23,7 @@
 #include "RF.h"
 #include "../system/Time.h"
 #include "../system/SoC.h"
+#include "../system/LinkQ.h"
 #include "EEPROM.h"
 #include "Battery.h"
 #include "../ui/Web.h"
@@ -35,6 +36,19 @@
 #include "../system/Log.h"
 #endif /* LOGGER_IS_ENABLED */
 
+#if defined(USE_RF_TASK)
+#if defined(RASPBERRY_PI)
+#include <pthread.h>
+#include <unistd.h>
+#elif defined(ESP32)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <FreeRTOS.h>
+#include <task.h>
+#endif
+#endif /* USE_RF_TASK */
+
 byte RxBuffer[MAX_PKT_SIZE] __attribute__((aligned(sizeof(uint32_t))));
 
 time_t RF_time;
@@ -50,6 +64,33 @@ uint32_t rx_packets_counter = 0;
 
 int8_t RF_last_rssi = 0;
 uint16_t RF_last_crc = 0;
+uint8_t RF_last_fixed = 0;
+time_t RF_last_time = 0;
+uint32_t RF_last_ms = 0;
+uint8_t RF_last_slot = 0;
+uint8_t RF_last_chan = 0;
+
+static rf_frame_t RxQueue[RF_RX_QUEUE_SIZE];
+static volatile uint8_t RxQueue_head = 0;   /* written by the producer only */
+static volatile uint8_t RxQueue_tail = 0;   /* written by the consumer only */
+
+uint32_t rx_queue_drops = 0;
+uint8_t  rx_queue_peak  = 0;
+uint32_t rx_fec_frames  = 0;    /* OGNTP frames recovered by RF_LDPC_Correct() */
+uint32_t rx_failed_frames = 0;  /* dropped on the CRC or the FEC */
+
+static uint32_t RxFailQueue[RF_FAIL_QUEUE_SIZE];
+static volatile uint8_t RxFailQueue_head = 0;
+static volatile uint8_t RxFailQueue_tail = 0;
+
+#if defined(USE_RF_TASK)
+static volatile bool     RF_task_active = false;
+static volatile uint32_t RF_slot_seq = 0;   /* bumped by RF_task() at each new slot */
+static volatile uint32_t RF_tx_seq   = 0;   /* slot of the frame queued by the main loop */
+static uint32_t          RF_enc_seq  = 0;   /* slot RF_Encode() last filled TxBuffer for */
+static volatile uint32_t RF_sent_seq = 0;   /* slot RF_task() last transmitted in */
+static volatile uint32_t RF_done_seq = 0;   /* of those, slot the frame went out in */
+#endif /* USE_RF_TASK */
 
 FreqPlan RF_FreqPlan;
 static bool RF_ready = false;
@@ -426,7 +467,7 @@ void RF_SetChannel(void)
   }
 }
 
-void RF_loop()
+static void RF_channel_loop()
 {
   if (!RF_ready) {
     if (RF_FreqPlan.Plan == RF_BAND_AUTO) {
@@ -452,7 +493,16 @@ void RF_loop()
     return;
   }
 
-  if (ref_time_ms == 0)   /* no GNSS time yet */
+  /* Time_loop() sets them, from the main loop when this is RF_task() */
+  time_t   our_time;
+  uint32_t ref_ms;
+
+  Time_lock();
+  our_time = OurTime;
+  ref_ms   = ref_time_ms;
+  Time_unlock();
+
+  if (ref_ms == 0)        /* no GNSS time yet */
     return;
 
   /* internal state variables to save CPU cycles */
@@ -467,25 +517,21 @@ void RF_loop()
     return;
   }
 
-  RF_time = OurTime;      // may have been updated in Time_loop since last RF_loop
+  time_t rf_time = our_time;  // may have been updated in Time_loop since last RF_loop
 
-  if (now_ms < ref_time_ms) {   /* should not happen */
-    --OurTime;
-    ref_time_ms -= 1000;
+  if (now_ms < ref_ms)    /* a fix just came in, Time_loop() has it */
     return;
-  }
-  uint32_t ms_since_pps = now_ms - ref_time_ms;
+  uint32_t ms_since_pps = now_ms - ref_ms;
   if (ms_since_pps >= 1300) {   // should not happen since Time_loop takes care of this
-    ++OurTime;
-    ref_time_ms += 1000;
+    Time_tick(now_ms);
     return;
   }
 
-  uint32_t slot_base_ms = ref_time_ms;
+  uint32_t slot_base_ms = ref_ms;
   if (ms_since_pps < 300) {  /* does not happen often, since normally RF_OK_until 300 */
     /* channel does _NOT_ change at PPS rollover in middle of slot 1 */
     /* - therefore change reference second to the previous one: */
-    --RF_time;
+    --rf_time;
     slot_base_ms -= 1000;
     ms_since_pps += 1000;
   }
@@ -502,7 +548,7 @@ void RF_loop()
     RF_current_slot = 1;
     /* channel does _NOT_ change at PPS rollover in middle of slot 1 */
     RF_OK_until = slot_base_ms + 1300;
-    if ((RF_time & 0x0F) == 0xF) {
+    if ((rf_time & 0x0F) == 0xF) {
         // some other receivers may mis-decrypt packets sent after the next PPS
         // so squeeze the transmissions into the pre-PPS half of the slot
         TxTimeMarker = slot_base_ms + 800 + SoC->random(0, 195);
@@ -515,15 +561,23 @@ void RF_loop()
   } else { /* shouldn't happen */
 
     RF_current_slot = 0;
-    RF_OK_until = ref_time_ms + 1300;
+    RF_OK_until = ref_ms + 1300;
     TxTimeMarker = RF_OK_until;  /* do not transmit for now */
     TxEndMarker  = RF_OK_until;
 
   }
 
+  RF_time = rf_time;
+
+#if defined(USE_RF_TASK)
+  /* RF_time, slot and markers before the new sequence the main loop reads first */
+  __sync_synchronize();
+  RF_slot_seq = RF_slot_seq + 1;
+#endif
+
   uint8_t OGN = (settings->rf_protocol == RF_PROTOCOL_OGNTP ? 1 : 0);
 
-  RF_current_chan = RF_FreqPlan.getChannel((time_t)RF_time, RF_current_slot, OGN);
+  RF_current_chan = RF_FreqPlan.getChannel(rf_time, RF_current_slot, OGN);
 
   if (rf_chip)
     rf_chip->channel(RF_current_chan);
@@ -532,6 +586,16 @@ void RF_loop()
 //RF_current_chan, RF_current_slot, ms_since_pps, TxTimeMarker, TxEndMarker, RF_OK_until);
 }
 
+void RF_loop()
+{
+#if defined(USE_RF_TASK)
+  if (RF_task_active)
+    return;                     /* RF_task() does it */
+#endif
+
+  RF_channel_loop();
+}
+
 size_t RF_Encode(ufo_t *fop)
 {
   size_t size = 0;
@@ -545,6 +609,17 @@ size_t RF_Encode(ufo_t *fop)
     if (settings->rf_protocol == RF_PROTOCOL_LEGACY ||
         settings->rf_protocol == RF_PROTOCOL_LATEST ||
         settings->rf_protocol == RF_PROTOCOL_OGNTP) {
+#if defined(USE_RF_TASK)
+      if (RF_task_active) {
+        /* just before TxTimeMarker, RF_task() sends it on time */
+        if (RF_Transmit_Ready()) {
+          RF_enc_seq = RF_slot_seq;
+          __sync_synchronize();   /* the sequence before its RF_time */
+          size = (*protocol_encode)((void *) &TxBuffer[0], fop);
+        }
+        return size;
+      }
+#endif /* USE_RF_TASK */
       uint32_t now_ms = millis();
       if (now_ms >= TxTimeMarker && now_ms < TxEndMarker) {
         size = (*protocol_encode)((void *) &TxBuffer[0], fop); 
@@ -561,6 +636,16 @@ size_t RF_Encode(ufo_t *fop)
 bool RF_Transmit_Ready()
 {
     if (! TxEndMarker)  return true;   // for other protocols
+#if defined(USE_RF_TASK)
+    if (RF_task_active) {   /* nothing queued for this slot yet, send time near */
+      uint32_t seq = RF_slot_seq;
+      __sync_synchronize();   /* the sequence before the markers of its slot */
+      uint32_t now_ms = millis();
+      return (RF_tx_seq != seq &&
+              (int32_t) (now_ms + RF_TX_LEAD_MS - TxTimeMarker) >= 0 &&
+              now_ms < TxEndMarker);
+    }
+#endif
     uint32_t now_ms = millis();
     return (now_ms >= TxTimeMarker && now_ms < TxEndMarker);
 }
@@ -572,6 +657,18 @@ bool RF_Transmit(size_t size, bool wait)
     if (settings->txpower == RF_TX_POWER_OFF)
       return true;
 
+#if defined(USE_RF_TASK)
+    if (RF_task_active) {
+      /* queue the frame RF_Encode() made, if it is still for this slot */
+      if (RF_enc_seq != RF_slot_seq || RF_tx_seq == RF_enc_seq)
+        return false;
+      RF_tx_size = size;
+      __sync_synchronize();     /* frame and size before the new sequence */
+      RF_tx_seq = RF_enc_seq;
+      return true;
+    }
+#endif /* USE_RF_TASK */
+
     RF_tx_size = size;
 
     /* Experimental code by Moshe Braner, specific to Legacy Protocol */
@@ -651,13 +748,173 @@ OurTime, ms, (int)gnss.time.minute(), (int)gnss.time.second(), (RF_time & 0x0F),
   return false;
 }
 
+/*
+ * Called by the radio drivers, possibly from their interrupt or RTOS
+ * callback, with a frame that passed the CRC/FEC check.
+ * When ParseData() falls behind the newest frame is dropped, and counted.
+ */
+bool RF_Queue_Put(const byte *data, size_t size, int8_t rssi, uint16_t crc,
+                  uint8_t fixed)
+{
+  uint8_t head = RxQueue_head;
+
+  if ((uint8_t) (head - RxQueue_tail) >= RF_RX_QUEUE_SIZE) {
+    rx_queue_drops++;
+    return false;
+  }
+
+  rf_frame_t *fp = &RxQueue[head & (RF_RX_QUEUE_SIZE - 1)];
+  if (size > sizeof(fp->data)) {
+    size = sizeof(fp->data);
+  }
+  memcpy(fp->data, data, size);
+  fp->size = size;
+  fp->rssi = rssi;
+  fp->crc  = crc;
+  fp->fixed = fixed;
+  fp->slot = RF_current_slot;
+  fp->chan = RF_current_chan;
+  fp->time = RF_time;
+  fp->ms   = millis();
+
+  __sync_synchronize();     /* frame contents before the new head */
+  RxQueue_head = head + 1;
+
+  return true;
+}
+
+/*
+ * Move the oldest queued frame into RxBuffer, along with its
+ * RF_last_rssi, RF_last_crc, RF_last_fixed and RF_last_time.  False if none.
+ */
+bool RF_Queue_Get(void)
+{
+  uint8_t tail  = RxQueue_tail;
+  uint8_t depth = RxQueue_head - tail;
+
+  if (depth == 0) {
+    return false;
+  }
+  if (depth > rx_queue_peak) {
+    rx_queue_peak = depth;
+  }
+
+  __sync_synchronize();     /* new head before the frame contents */
+  rf_frame_t *fp = &RxQueue[tail & (RF_RX_QUEUE_SIZE - 1)];
+  memcpy(RxBuffer, fp->data, fp->size);
+  memset(RxBuffer + fp->size, 0, sizeof(RxBuffer) - fp->size);
+  RF_last_rssi = fp->rssi;
+  RF_last_crc  = fp->crc;
+  RF_last_fixed = fp->fixed;
+  RF_last_time = fp->time;
+  RF_last_ms   = fp->ms;
+  RF_last_slot = fp->slot;
+  RF_last_chan = fp->chan;
+
+  __sync_synchronize();     /* done with the frame before it is released */
+  RxQueue_tail = tail + 1;
+
+  return true;
+}
+
+/*
+ * Called by the radio drivers, like RF_Queue_Put(), with a frame that
+ * failed the CRC/FEC check, or NULL.  Only the address of its header is
+ * kept, for the protocols that send it in the clear.
+ */
+void RF_Queue_Fail(const byte *data)
+{
+  uint8_t head = RxFailQueue_head;
+  uint32_t addr = 0;
+
+  rx_failed_frames++;
+
+  if (data != NULL &&
+      (settings->rf_protocol == RF_PROTOCOL_LEGACY ||
+       settings->rf_protocol == RF_PROTOCOL_LATEST ||
+       settings->rf_protocol == RF_PROTOCOL_OGNTP)) {
+    addr = data[0] | (data[1] << 8) | ((uint32_t) data[2] << 16);
+  }
+
+  if ((uint8_t) (head - RxFailQueue_tail) >= RF_FAIL_QUEUE_SIZE)
+    return;                     /* only counted then */
+
+  RxFailQueue[head & (RF_FAIL_QUEUE_SIZE - 1)] = addr;
+  __sync_synchronize();
+  RxFailQueue_head = head + 1;
+}
+
+/* charge the failed frames queued since to their senders */
+static void RF_Queue_Failed(void)
+{
+  uint8_t tail = RxFailQueue_tail;
+
+  while (tail != RxFailQueue_head) {
+    __sync_synchronize();
+    uint32_t addr = RxFailQueue[tail & (RF_FAIL_QUEUE_SIZE - 1)];
+    __sync_synchronize();
+    RxFailQueue_tail = ++tail;
+    LinkQ_Failed(addr);
+  }
+}
+
+/*
+ * The mean interval between the frames of a sender, 0 if unknown.  With
+ * two slots a second on more than one channel RF_Transmit() alternates
+ * between them, a frame about every half interval.
+ */
+uint16_t RF_Tx_Interval(void)
+{
+  if (ts == NULL)
+    return 0;
+  if (RF_timing == RF_TIMING_2SLOTS_PPS_SYNC && RF_FreqPlan.Channels > 1)
+    return ts->interval_mid / 2;
+  return ts->interval_mid;
+}
+
+/*
+ * The longest gap between two frames of a sender that missed none in
+ * between, 0 if unknown.  With two slots a second, from the start of one
+ * slot to the end of the next; otherwise the longest random interval.
+ */
+uint16_t RF_Tx_Gap_Max(void)
+{
+  if (ts == NULL)
+    return 0;
+  if (RF_timing == RF_TIMING_2SLOTS_PPS_SYNC && RF_FreqPlan.Channels > 1) {
+    uint16_t gap01 = ts->s1.begin + ts->s1.duration - ts->s0.begin;
+    uint16_t gap10 = ts->s0.begin + ts->s0.duration + ts->interval_mid - ts->s1.begin;
+    return (gap01 > gap10 ? gap01 : gap10) - ts->air_time;
+  }
+  return ts->interval_max;
+}
+
+/* ogntp_ldpc_correct(), with the count of recovered frames */
+int RF_LDPC_Correct(uint8_t *frame, const uint8_t *err)
+{
+  int fixed = ogntp_ldpc_correct(frame, err);
+
+  if (fixed >= 0)
+    rx_fec_frames++;
+  return fixed;
+}
+
+/* service the radio, then hand over the oldest received frame (if any) */
 bool RF_Receive(void)
 {
-  bool rval = false;
+#if defined(USE_RF_TASK)
+  if (RF_task_active) {
+    RF_Queue_Failed();
+    return RF_Queue_Get();      /* RF_task() services the radio */
+  }
+#endif
 
   if (RF_ready && rf_chip) {
-    rval = rf_chip->receive();
+    rf_chip->receive();
   }
+  RF_Queue_Failed();
+
+  bool rval = RF_Queue_Get();
 
 //if (rval)
 //Serial.printf("rx at %d s + %d ms\r\n", OurTime, millis()-ref_time_ms);
@@ -665,8 +922,172 @@ bool RF_Receive(void)
   return rval;
 }
 
+#if defined(USE_RF_TASK)
+/*
+ * One pass of the radio thread: channel and slot, the queued frame when
+ * TxTimeMarker is reached, then the receiver.  Returns how long it may
+ * sleep, at most RF_TASK_POLL_MS since the drivers are polled.
+ */
+static uint32_t RF_task_run()
+{
+  RF_channel_loop();
+
+  uint32_t wait_ms = RF_TASK_POLL_MS;
+
+  if (RF_ready && rf_chip) {
+    uint32_t seq = RF_slot_seq;
+
+    if (RF_tx_seq == seq && RF_sent_seq != seq) {
+      uint32_t now_ms = millis();
+      if ((int32_t) (now_ms - TxTimeMarker) >= 0) {
+        if (now_ms < TxEndMarker) {
+          __sync_synchronize();   /* new sequence before the frame */
+          rf_chip->transmit();
+          tx_packets_counter++;
+          RF_done_seq = seq;
+        }
+        RF_tx_size  = 0;
+        __sync_synchronize();     /* the outcome before the frame is released */
+        RF_sent_seq = seq;
+      } else if (TxTimeMarker - now_ms < wait_ms) {
+        wait_ms = TxTimeMarker - now_ms;
+      }
+    }
+
+    rf_chip->receive();
+  }
+
+  return wait_ms;
+}
+
+#if defined(RASPBERRY_PI)
+static pthread_t RF_thread;
+
+static void *RF_task(void *arg)
+{
+  (void) arg;
+
+  while (RF_task_active) {
+    usleep(RF_task_run() * 1000);
+  }
+  return NULL;
+}
+#else
+static TaskHandle_t RF_task_handle = NULL;
+
+static void RF_task(void *arg)
+{
+  (void) arg;
+
+  while (RF_task_active) {
+    vTaskDelay(pdMS_TO_TICKS(RF_task_run()) ? : 1);
+  }
+  RF_task_handle = NULL;
+  vTaskDelete(NULL);
+}
+#endif /* RASPBERRY_PI */
+
+/* normal mode, slotted protocols only, and a real radio: not a replay */
+void RF_Task_start(void)
+{
+  if (RF_task_active || rf_chip == NULL || rf_chip->type == RF_IC_NONE)
+    return;
+
+  if (settings->rf_protocol != RF_PROTOCOL_LEGACY &&
+      settings->rf_protocol != RF_PROTOCOL_LATEST &&
+      settings->rf_protocol != RF_PROTOCOL_OGNTP)
+    return;
+
+#if defined(ESP32)
+  /* an SD card on the radio's VSPI bus is driven from the main loop, unlocked */
+  if (settings->sd_card == SD_CARD_LORA)
+    return;
+#endif
+
+  RF_tx_seq = RF_slot_seq;      /* nothing queued */
+  RF_sent_seq = RF_slot_seq;
+  RF_done_seq = RF_slot_seq - 1;
+  RF_task_active = true;
+
+#if defined(RASPBERRY_PI)
+  pthread_attr_t attr;
+  struct sched_param param;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+  pthread_attr_setschedparam(&attr, &param);
+
+  if (pthread_create(&RF_thread, &attr, RF_task, NULL) != 0) {
+    /* SCHED_FIFO takes root or CAP_SYS_NICE */
+    fprintf( stderr, "RF thread is not real-time\n" );
+    if (pthread_create(&RF_thread, NULL, RF_task, NULL) != 0)
+      RF_task_active = false;
+  }
+  pthread_attr_destroy(&attr);
+#elif defined(ESP32)
+  if (xTaskCreatePinnedToCore(RF_task, "RF", RF_TASK_STACK, NULL,
+                              configMAX_PRIORITIES - 3, &RF_task_handle,
+                              0) != pdPASS)
+    RF_task_active = false;
+#else
+  if (xTaskCreate(RF_task, "RF", RF_TASK_STACK, NULL, TASK_PRIO_HIGH,
+                  &RF_task_handle) != pdPASS)
+    RF_task_active = false;
+#endif /* RASPBERRY_PI */
+}
+
+void RF_Task_stop(void)
+{
+  if (!RF_task_active)
+    return;
+
+  RF_task_active = false;
+
+#if defined(RASPBERRY_PI)
+  pthread_join(RF_thread, NULL);
+#else
+  while (RF_task_handle != NULL) {
+    delay(1);
+  }
+#endif /* RASPBERRY_PI */
+}
+
+/* the main loop only takes frames, the radio is serviced by RF_task() */
+bool RF_Task_active(void)
+{
+  return RF_task_active;
+}
+#endif /* USE_RF_TASK */
+
+/*
+ * What became of the frame RF_Transmit() last accepted: 1 sent, 0 dropped
+ * at the end of its slot, -1 still queued for RF_task().  Without the
+ * task RF_Transmit() only returns true once the frame is out.
+ */
+int RF_Transmit_Result(void)
+{
+#if defined(USE_RF_TASK)
+  if (RF_task_active) {
+    uint32_t tx = RF_tx_seq;
+    bool over = (RF_sent_seq == tx || RF_slot_seq != tx);
+
+    __sync_synchronize();       /* the outcome is set before either of these */
+    if (RF_done_seq == tx)
+      return 1;
+    return over ? 0 : -1;
+  }
+#endif /* USE_RF_TASK */
+  return 1;
+}
+
 void RF_Shutdown(void)
 {
+#if defined(USE_RF_TASK)
+  RF_Task_stop();
+#endif
+
   if (rf_chip) {
     rf_chip->shutdown();
   }
@@ -825,8 +1246,10 @@ static bool nrf905_receive()
     nrf905_receive_active = true;
   }
 
-  success = nRF905_getData(RxBuffer, LEGACY_PAYLOAD_SIZE);
+  byte frame[LEGACY_PAYLOAD_SIZE];
+  success = nRF905_getData(frame, LEGACY_PAYLOAD_SIZE);
   if (success) { // Got data
+    RF_Queue_Put(frame, LEGACY_PAYLOAD_SIZE, 0, 0, 0);
     rx_packets_counter++;
   }
 
@@ -1166,19 +1589,7 @@ static bool sx12xx_receive()
   };
 
   if (sx12xx_receive_complete == true) {
-
-    u1_t size = LMIC.dataLen - LMIC.protocol->payload_offset - LMIC.protocol->crc_size;
-
-    if (size >sizeof(RxBuffer)) {
-      size = sizeof(RxBuffer);
-    }
-
-    for (u1_t i=0; i < size; i++) {
-        RxBuffer[i] = LMIC.frame[i + LMIC.protocol->payload_offset];
-    }
-
-    RF_last_rssi = LMIC.rssi;
-    rx_packets_counter++;
+    /* sx12xx_rx_func() has queued the frame */
     success = true;
   }
 
@@ -1246,6 +1657,8 @@ static void sx12xx_rx_func (osjob_t* job) {
   u1_t crc8, pkt_crc8;
   u2_t crc16, pkt_crc16;
   u1_t i;
+  u2_t rx_crc = 0;
+  int fixed = 0;
 
   // SX1276 is in SLEEP after IRQ handler, Force it to enter RX mode
   sx12xx_receive_active = false;
@@ -1334,15 +1747,23 @@ static void sx12xx_rx_func (osjob_t* job) {
     sx12xx_receive_complete = true;
     break;
   case RF_CHECKSUM_TYPE_GALLAGER:
-    if (LDPC_Check((uint8_t  *) &LMIC.frame[0])) {
+    /* the radio decodes Manchester, no erasures to go by */
+    if (LDPC_Check((uint8_t  *) &LMIC.frame[0]) == 0) {
+      sx12xx_receive_complete = true;
+    } else if ((fixed = RF_LDPC_Correct((uint8_t *) &LMIC.frame[0], NULL)) >= 0) {
+#if DEBUG
+      Serial.printf(" %d bits corrected by FEC", fixed);
+#endif
+      sx12xx_receive_complete = true;
+    } else {
 #if DEBUG
       Serial.printf(" %02x%02x%02x%02x%02x%02x is wrong FEC",
         LMIC.frame[i], LMIC.frame[i+1], LMIC.frame[i+2],
         LMIC.frame[i+3], LMIC.frame[i+4], LMIC.frame[i+5]);
 #endif
+      fixed = 0;
       sx12xx_receive_complete = false;
-    } else {
-      sx12xx_receive_complete = true;
+      RF_Queue_Fail(&LMIC.frame[LMIC.protocol->payload_offset]);
     }
     break;
   case RF_CHECKSUM_TYPE_CRC8_107:
@@ -1355,10 +1776,11 @@ static void sx12xx_rx_func (osjob_t* job) {
     }
 #endif
     if (crc8 == pkt_crc8) {
-      RF_last_crc = crc8;
+      rx_crc = crc8;
       sx12xx_receive_complete = true;
     } else {
       sx12xx_receive_complete = false;
+      RF_Queue_Fail(&LMIC.frame[LMIC.protocol->payload_offset]);
     }
     break;
   case RF_CHECKSUM_TYPE_CCITT_FFFF:
@@ -1373,10 +1795,11 @@ static void sx12xx_rx_func (osjob_t* job) {
     }
 #endif
     if (crc16 == pkt_crc16) {
-      RF_last_crc = crc16;
+      rx_crc = crc16;
       sx12xx_receive_complete = true;
     } else {
       sx12xx_receive_complete = false;
+      RF_Queue_Fail(&LMIC.frame[LMIC.protocol->payload_offset]);
     }
     break;
   }
@@ -1385,6 +1808,12 @@ static void sx12xx_rx_func (osjob_t* job) {
   Serial.println();
 #endif
 
+  if (sx12xx_receive_complete) {
+    u1_t size = LMIC.dataLen - LMIC.protocol->payload_offset - LMIC.protocol->crc_size;
+    RF_Queue_Put(&LMIC.frame[LMIC.protocol->payload_offset], size, LMIC.rssi,
+                 rx_crc, fixed);
+    rx_packets_counter++;
+  }
 }
 
 // Transmit the given string and call the given function afterwards
@@ -1635,6 +2064,7 @@ static bool uatm_receive()
       int frame_type = correct_adsb_frame(uatradio_frame.data, &rs_errors);
 
       if (frame_type == -1) {
+        RF_Queue_Fail(NULL);
         continue;
       }
 
@@ -1651,9 +2081,7 @@ static bool uatm_receive()
       }
 
       if (size > 0) {
-        memcpy(RxBuffer, uatradio_frame.data, size);
-
-        RF_last_rssi = uatradio_frame.rssi;
+        RF_Queue_Put(uatradio_frame.data, size, uatradio_frame.rssi, 0, 0);
         rx_packets_counter++;
         success = true;
 
@@ -1706,10 +2134,15 @@ static bool cc13xx_receive_complete  = false;
 static bool cc13xx_receive_active    = false;
 static bool cc13xx_transmit_complete = false;
 
+/* the callback runs asynchronously to the main loop, which owns RxBuffer */
+static byte cc13xx_RxBuffer[MAX_PKT_SIZE] __attribute__((aligned(sizeof(uint32_t))));
+
 void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status status)
 {
   cc13xx_receive_active = false;
   bool success = false;
+  uint16_t rx_crc = 0;
+  int fixed = 0;
 
   if (status == EasyLink_Status_Success) {
 
@@ -1763,8 +2196,8 @@ void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status st
       for (i = 0; i < cc13xx_protocol->payload_size; i++)
       {
         update_crc8(&crc8, (u1_t)(rxPacket_ptr->payload[i + offset]));
-        if (i < sizeof(RxBuffer)) {
-          RxBuffer[i] = rxPacket_ptr->payload[i + offset] ^
+        if (i < sizeof(cc13xx_RxBuffer)) {
+          cc13xx_RxBuffer[i] = rxPacket_ptr->payload[i + offset] ^
                         pgm_read_byte(&whitening_pattern[i]);
         }
       }
@@ -1792,12 +2225,14 @@ void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status st
           (offset > 3 ? (rxPacket_ptr->payload[3] == cc13xx_protocol->syncword[7]) : true)) {
 
         uint8_t i, val1, val2;
+        uint8_t err[sizeof(cc13xx_RxBuffer)];  /* invalid Manchester pairs */
         for (i = 0; i < size; i++) {
           val1 = pgm_read_byte(&ManchesterDecode[rxPacket_ptr->payload[i + offset]]);
           i++;
           val2 = pgm_read_byte(&ManchesterDecode[rxPacket_ptr->payload[i + offset]]);
-          if ((i>>1) < sizeof(RxBuffer)) {
-            RxBuffer[i>>1] = ((val1 & 0x0F) << 4) | (val2 & 0x0F);
+          if ((i>>1) < sizeof(cc13xx_RxBuffer)) {
+            cc13xx_RxBuffer[i>>1] = ((val1 & 0x0F) << 4) | (val2 & 0x0F);
+            err[i>>1] = (val1 & 0xF0) | (val2 >> 4);
 
             if (i < size - (cc13xx_protocol->crc_size + cc13xx_protocol->crc_size)) {
               switch (cc13xx_protocol->crc_type)
@@ -1808,7 +2243,7 @@ void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status st
               case RF_CHECKSUM_TYPE_CCITT_FFFF:
               case RF_CHECKSUM_TYPE_CCITT_0000:
               default:
-                crc16 = update_crc_ccitt(crc16, (u1_t)(RxBuffer[i>>1]));
+                crc16 = update_crc_ccitt(crc16, (u1_t)(cc13xx_RxBuffer[i>>1]));
                 break;
               }
             }
@@ -1818,19 +2253,26 @@ void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status st
         switch (cc13xx_protocol->crc_type)
         {
         case RF_CHECKSUM_TYPE_GALLAGER:
-          if (LDPC_Check((uint8_t  *) &RxBuffer[0]) == 0) {
+          if (LDPC_Check((uint8_t  *) &cc13xx_RxBuffer[0]) == 0) {
 
             success = true;
+          } else if ((fixed = RF_LDPC_Correct(cc13xx_RxBuffer, err)) >= 0) {
+            success = true;
+          } else {
+            fixed = 0;
+            RF_Queue_Fail(cc13xx_RxBuffer);
           }
           break;
         case RF_CHECKSUM_TYPE_CCITT_FFFF:
         case RF_CHECKSUM_TYPE_CCITT_0000:
           offset = cc13xx_protocol->payload_offset + cc13xx_protocol->payload_size;
-          if (offset + 1 < sizeof(RxBuffer)) {
-            pkt_crc16 = (RxBuffer[offset] << 8 | RxBuffer[offset+1]);
+          if (offset + 1 < sizeof(cc13xx_RxBuffer)) {
+            pkt_crc16 = (cc13xx_RxBuffer[offset] << 8 | cc13xx_RxBuffer[offset+1]);
             if (crc16 == pkt_crc16) {
-              RF_last_crc = crc16;
+              rx_crc = crc16;
               success = true;
+            } else {
+              RF_Queue_Fail(cc13xx_RxBuffer);
             }
           }
           break;
@@ -1846,7 +2288,9 @@ void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status st
       int frame_type;
       frame_type = correct_adsb_frame(rxPacket_ptr->payload, &rs_errors);
 
-      if (frame_type != -1) {
+      if (frame_type == -1) {
+        RF_Queue_Fail(NULL);
+      } else {
 
         if (frame_type == 1) {
           size = SHORT_FRAME_DATA_BYTES;
@@ -1854,12 +2298,12 @@ void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status st
           size = LONG_FRAME_DATA_BYTES;
         }
 
-        if (size > sizeof(RxBuffer)) {
-          size = sizeof(RxBuffer);
+        if (size > sizeof(cc13xx_RxBuffer)) {
+          size = sizeof(cc13xx_RxBuffer);
         }
 
         if (size > 0) {
-          memcpy(RxBuffer, rxPacket_ptr->payload, size);
+          memcpy(cc13xx_RxBuffer, rxPacket_ptr->payload, size);
 
           success = true;
         }
@@ -1868,7 +2312,8 @@ void cc13xx_Receive_callback(EasyLink_RxPacket *rxPacket_ptr, EasyLink_Status st
     }
 
     if (success) {
-      RF_last_rssi = rxPacket_ptr->rssi;
+      RF_Queue_Put(cc13xx_RxBuffer, sizeof(cc13xx_RxBuffer), rxPacket_ptr->rssi,
+                   rx_crc, fixed);
       rx_packets_counter++;
 
       cc13xx_receive_complete  = true;
@@ -2334,6 +2779,8 @@ static bool ognrf_receive()
 #if !defined(WITH_SI4X32)
 
   uint8_t RxRSSI = 0;
+  int fixed = 0;
+  uint8_t RxPacket [OGNTP_PAYLOAD_SIZE + OGNTP_CRC_SIZE];
   uint8_t Err [OGNTP_PAYLOAD_SIZE + OGNTP_CRC_SIZE];
 
   // Put into receive mode
@@ -2351,14 +2798,18 @@ static bool ognrf_receive()
   if(TRX.DIO0_isOn()) {
     RxRSSI = TRX.ReadRSSI();
 
-    TRX.ReadPacket(RxBuffer, Err);
-    if (LDPC_Check((uint8_t  *) RxBuffer) == 0) {
+    TRX.ReadPacket(RxPacket, Err);
+    if (LDPC_Check((uint8_t  *) RxPacket) == 0) {
       success = true;
+    } else if ((fixed = RF_LDPC_Correct(RxPacket, Err)) >= 0) {
+      success = true;
+    } else {
+      RF_Queue_Fail(RxPacket);
     }
   }
 
   if (success) {
-    RF_last_rssi = RxRSSI;
+    RF_Queue_Put(RxPacket, OGNTP_PAYLOAD_SIZE + OGNTP_CRC_SIZE, RxRSSI, 0, fixed);
     rx_packets_counter++;
   }
 
@@ -90,6 +90,48 @@ typedef struct rfchip_ops_struct {
   void (*shutdown)();
 } rfchip_ops_t;
 
+/*
+ * Received frames wait here, queued by the radio driver callbacks,
+ * until ParseData() takes them all in one go.
+ * Single producer (the driver), single consumer (the main loop).
+ */
+#if !defined(RF_RX_QUEUE_SIZE)
+#define RF_RX_QUEUE_SIZE  8     /* a power of 2, up to 128 */
+#endif
+
+typedef struct rf_frame_struct {
+  byte      data[MAX_PKT_SIZE];
+  uint8_t   size;
+  int8_t    rssi;
+  uint16_t  crc;
+  uint8_t   fixed;              /* bits corrected by the FEC */
+  uint8_t   slot;               /* RF_current_slot at reception */
+  uint8_t   chan;               /* RF_current_chan at reception */
+  time_t    time;               /* RF_time at reception */
+  uint32_t  ms;                 /* millis() at reception */
+} rf_frame_t;
+
+/*
+ * Address in the header of the frames dropped on the CRC or the FEC, for
+ * the link quality table.  Same producer and consumer as the frames.
+ */
+#if !defined(RF_FAIL_QUEUE_SIZE)
+#define RF_FAIL_QUEUE_SIZE  8   /* a power of 2, up to 128 */
+#endif
+
+/*
+ * With USE_RF_TASK the slotted protocols get a thread of their own in
+ * normal mode.  It switches the channels, polls the receiver and sends the
+ * frame queued for the slot right at TxTimeMarker, so a slow pass of the
+ * main loop no longer costs a transmission.  The main loop only queues,
+ * with RF_Encode() and RF_Transmit(), and takes frames with RF_Receive().
+ */
+#define RF_TASK_POLL_MS   2
+#define RF_TX_LEAD_MS     20  /* the main loop encodes this long before TxTimeMarker */
+#if !defined(RF_TASK_STACK)
+#define RF_TASK_STACK     4096
+#endif
+
 typedef struct Slot_descr_struct {
   uint16_t begin;
   uint16_t duration;
@@ -117,14 +159,25 @@ size_t  RF_Encode(ufo_t *);
 bool    RF_Transmit_Ready();
 bool    RF_Transmit(size_t, bool);
 bool    RF_Receive(void);
+bool    RF_Queue_Put(const byte *, size_t, int8_t, uint16_t, uint8_t);
+bool    RF_Queue_Get(void);
+void    RF_Queue_Fail(const byte *);
+uint16_t RF_Tx_Interval(void);
+uint16_t RF_Tx_Gap_Max(void);
 void    RF_Shutdown(void);
+void    RF_Task_start(void);
+void    RF_Task_stop(void);
+bool    RF_Task_active(void);
+int     RF_Transmit_Result(void);
 uint8_t RF_Payload_Size(uint8_t);
+int     RF_LDPC_Correct(uint8_t *, const uint8_t *);
 
 extern byte TxBuffer[MAX_PKT_SIZE], RxBuffer[MAX_PKT_SIZE];
 extern uint32_t TxTimeMarker;
 extern uint32_t TxEndMarker;
 extern time_t RF_time;
 extern uint8_t RF_current_slot;
+extern uint8_t RF_current_chan;
 
 extern const rfchip_ops_t *rf_chip;
 extern bool RF_SX12XX_RST_is_connected;
@@ -134,10 +187,19 @@ extern bool (*protocol_decode)(void *, ufo_t *, ufo_t *);
 extern const char *Protocol_ID[];
 extern uint16_t RF_last_crc;
 extern int8_t RF_last_rssi;
+extern uint8_t RF_last_fixed;
+extern time_t RF_last_time;
+extern uint32_t RF_last_ms;
+extern uint8_t RF_last_slot;
+extern uint8_t RF_last_chan;
 
 extern const rf_proto_desc_t legacy_proto_desc;
 
 extern uint32_t rx_packets_counter, tx_packets_counter;
+extern uint32_t rx_queue_drops;
+extern uint32_t rx_fec_frames;
+extern uint32_t rx_failed_frames;
+extern uint8_t  rx_queue_peak;
 
 /* #define TIMETEST */
 #ifdef TIMETEST
@@ -210,11 +210,149 @@ static bool play_i2s(const char *word)
   return is_a_file;
 }
 
+// With the words in the PCM bank a phrase is only a list of pointers into it.
+// TTS() queues that for voice_task(), which renders it a block at a time into
+// the I2S DMA buffers - the main loop does not wait while it plays.
+
+#define VOICE_WORDS   6
+#define VOICE_BLOCK   256      // samples per i2s_write()
+#define VOICE_GAP     1024     // silent samples between words (128 mS)
+#define VOICE_STOP    0xFF     // phrase.n that ends voice_task()
+#define VOICE_STOP_MS 5000     // Voice_fini() wait: a full DMA queue, twice
+
+typedef struct voice_phrase_struct {
+  const uint8_t *pcm[VOICE_WORDS];
+  uint16_t       size[VOICE_WORDS];
+  uint8_t        n;
+} voice_phrase_t;
+
+static QueueHandle_t voice_queue = NULL;
+static TaskHandle_t  voice_task_handle = NULL;
+static SemaphoreHandle_t voice_done = NULL;  // given as voice_task() exits
+static volatile bool voice_stop = false;
+static bool voice_async = false;
+static uint32_t voice_block[VOICE_BLOCK];
+
+// an 8-bit sample into the MSB of both 16-bit channels
+static inline uint32_t voice_frame(uint8_t data)
+{
+  uint32_t d = data;
+  return (d << 8) | (d << 24);
+}
+
+static void voice_write(int n)
+{
+  size_t written;
+  i2s_write(i2s_num, (const char *) voice_block, n * sizeof(uint32_t), &written, portMAX_DELAY);
+}
+
+static void voice_fill(uint32_t frame, int n)
+{
+  for (int j=0; j<VOICE_BLOCK; j++)
+    voice_block[j] = frame;
+  while (n > 0) {
+    int k = (n < VOICE_BLOCK ? n : VOICE_BLOCK);
+    voice_write(k);
+    n -= k;
+  }
+}
+
+// ramp the internal DAC between 0 and its midpoint to reduce clicks
+static void voice_ramp(bool up)
+{
+  for (int i=0; i<1024; i += VOICE_BLOCK) {
+    for (int j=0; j<VOICE_BLOCK; j++)
+      voice_block[j] = voice_frame((up ? i+j : 1024-(i+j)) >> 3);
+    voice_write(VOICE_BLOCK);
+  }
+}
+
+static void voice_task(void *param)
+{
+  voice_phrase_t phrase;
+  bool internal_dac = (settings->voice == VOICE_INT);
+  // for external I2S convert from 8-bit unsigned to signed
+  uint8_t flip = (internal_dac ? 0 : 0x80);
+  uint32_t quiet = voice_frame(internal_dac ? 128 : 0);
+
+  for (;;) {
+    if (xQueueReceive(voice_queue, &phrase, portMAX_DELAY) != pdTRUE)
+      continue;
+    if (phrase.n == VOICE_STOP)
+      break;
+
+    i2s_set_dac_mode(I2S_DAC_CHANNEL_RIGHT_EN);    // enable audio output via GPIO 25 DAC
+    if (internal_dac)
+      voice_ramp(true);
+
+    for (int w=0; w < phrase.n && !voice_stop; w++) {
+      if (w > 0)
+        voice_fill(quiet, VOICE_GAP);
+      const uint8_t *p = phrase.pcm[w];
+      int left = phrase.size[w];
+      while (left > 0 && !voice_stop) {
+        int n = (left < VOICE_BLOCK ? left : VOICE_BLOCK);
+        for (int j=0; j<n; j++)
+          voice_block[j] = voice_frame(p[j] ^ flip);
+        voice_write(n);
+        p += n;
+        left -= n;
+      }
+    }
+
+    if (!voice_stop)
+      voice_fill(quiet, 6*1024);                   // silent "word", 750 mS
+    if (internal_dac)
+      voice_ramp(false);
+
+    // wait for the DMA buffers to play out
+    vTaskDelay(pdMS_TO_TICKS(dmabufcount * dmabuflen / 8));
+    i2s_set_dac_mode(I2S_DAC_CHANNEL_DISABLE);
+  }
+
+  // out of i2s_write() with the DAC off, the driver may go now
+  xSemaphoreGive(voice_done);
+  vTaskDelete(NULL);
+}
+
+static void TTS_queue(const char *msg)
+{
+    voice_phrase_t phrase;
+    phrase.n = 0;
+
+    char message[80];
+    strcpy(message, msg);
+
+    char *word = strtok (message, " ");
+
+    while (word != NULL && phrase.n < VOICE_WORDS)
+    {
+        const uint8_t *pcm;
+        int size;
+        bool is_a_file = word2pcm(word, &pcm, &size);
+        phrase.pcm[phrase.n]  = pcm;
+        phrase.size[phrase.n] = size;
+        ++phrase.n;
+        if (! is_a_file)                 // if playing default embedded WAV
+            break;
+        word = strtok (NULL, " ");
+    }
+
+    // if still busy with the previous phrase, drop this one
+    (void) xQueueSend(voice_queue, &phrase, 0);
+}
+
 static void TTS(const char *msg)
 {
     if (SOC_GPIO_PIN_VOICE == SOC_UNUSED_PIN)
       return;
 
+    if (voice_async) {
+      VoiceTimeMarker = millis();
+      TTS_queue(msg);
+      return;
+    }
+
     i2s_set_dac_mode(I2S_DAC_CHANNEL_RIGHT_EN);    // enable audio output via GPIO 25 DAC
 
     VoiceTimeMarker = millis();
@@ -353,6 +491,17 @@ void Voice_setup(void)
 
   if (num_wav_files < 17)      // have not successfully read WAV data from SPIFFS yet
     parse_wav_tar();           // then try and do that
+
+  // without enough memory for the bank the words are read from SPIFFS as they play
+  if (load_wav_bank() || num_wav_files == 0) {
+    voice_queue = xQueueCreate(2, sizeof(voice_phrase_t));
+    voice_done = xSemaphoreCreateBinary();
+    voice_stop = false;
+    if (voice_queue != NULL && voice_done != NULL
+     && xTaskCreate(voice_task, "Voice", 2048, NULL, tskIDLE_PRIORITY + 2,
+                    &voice_task_handle) == pdPASS)
+      voice_async = true;
+  }
 }
 
 bool Voice_Notify(ufo_t *fop, bool multi_alarm)
@@ -381,6 +530,29 @@ void Voice_loop(void)
 void Voice_fini(void)
 {
   VoiceTimeMarker = 0;
+  voice_async = false;
+  if (voice_task_handle != NULL) {
+      // the task may be blocked in i2s_write(): have it finish the block,
+      // ramp down and leave, rather than delete it under the driver
+      voice_phrase_t stop;
+      stop.n = VOICE_STOP;
+      voice_stop = true;
+      xQueueReset(voice_queue);
+      xQueueSend(voice_queue, &stop, 0);
+      if (xSemaphoreTake(voice_done, pdMS_TO_TICKS(VOICE_STOP_MS)) != pdTRUE) {
+          Serial.println(F("Voice task did not stop, I2S left installed"));
+          return;
+      }
+      voice_task_handle = NULL;
+  }
+  if (voice_queue != NULL) {
+      vQueueDelete(voice_queue);
+      voice_queue = NULL;
+  }
+  if (voice_done != NULL) {
+      vSemaphoreDelete(voice_done);
+      voice_done = NULL;
+  }
   if (i2s_installed) {
       // stop & destroy i2s driver
       i2s_driver_uninstall(i2s_num);
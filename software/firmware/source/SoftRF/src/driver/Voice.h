@@ -37,6 +37,8 @@ void clear_waves(void);
 int parse_wav_tar(void);
 bool word2wav(const char *word);
 int read_wav_byte(uint8_t &data);
+bool load_wav_bank(void);
+bool word2pcm(const char *word, const uint8_t **pcm, int *size);
 
 #endif /* ESP32 */
 #endif /* EXCLUDE_VOICE */
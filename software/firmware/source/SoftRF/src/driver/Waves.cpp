@@ -265,6 +265,13 @@ static const char *words[17] PROGMEM = {
 // public
 int num_wav_files = 0;
 
+// the PCM bank: the samples of all the words, read from waves.tar once
+// - the buffer is kept when the words are cleared, a phrase may still be playing
+static uint8_t *wav_bank = NULL;
+static uint32_t bank_size = 0;
+static uint32_t bankoffset[17];
+static bool bank_loaded = false;
+
 // public
 void clear_waves()
 {
@@ -273,6 +280,75 @@ void clear_waves()
        wavsize[i] = 0;
     }
     num_wav_files = 0;
+    bank_loaded = false;
+}
+
+// public: copy the samples of all the words found by parse_wav_tar() into RAM,
+//   PSRAM if there is some
+bool load_wav_bank()
+{
+    if (num_wav_files == 0)
+        return false;
+
+    uint32_t total = 0;
+    for (int i=0; i<17; i++)
+        total += wavsize[i];
+
+    if (total > bank_size) {
+        if (wav_bank != NULL)         // may be playing, cannot replace it
+            return false;
+        if (psramFound())
+            wav_bank = (uint8_t *) ps_malloc(total);
+        else if (ESP.getFreeHeap() > total + 64*1024)
+            wav_bank = (uint8_t *) malloc(total);
+        if (wav_bank == NULL) {
+            Serial.println(F("Not enough RAM for the voice bank"));
+            return false;
+        }
+        bank_size = total;
+    }
+
+    File tarfile = SPIFFS.open("/waves.tar", "r");
+    if (!tarfile) {
+        Serial.println(F("Failed to open waves.tar"));
+        return false;
+    }
+    uint32_t bankp = 0;
+    for (int i=0; i<17; i++) {
+        bankoffset[i] = bankp;
+        if (offsets[i] == 0)
+            continue;
+        if (! tarfile.seek(offsets[i], SeekSet)
+         || tarfile.read(wav_bank + bankp, wavsize[i]) != (size_t) wavsize[i]) {
+            Serial.println(F("Failed to read wav data"));
+            tarfile.close();
+            return false;
+        }
+        bankp += wavsize[i];
+    }
+    tarfile.close();
+
+    bank_loaded = true;
+    Serial.printf("Voice bank: %d bytes in %s\n", bankp, (psramFound()? "PSRAM" : "RAM"));
+    return true;
+}
+
+// public: where the samples of a word are in the bank
+//  - returns false and the default WAV if the word is not there
+bool word2pcm(const char *word, const uint8_t **pcm, int *size)
+{
+    if (bank_loaded) {
+        for (int i=0; i<17; i++) {
+            if (strcmp(word,words[i])==0 && offsets[i] > 0) {
+                *pcm = wav_bank + bankoffset[i];
+                *size = wavsize[i];
+                return true;
+            }
+        }
+    }
+    *pcm = defaultwav;
+    *size = DEFAULTSIZE;
+    return false;
 }
 
 static uint32_t wordoffset = 0;
@@ -53,6 +53,7 @@
 
 #include "../system/SoC.h"
 #include "../system/Time.h"
+#include "../system/Sched.h"
 #include "../driver/Buzzer.h"
 #include "../driver/Strobe.h"
 #include "../driver/EEPROM.h"
@@ -2826,6 +2827,7 @@ static void IRAM_ATTR ESP32_GNSS_PPS_Interrupt_handler()
   portENTER_CRITICAL_ISR(&GNSS_PPS_mutex);
   PPS_TimeMarker = millis();    /* millis() has IRAM_ATTR */
   portEXIT_CRITICAL_ISR(&GNSS_PPS_mutex);
+  Sched_event_ISR(SCHED_EV_PPS);
 }
 
 static unsigned long ESP32_get_PPS_TimeMarker()
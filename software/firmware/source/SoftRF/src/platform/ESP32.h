@@ -482,6 +482,9 @@ struct rst_info {
 #endif /* CONFIG_IDF_TARGET_ESP32S2 */
 
 #define USE_SD_CARD
+#define USE_GEOID_GRID
+#define USE_SCHED_SLEEP
+#define USE_RF_TASK
 
 #define POWER_SAVING_WIFI_TIMEOUT 600000UL /* 10 minutes */
 
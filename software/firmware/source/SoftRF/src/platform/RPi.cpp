@@ -40,6 +40,16 @@
  *
  *  pi@raspberrypi $ wget -q -O - http://localhost:8080/data/aircraft.json | nc -N localhost 30007
  *
+ *  Replay of a capture, on a virtual clock and as fast as it goes (no radio needed):
+ *
+ *  $ ./SoftRF -r capture.txt > output.txt
+ *
+ *  Each line of the capture is "<milliseconds> <record>", where the record is
+ *  an NMEA sentence from the GNSS, a "$PSRFI,<time>,<hex frame>,<rssi>" radio
+ *  frame (as output with nmea_p), or a JSON line as accepted on standard input
+ *  (SOFTRF settings, gpsd TPV, dump1090 aircraft.json).  A line without the
+ *  milliseconds keeps the time of the line before.
+ *
  */
 
 #if defined(RASPBERRY_PI)
@@ -55,6 +65,7 @@
 #include "../driver/Sound.h"
 #include "../driver/Baro.h"
 #include "../TrafficHelper.h"
+#include "../TrafficStore.h"
 #include "../protocol/data/NMEA.h"
 #include "../protocol/data/GDL90.h"
 #include "../protocol/data/D1090.h"
@@ -64,10 +75,13 @@
 #include "../driver/Battery.h"
 #include "../driver/Bluetooth.h"
 #include "../system/Time.h"
-
-#include "TCPServer.h"
+#include "../system/Perf.h"
+#include "../system/LinkQ.h"
+#include "../system/NetIO.h"
+#include "../system/SDR.h"
 
 #include <stdio.h>
+#include <unistd.h>
 #include <sys/select.h>
 
 #include <iostream>
@@ -146,7 +160,10 @@ unsigned long ExportTimeMarker = 0;
 
 std::string input_line;
 
-TCPServer Traffic_TCP_Server;
+/* messages from NetIO, a few per pass of the loop */
+#define NETIO_READ_MAX  8
+
+static char netio_msg[NETIO_MSG_MAX + 1];
 
 #if defined(USE_EPAPER)
 GxEPD2_BW<GxEPD2_270, GxEPD2_270::HEIGHT> __attribute__ ((common)) epd_waveshare(GxEPD2_270(/*CS=5*/ 8,
@@ -359,7 +376,7 @@ static long RPi_random(long howsmall, long howBig)
 
 static void RPi_WiFi_transmit_UDP(int port, byte *buf, size_t size)
 {
-  /* TBD */
+  NetIO_sendto(port, buf, size);
 }
 
 static void RPi_SPI_begin()
@@ -617,129 +634,313 @@ static void parseNMEA(const char *str, int len)
   }
 }
 
+/* JSON line from standard input (or a replay) */
+static void parseJSON(const char *str)
+{
+  /* 'aircraft.json' output from 'dump1090' application, without a document */
+  if (parseD1090_stream(str))
+    return;
+
+  deserializeJson(jsonDoc, str);
+  JsonObject root = jsonDoc.as<JsonObject>();
+
+  JsonVariant msg_class = root["class"];
+
+  if (msg_class.success()) {
+    const char *msg_class_s = msg_class.as<char*>();
+
+    if (!strcmp(msg_class_s,"TPV")) { // "TPV"
+      parseTPV(root);
+    } else if (!strcmp(msg_class_s,"SOFTRF")) {
+      parseSettings(root);
+
+      RF_Task_stop();
+      RF_setup();
+      Traffic_setup();
+      if (settings->mode == SOFTRF_MODE_NORMAL)
+        RF_Task_start();
+    }
+  }
+
+  if (root.containsKey("now") &&
+      root.containsKey("messages") &&
+      root.containsKey("aircraft")) {
+    /* 'aircraft.json' output from 'dump1090' application */
+    parseD1090(root);
+  } else if (root.containsKey("aircraft")) {
+    /* uAvionix PingStation */
+    parsePING(root);
+  }
+
+  jsonDoc.clear();
+}
+
+/* a line from standard input or gpsd */
+static void RPi_GNSSInput(const char *str, int len)
+{
+  if (str[0] == '$' && str[1] == 'G') {
+    // NMEA input
+    parseNMEA(str, len);
+
+  } else if (str[0] == '{') {
+    // JSON input
+    parseJSON(str);
+
+    if ((time(NULL) - now()) > 3) {
+      hasValidGPSDFix = false;
+    }
+  }
+}
+
 static void RPi_PickGNSSFix()
 {
   if (inputAvailable()) {
     std::getline(std::cin, input_line);
-    const char *str = input_line.c_str();
-    int len = input_line.length();
+    RPi_GNSSInput(input_line.c_str(), input_line.length());
+  }
+}
 
-    if (str[0] == '$' && str[1] == 'G') {
-      // NMEA input
-      parseNMEA(str, len);
+/* a message from a traffic source: dump1090, PingStation, settings */
+static void RPi_TrafficInput(const char *str, int len)
+{
+  if (str[0] == '{') {
+    // JSON input
 
-    } else if (str[0] == '{') {
-      // JSON input
+//    cout << "Traffic message:" << str << endl;
 
-      deserializeJson(jsonDoc, str);
-      JsonObject root = jsonDoc.as<JsonObject>();
+    /* 'aircraft.json' output from 'dump1090' application, without a document */
+    if (isValidFix() && parseD1090_stream(str))
+      return;
 
-      JsonVariant msg_class = root["class"];
+    deserializeJson(jsonDoc, str);
+    JsonObject root = jsonDoc.as<JsonObject>();
 
-      if (msg_class.success()) {
-        const char *msg_class_s = msg_class.as<char*>();
+    JsonVariant msg_class = root["class"];
 
-        if (!strcmp(msg_class_s,"TPV")) { // "TPV"
-          parseTPV(root);
-        } else if (!strcmp(msg_class_s,"SOFTRF")) {
-          parseSettings(root);
+    if (msg_class.success()) {
+      const char *msg_class_s = msg_class.as<char*>();
 
-          RF_setup();
-          Traffic_setup();
-        }
+      if (!strcmp(msg_class_s,"SOFTRF")) {
+        parseSettings(root);
+
+        RF_Task_stop();
+        RF_setup();
+        Traffic_setup();
+        if (settings->mode == SOFTRF_MODE_NORMAL)
+          RF_Task_start();
       }
+    }
 
-      if (root.containsKey("now") &&
-          root.containsKey("messages") &&
-          root.containsKey("aircraft")) {
-        /* 'aircraft.json' output from 'dump1090' application */
+    if (root.containsKey("now") &&
+        root.containsKey("messages") &&
+        root.containsKey("aircraft")) {
+      /* 'aircraft.json' output from 'dump1090' application */
+      if (isValidFix()) {
         parseD1090(root);
-      } else if (root.containsKey("aircraft")) {
-        /* uAvionix PingStation */
+      }
+    } else if (root.containsKey("aircraft")) {
+      /* uAvionix PingStation */
+      if (isValidFix()) {
         parsePING(root);
       }
+    }
 
-      jsonDoc.clear();
+    JsonVariant rawdata = root["rawdata"];
+    if (rawdata.success()) {
+      parseRAW(root);
+    }
 
-      if ((time(NULL) - now()) > 3) {
-        hasValidGPSDFix = false;
-      }
+    jsonDoc.clear();
+
+  } else if (str[0] == 'q') {
+    if (len >= 4 && str[1] == 'u' && str[2] == 'i' && str[3] == 't') {
+      SDR_fini();
+      NetIO_fini();
+      fprintf( stderr, "Program termination.\n" );
+      exit(EXIT_SUCCESS);
     }
   }
 }
 
 static void RPi_ReadTraffic()
 {
-  string traffic_input = Traffic_TCP_Server.getMessage();
-  if (traffic_input != "") {
-    const char *str = traffic_input.c_str();
-    int len = traffic_input.length();
+  uint8_t role;
+  size_t len;
+
+  for (int i = 0; i < NETIO_READ_MAX &&
+       (len = NetIO_read(netio_msg, sizeof(netio_msg), &role)) > 0; i++) {
+    if (role == NETIO_ROLE_GNSS)
+      RPi_GNSSInput(netio_msg, len);
+    else
+      RPi_TrafficInput(netio_msg, len);
+  }
+}
 
-    if (str[0] == '{') {
-      // JSON input
+/*
+ * Replay of a capture file on a virtual clock.
+ * The radio is a stand-in that only picks the protocol's encode/decode,
+ * frames from the capture are queued as if it had received them.
+ */
 
-//    cout << "Traffic message:" << traffic_input << endl;
+#define REPLAY_TICK_MS  20      /* normal_loop() period on the virtual clock */
 
-      deserializeJson(jsonDoc, str);
-      JsonObject root = jsonDoc.as<JsonObject>();
+void normal_loop(void);
 
-      JsonVariant msg_class = root["class"];
+static FILE    *replay_file   = NULL;
+static uint32_t replay_ms     = 1;
+static uint32_t replay_lines  = 0;
+static uint32_t replay_frames = 0;
 
-      if (msg_class.success()) {
-        const char *msg_class_s = msg_class.as<char*>();
+static bool replay_probe()              { return true; }
+static void replay_channel(uint8_t ch)  { }
+static bool replay_receive()            { return false; }
+static void replay_transmit()           { }
+static void replay_shutdown()           { }
 
-        if (!strcmp(msg_class_s,"SOFTRF")) {
-          parseSettings(root);
+static void replay_setup()
+{
+  switch (settings->rf_protocol)
+  {
+  case RF_PROTOCOL_OGNTP:
+    protocol_encode = &ogntp_encode;
+    protocol_decode = &ogntp_decode;
+    break;
+  case RF_PROTOCOL_P3I:
+    protocol_encode = &p3i_encode;
+    protocol_decode = &p3i_decode;
+    break;
+  case RF_PROTOCOL_FANET:
+    protocol_encode = &fanet_encode;
+    protocol_decode = &fanet_decode;
+    break;
+  case RF_PROTOCOL_LEGACY:
+  case RF_PROTOCOL_LATEST:
+  default:
+    protocol_encode = &legacy_encode;
+    protocol_decode = &legacy_decode;     // decodes both LEGACY and LATEST
+    break;
+  }
+}
 
-          RF_setup();
-          Traffic_setup();
-        }
-      }
+static const rfchip_ops_t replay_ops = {
+  RF_IC_NONE,
+  "Replay",
+  replay_probe,
+  replay_setup,
+  replay_channel,
+  replay_receive,
+  replay_transmit,
+  replay_shutdown
+};
 
-      if (root.containsKey("now") &&
-          root.containsKey("messages") &&
-          root.containsKey("aircraft")) {
-        /* 'aircraft.json' output from 'dump1090' application */
-        if (isValidFix()) {
-          parseD1090(root);
-        }
-      } else if (root.containsKey("aircraft")) {
-        /* uAvionix PingStation */
-        if (isValidFix()) {
-          parsePING(root);
-        }
-      }
+static int hexval(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
 
-      JsonVariant rawdata = root["rawdata"];
-      if (rawdata.success()) {
-        parseRAW(root);
-      }
+/* $PSRFI,<time>,<hex>,<rssi> */
+static void replay_frame(const char *str)
+{
+  byte frame[MAX_PKT_SIZE];
+  size_t size = 0;
+
+  const char *hex = strchr(str + 7, ',');
+  if (hex == NULL)
+    return;
+  for (++hex; size < sizeof(frame); hex += 2) {
+    int hi = hexval(hex[0]);
+    int lo = (hi < 0 ? -1 : hexval(hex[1]));
+    if (lo < 0)
+      break;
+    frame[size++] = (hi << 4) | lo;
+  }
+  const char *rssi = strchr(hex, ',');
 
-      jsonDoc.clear();
+  if (size > 0) {
+    RF_Queue_Put(frame, size, (rssi ? atoi(rssi + 1) : 0), 0, 0);
+    rx_packets_counter++;
+    replay_frames++;
+  }
+}
 
-    } else if (str[0] == 'q') {
-      if (len >= 4 && str[1] == 'u' && str[2] == 'i' && str[3] == 't') {
-        Traffic_TCP_Server.detach();
-        fprintf( stderr, "Program termination.\n" );
-        exit(EXIT_SUCCESS);
+static void replay_record(char *str)
+{
+  size_t len = strlen(str);
+  while (len > 0 && (str[len-1] == '\n' || str[len-1] == '\r'))
+    str[--len] = '\0';
+
+  if (str[0] == '$' && str[1] == 'G') {
+    parseNMEA(str, len);
+  } else if (strncmp(str, "$PSRFI,", 7) == 0) {
+    replay_frame(str);
+  } else if (str[0] == '{') {
+    parseJSON(str);
+  }
+}
+
+/* run the capture through the normal loop, returns at its end */
+static void replay_loop()
+{
+  static char line[4096];
+  struct timespec t0, t1;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  setVirtualMillis(replay_ms);
+
+  while (fgets(line, sizeof(line), replay_file) != NULL) {
+    char *rec = line;
+    if (line[0] >= '0' && line[0] <= '9') {
+      uint32_t ms = strtoul(line, &rec, 10);
+      while (*rec == ' ' || *rec == '\t')
+        rec++;
+      /* keep the loop going at its usual pace up to this record */
+      while ((int32_t) (ms - replay_ms) > 0) {
+        replay_ms = ((int32_t) (ms - replay_ms) > REPLAY_TICK_MS ?
+                       replay_ms + REPLAY_TICK_MS : ms);
+        setVirtualMillis(replay_ms);
+        normal_loop();
       }
     }
-
-    Traffic_TCP_Server.clean();
+    replay_lines++;
+    replay_record(rec);
   }
+  normal_loop();
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  fprintf(stderr, "Replay: %u lines, %u frames, %.1f s of capture in %.3f s"
+                  " (%.0f frames/s)\n", replay_lines, replay_frames,
+                  replay_ms / 1000.0, secs, (secs > 0 ? replay_frames / secs : 0));
 }
 
 void normal_loop()
 {
-    /* Read GNSS data from standard input */
-    RPi_PickGNSSFix();
+    PERF_SCOPE(PERF_LOOP);
 
-    /* Read NMEA data from GNSS module on GPIO pins */
-//    PickGNSSFix();
+    if (!replay_file) {
+      PERF_SCOPE(PERF_GNSS);
 
-    RPi_ReadTraffic();
+      /* Read GNSS data from standard input */
+      RPi_PickGNSSFix();
 
-    RF_loop();
+      /* Read NMEA data from GNSS module on GPIO pins */
+//      PickGNSSFix();
+
+      RPi_ReadTraffic();
+
+      /* 1090ES and UAT demodulated from SDR I/Q */
+      SDR_loop();
+    }
+
+    Time_loop();   /* GNSS time for the Legacy protocol time slots */
+
+    {
+      PERF_SCOPE(PERF_RF);
+      RF_loop();
+    }
 
     ThisAircraft.timestamp = now();
 
@@ -749,13 +950,18 @@ void normal_loop()
 
     bool success = RF_Receive();
 
-    if (success && isValidFix()) ParseData();
+    if (success && isValidFix()) {
+      PERF_SCOPE(PERF_PARSE);
+      ParseData();
+    }
 
     if (isValidFix()) {
+      PERF_SCOPE(PERF_TRAFFIC);
       Traffic_loop();
     }
 
     if (isTimeToExport()) {
+      PERF_SCOPE(PERF_EXPORT);
       NMEA_Export();
 
       if (isValidFix()) {
@@ -769,7 +975,10 @@ void normal_loop()
     // Handle Air Connect
     NMEA_loop();
 
-    SoC->Display_loop();
+    {
+      PERF_SCOPE(PERF_DISPLAY);
+      SoC->Display_loop();
+    }
 
     ClearExpired();
 }
@@ -803,6 +1012,7 @@ void relay_loop()
             printf("%s\n", str.c_str());
 #endif
             Container[i] = EmptyFO;
+            TrafficStore_Remove(i);
           }
         }
       } else if (isValidFix() &&
@@ -828,6 +1038,7 @@ void relay_loop()
               fo.aircraft_type);
 #endif
           Container[i] = EmptyFO;
+          TrafficStore_Remove(i);
         }
       }
     }
@@ -941,16 +1152,51 @@ void txrx_test_loop()
 }
 
 
-void * traffic_tcpserv_loop(void * m)
+int main(int argc, char *argv[])
 {
-  pthread_detach(pthread_self());
-  Traffic_TCP_Server.receive();
-}
+  int opt;
+  const char *geoid_file = NULL;
+  char *gpsd_host = NULL;
+  uint16_t gpsd_port = GPSD_TCP_PORT;
+  const char *sdr_path[SDR_BAND_COUNT] = { NULL };
+
+  while ((opt = getopt(argc, argv, "r:g:d:m:u:")) != -1) {
+    switch (opt)
+    {
+    case 'r':
+      replay_file = fopen(optarg, "r");
+      if (replay_file == NULL) {
+        perror(optarg);
+        exit(EXIT_FAILURE);
+      }
+      rf_chip = &replay_ops;
+      break;
+    case 'g':
+      geoid_file = optarg;
+      break;
+    case 'd':
+      gpsd_host = optarg;
+      if (strchr(gpsd_host, ':') != NULL) {
+        gpsd_port = atoi(strchr(gpsd_host, ':') + 1);
+        *strchr(gpsd_host, ':') = '\0';
+      }
+      break;
+    case 'm':
+      sdr_path[SDR_BAND_1090] = optarg;
+      break;
+    case 'u':
+      sdr_path[SDR_BAND_978] = optarg;
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-r capture] [-g geoid_grid]"
+                      " [-d gpsd_host[:port]] [-m iq_1090] [-u iq_978]\n",
+                      argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
 
-int main()
-{
   // Init GPIO bcm
-  if (!bcm2835_init()) {
+  if (!replay_file && !bcm2835_init()) {
       fprintf( stderr, "bcm2835_init() Failed\n\n" );
       exit(EXIT_FAILURE);
   }
@@ -959,6 +1205,9 @@ int main()
 
   hw_info.soc = SoC_setup(); // Has to be very first procedure in the execution order
 
+  Perf_setup();
+  LinkQ_setup();
+
   Serial.println();
   Serial.print(F(SOFTRF_IDENT));
   Serial.print(SoC->name);
@@ -967,9 +1216,14 @@ int main()
   Serial.println(F("Copyright (C) 2015-2021 Linar Yusupov. All rights reserved."));
   Serial.flush();
 
+  if (geoid_file != NULL && !Geoid_load(geoid_file)) {
+    fprintf(stderr, "%s: not a usable geoid grid\n", geoid_file);
+    exit(EXIT_FAILURE);
+  }
+
   hw_info.rf = RF_setup();
 
-  if (hw_info.rf == RF_IC_NONE) {
+  if (hw_info.rf == RF_IC_NONE && !replay_file) {
       exit(EXIT_FAILURE);
   }
 
@@ -995,11 +1249,39 @@ int main()
   Traffic_setup();
   NMEA_setup();
 
-  Traffic_TCP_Server.setup(JSON_SRV_TCP_PORT);
+  if (replay_file) {
+    replay_loop();
+    fclose(replay_file);
+    return 0;
+  }
 
-  pthread_t traffic_tcpserv_thread;
-  if ( pthread_create(&traffic_tcpserv_thread, NULL, traffic_tcpserv_loop, (void *)0) != 0) {
-    fprintf( stderr, "pthread_create(traffic_tcpserv_thread) Failed\n\n" );
+  /* traffic in over TCP and UDP, NMEA and GDL90 out to TCP clients */
+  if (!NetIO_setup() ||
+      !NetIO_listen(JSON_SRV_TCP_PORT, NETIO_ROLE_TRAFFIC) ||
+      !NetIO_bind_udp(JSON_SRV_TCP_PORT, NETIO_ROLE_TRAFFIC) ||
+      !NetIO_listen(NMEA_SRV_TCP_PORT, NETIO_ROLE_OUTPUT)) {
+    fprintf( stderr, "NetIO_setup() Failed\n\n" );
+    exit(EXIT_FAILURE);
+  }
+  if (gpsd_host != NULL &&
+      !NetIO_connect(gpsd_host, gpsd_port, NETIO_ROLE_GNSS,
+                     "?WATCH={\"enable\":true,\"json\":true};\n")) {
+    exit(EXIT_FAILURE);
+  }
+  if (!NetIO_start()) {
+    fprintf( stderr, "NetIO_start() Failed\n\n" );
+    exit(EXIT_FAILURE);
+  }
+
+  /* rtl_sdr I/Q, from a file or a FIFO, for each band asked for */
+  for (int b = 0; b < SDR_BAND_COUNT; b++) {
+    if (sdr_path[b] != NULL && !SDR_setup(b, sdr_path[b])) {
+      fprintf( stderr, "SDR_setup() Failed\n\n" );
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (!SDR_start()) {
+    fprintf( stderr, "SDR_start() Failed\n\n" );
     exit(EXIT_FAILURE);
   }
 
@@ -1007,6 +1289,10 @@ int main()
 
   SoC->WDT_setup();
 
+  /* channels, reception and the timed transmissions, in their own thread */
+  if (settings->mode == SOFTRF_MODE_NORMAL)
+    RF_Task_start();
+
   while (true) {
     switch (settings->mode)
     {
@@ -1030,14 +1316,16 @@ int main()
 
       if (current_time == ((time_t)-1) ||
           localtime_r(&current_time, &timebuf) == NULL) {
-        Traffic_TCP_Server.detach();
+        SDR_fini();
+        NetIO_fini();
         fprintf(stderr, "Failure to obtain the current time.\n");
         exit(EXIT_FAILURE);
       }
 
       /* shut SoftRF down at night time only */
       if (timebuf.tm_hour >= 2 && timebuf.tm_hour <= 5) {
-        Traffic_TCP_Server.detach();
+        SDR_fini();
+        NetIO_fini();
         fprintf( stderr, "Program termination: millis() rollover prevention.\n" );
         exit(EXIT_SUCCESS);
       }
@@ -1045,7 +1333,8 @@ int main()
 #endif /* TAKE_CARE_OF_MILLIS_ROLLOVER */
   }
 
-  Traffic_TCP_Server.detach();
+  SDR_fini();
+  NetIO_fini();
   return 0;
 }
 
@@ -1057,7 +1346,8 @@ void shutdown(int reason)
     SoC->Display_fini(reason);
   }
 
-  Traffic_TCP_Server.detach();
+  SDR_fini();
+  NetIO_fini();
   fprintf( stderr, "Program termination. Reason code: %d.\n", reason );
   exit(EXIT_SUCCESS);
 }
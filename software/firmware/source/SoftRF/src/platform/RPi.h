@@ -22,7 +22,9 @@
 #define PLATFORM_RPI_H
 
 /* Maximum of tracked flying objects is now SoC-specific constant */
+#if !defined(MAX_TRACKING_OBJECTS)
 #define MAX_TRACKING_OBJECTS  8
+#endif
 
 #define DEFAULT_SOFTRF_MODEL    SOFTRF_MODEL_RASPBERRY
 
@@ -92,9 +94,12 @@ struct rst_info {
 
 #if defined(USE_SPI1)
 #define JSON_SRV_TCP_PORT     30008
+#define NMEA_SRV_TCP_PORT     (NMEA_TCP_PORT + 1)
 #else
 #define JSON_SRV_TCP_PORT     30007
+#define NMEA_SRV_TCP_PORT     NMEA_TCP_PORT
 #endif
+#define GPSD_TCP_PORT         2947
 
 extern TTYSerial Serial1;
 extern TTYSerial Serial2;
@@ -109,6 +114,8 @@ extern const char *Hardware_Rev[];
 #define EXCLUDE_LK8EX1
 
 #define USE_NMEALIB
+#define USE_GEOID_GRID
+#define USE_RF_TASK
 //#define USE_EPAPER
 
 #define TAKE_CARE_OF_MILLIS_ROLLOVER
@@ -46,6 +46,7 @@
 #include "../protocol/data/D1090.h"
 #include "../protocol/data/JSON.h"
 #include "../system/Time.h"
+#include "../system/Sched.h"
 
 #include "uCDB.hpp"
 
@@ -1565,6 +1566,7 @@ static float nRF52_Battery_param(uint8_t param)
 
 void nRF52_GNSS_PPS_Interrupt_handler() {
   PPS_TimeMarker = millis();
+  Sched_event_ISR(SCHED_EV_PPS);
 }
 
 static unsigned long nRF52_get_PPS_TimeMarker() {
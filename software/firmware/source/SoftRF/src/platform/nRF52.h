@@ -253,6 +253,9 @@ struct rst_info {
 #define EXCLUDE_WIFI
 #define EXCLUDE_CC13XX
 //#define EXCLUDE_TEST_MODE
+#define USE_SCHED_SLEEP
+#define USE_RF_TASK
+#define RF_TASK_STACK     (256*4)   /* words */
 #define EXCLUDE_SOFTRF_HEARTBEAT
 //#define EXCLUDE_LK8EX1
 
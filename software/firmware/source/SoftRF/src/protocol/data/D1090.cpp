@@ -22,6 +22,7 @@
 #include <TimeLib.h>
 
 #include "../../system/SoC.h"
+#include "../../system/NetIO.h"
 #include "NMEA.h"
 #include "D1090.h"
 #include "../../driver/GNSS.h"
@@ -76,6 +77,8 @@ static void D1090_Out(byte *buf, size_t size)
   case DEST_TCP:
 #if defined(NMEA_TCP_SERVICE)
       WiFi_transmit_TCP((char*)buf, size);
+#elif defined(RASPBERRY_PI)
+      NetIO_send(buf, size);
 #endif
     break;
   case DEST_NONE:
@@ -0,0 +1,266 @@
+/*
+ * D1090Stream.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(RASPBERRY_PI)
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <TimeLib.h>
+#include <TinyGPS++.h>
+
+#include "../../system/SoC.h"
+#include "../../TrafficHelper.h"
+#include "../radio/Legacy.h"
+#include "../../ApproxMath.h"
+#include "JSON.h"
+
+/*
+ * A pull parser for the aircraft.json of dump1090, as an alternative to
+ * deserializeJson() and parseD1090().  It walks the text once, keeps the
+ * few fields it needs of each aircraft in locals, drops those out of
+ * range, and hands the rest to AddTraffic() - without a document, malloc
+ * or an intermediate array.  Strings are not unescaped, none of the
+ * fields used has escapes.
+ */
+
+#define JS_KEY(k)   (klen == sizeof(k) - 1 && memcmp(key, k, klen) == 0)
+
+static const char *js_ws(const char *p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    p++;
+  return p;
+}
+
+/* p at the opening quote; returns past the closing one, NULL if none */
+static const char *js_string(const char *p, const char **s, size_t *len)
+{
+  const char *start = ++p;
+
+  while (*p != '"') {
+    if (*p == '\0')
+      return NULL;
+    if (*p == '\\' && p[1] != '\0')
+      p++;
+    p++;
+  }
+  *s   = start;
+  *len = p - start;
+
+  return p + 1;
+}
+
+/* p at a value; returns at the ',', '}' or ']' after it, NULL if none */
+static const char *js_skip(const char *p)
+{
+  int depth = 0;
+  const char *s;
+  size_t len;
+
+  for (;;) {
+    switch (*p)
+    {
+    case '\0':
+      return NULL;
+    case '"':
+      p = js_string(p, &s, &len);
+      if (p == NULL)
+        return NULL;
+      continue;
+    case '{':
+    case '[':
+      depth++;
+      break;
+    case '}':
+    case ']':
+      if (depth == 0)
+        return p;
+      depth--;
+      break;
+    case ',':
+      if (depth == 0)
+        return p;
+      break;
+    default:
+      break;
+    }
+    p++;
+  }
+}
+
+/* a number, or 0 for anything else ("ground", null, ...) as ArduinoJson */
+static const char *js_number(const char *p, double *v)
+{
+  if (*p == '-' || (*p >= '0' && *p <= '9')) {
+    char *end;
+    *v = strtod(p, &end);
+    return end;
+  }
+  *v = 0;
+  return js_skip(p);
+}
+
+static void D1090_stream_aircraft(const char *p)
+{
+  time_t timestamp = now();
+  float lat0 = ThisAircraft.latitude;
+  float lon0 = ThisAircraft.longitude;
+  bool  own_fix = (lat0 != 0.0 || lon0 != 0.0);
+  float m_per_deg_lon = 111300.0 * CosLat(lat0);
+
+  for (;;) {
+    p = js_ws(p);
+    if (*p != '{')
+      return;                   /* ']', or not what dump1090 writes */
+    p++;
+
+    const char *hex = NULL;
+    size_t hexlen = 0;
+    double lat = 0, lon = 0, altitude = 0, vert_rate = 0;
+    double track = 0, speed = 0, rssi = 0;
+
+    for (;;) {
+      const char *key;
+      size_t klen;
+
+      p = js_ws(p);
+      if (*p == '}') {
+        p++;
+        break;
+      }
+      if (*p != '"' || (p = js_string(p, &key, &klen)) == NULL)
+        return;
+      p = js_ws(p);
+      if (*p++ != ':')
+        return;
+      p = js_ws(p);
+
+      if (JS_KEY("hex") && *p == '"') p = js_string(p, &hex, &hexlen);
+      else if (JS_KEY("lat"))         p = js_number(p, &lat);
+      else if (JS_KEY("lon"))         p = js_number(p, &lon);
+      else if (JS_KEY("altitude"))    p = js_number(p, &altitude);
+      else if (JS_KEY("vert_rate"))   p = js_number(p, &vert_rate);
+      else if (JS_KEY("track"))       p = js_number(p, &track);
+      else if (JS_KEY("speed"))       p = js_number(p, &speed);
+      else if (JS_KEY("rssi"))        p = js_number(p, &rssi);
+      else                            p = js_skip(p);
+      if (p == NULL)
+        return;
+
+      p = js_ws(p);
+      if (*p == ',')
+        p++;
+    }
+
+    p = js_ws(p);
+    if (*p == ',')
+      p++;
+
+    if (hex == NULL || hexlen == 0 || lat == 0.0 || lon == 0.0 ||
+        (int) altitude == 0)
+      continue;
+
+    float pressure_altitude = (int) altitude / _GPS_FEET_PER_METER;
+
+    if (own_fix) {
+      float dy = (lat - lat0) * 111300.0;
+      float dx = (lon - lon0) * m_per_deg_lon;
+      if (fabs(dy) > D1090_MAX_RANGE || fabs(dx) > D1090_MAX_RANGE ||
+          dx * dx + dy * dy > (float) D1090_MAX_RANGE * D1090_MAX_RANGE ||
+          fabs(pressure_altitude - ThisAircraft.altitude) > D1090_MAX_ALT_DIFF)
+        continue;
+    }
+
+    fo = EmptyFO;
+    fo.timestamp = timestamp;
+    fo.gnsstime_ms = millis();
+    fo.protocol = RF_PROTOCOL_ADSB_1090;
+
+    /* strtoul() stops at the closing quote */
+    if (hex[0] == '~') {
+      fo.addr = strtoul(&hex[1], NULL, 16);
+      fo.addr_type = ADDR_TYPE_ANONYMOUS;
+    } else {
+      fo.addr = strtoul(&hex[0], NULL, 16);
+      fo.addr_type = ADDR_TYPE_ICAO;
+    }
+
+    fo.latitude = lat;
+    fo.longitude = lon;
+    fo.pressure_altitude = pressure_altitude;
+
+    /* TBD */
+    fo.altitude = fo.pressure_altitude;
+
+    fo.course = (int) track;
+    fo.speed = (int) speed;
+    fo.aircraft_type = AIRCRAFT_TYPE_JET;
+    fo.vs = (int) vert_rate;
+    fo.stealth = false;
+    fo.no_track = false;
+    fo.rssi = rssi;
+
+    AddTraffic(&fo);
+  }
+}
+
+/*
+ * True if str is the aircraft.json of dump1090, with "now" and "messages"
+ * ahead of "aircraft" as it writes them, and has been taken in.
+ * False, with nothing done, for anything else.
+ */
+bool parseD1090_stream(const char *str)
+{
+  bool has_now = false;
+  bool has_messages = false;
+  const char *p = js_ws(str);
+
+  if (*p++ != '{')
+    return false;
+
+  for (;;) {
+    const char *key;
+    size_t klen;
+
+    p = js_ws(p);
+    if (*p != '"' || (p = js_string(p, &key, &klen)) == NULL)
+      return false;
+    p = js_ws(p);
+    if (*p++ != ':')
+      return false;
+    p = js_ws(p);
+
+    if (JS_KEY("aircraft") && has_now && has_messages && *p == '[') {
+      D1090_stream_aircraft(p + 1);
+      return true;
+    }
+    if (JS_KEY("now"))
+      has_now = true;
+    else if (JS_KEY("messages"))
+      has_messages = true;
+
+    p = js_skip(p);
+    if (p == NULL || *p != ',')
+      return false;
+    p++;
+  }
+}
+
+#endif /* RASPBERRY_PI */
@@ -24,6 +24,7 @@
 #include <protocol.h>
 
 #include "../../system/SoC.h"
+#include "../../system/NetIO.h"
 #include "GDL90.h"
 #include "GNS5892.h"
 #include "../../driver/Baro.h"
@@ -436,6 +437,17 @@ static size_t makeFFid(uint8_t *buf)
 #define makeOwnershipReport(b,a)  makeType10and20(b, GDL90_OWNSHIP_MSG_ID, a)
 #define makeTrafficReport(b,a)    makeType10and20(b, GDL90_TRAFFIC_MSG_ID, a)
 
+/*
+ * With settings->gdl90_batch on, GDL90_Export() builds the messages one
+ * after another in GDL90_Batch and writes them out together, one UDP
+ * datagram or serial burst per GDL90_BATCH_SIZE bytes rather than one per
+ * message.  No message is longer than UDPpacketBuffer.
+ */
+#define GDL90_BATCH_SIZE  1400    /* fits the WiFi MTU */
+
+static uint8_t GDL90_Batch[GDL90_BATCH_SIZE];
+static size_t  GDL90_batch_len = 0;
+
 static void GDL90_Out(byte *buf, size_t size)
 {
   if (size > 0) {
@@ -476,6 +488,8 @@ static void GDL90_Out(byte *buf, size_t size)
     case DEST_TCP:
 #if defined(NMEA_TCP_SERVICE)
       WiFi_transmit_TCP((char*)buf, size);
+#elif defined(RASPBERRY_PI)
+      NetIO_send(buf, size);
 #endif
       break;
     case DEST_NONE:
@@ -485,35 +499,54 @@ static void GDL90_Out(byte *buf, size_t size)
   }
 }
 
+/* where the next message is to be built */
+static uint8_t *GDL90_Buf()
+{
+  if (settings->gdl90_batch)
+    return &GDL90_Batch[GDL90_batch_len];
+
+  return (uint8_t *) UDPpacketBuffer;
+}
+
+static void GDL90_Flush()
+{
+  GDL90_Out(GDL90_Batch, GDL90_batch_len);
+  GDL90_batch_len = 0;
+}
+
+/* send, or batch, the message just built at GDL90_Buf() */
+static void GDL90_Send(size_t size)
+{
+  if (!settings->gdl90_batch) {
+    GDL90_Out((byte *) UDPpacketBuffer, size);
+    return;
+  }
+
+  GDL90_batch_len += size;
+  if (GDL90_BATCH_SIZE - GDL90_batch_len < UDP_PACKET_BUFSIZE)
+    GDL90_Flush();
+}
+
 void GDL90_Export()
 {
-  size_t size;
   float distance;
   time_t this_moment = now();
-//  uint8_t *buf = (uint8_t *) (sizeof(UDPpacketBuffer) < UDP_PACKET_BUFSIZE ?
-//                              NMEABuffer : UDPpacketBuffer);
-  uint8_t *buf = (uint8_t *) UDPpacketBuffer;
 
   if (settings->gdl90 != DEST_NONE) {
-    size = makeHeartbeat(buf);
-    GDL90_Out(buf, size);
+    GDL90_Send(makeHeartbeat(GDL90_Buf()));
 
 #if defined(DO_GDL90_FF_EXT)
-    size = makeFFid(buf);
-    GDL90_Out(buf, size);
+    GDL90_Send(makeFFid(GDL90_Buf()));
 #endif /* DO_GDL90_FF_EXT */
 
 #if defined(ENABLE_AHRS)
-    size = AHRS_GDL90(buf);
-    GDL90_Out(buf, size);
+    GDL90_Send(AHRS_GDL90(GDL90_Buf()));
 #endif /* ENABLE_AHRS */
 
     if (isValidFix()) {
-      size = makeOwnershipReport(buf, &ThisAircraft);
-      GDL90_Out(buf, size);
+      GDL90_Send(makeOwnershipReport(GDL90_Buf(), &ThisAircraft));
 
-      size = makeGeometricAltitude(buf, &ThisAircraft);
-      GDL90_Out(buf, size);
+      GDL90_Send(makeGeometricAltitude(GDL90_Buf(), &ThisAircraft));
 
       for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
 
@@ -525,12 +558,13 @@ void GDL90_Export()
           distance = Container[i].distance;
 
           if (distance < ALARM_ZONE_NONE) {
-            size = makeTrafficReport(buf, &Container[i]);
-            GDL90_Out(buf, size);
+            GDL90_Send(makeTrafficReport(GDL90_Buf(), &Container[i]));
           }
         }
       }
     }
+
+    GDL90_Flush();
   }
 }
 
@@ -19,12 +19,13 @@
 #include "../../driver/EEPROM.h"
 #include "../../driver/Baro.h"
 #include "../../TrafficHelper.h"
+#include "../../TrafficStore.h"
 #include "../radio/Legacy.h"
 #include "NMEA.h"
 #include "GNS5892.h"
 
 static ufo_t fo1090;
-static char buf1090[256];
+static char buf1090[64];     // command responses only, ADS-B data is not buffered
 static unsigned char msg[14];
 
 typedef struct mmstruct {
@@ -203,7 +204,12 @@ static uint32_t ourcprlonPlus[2], ourcprlonMinus[2];
 // See Figure 5-5 / 5-6 and note that floor is applied to (0.5 + fRP - fEP), not
 // directly to (fRP - fEP). Eq 38 is correct.
 //
-static bool decodeCPRrelative()
+// The NL zone of the target is not looked up here, parse_position() has already
+// placed it, by integer compares of cprlat against the edges precomputed in
+// CPRRelative_precomp(): 0 = our zone, +1 / -1 = adjacent higher / lower NL,
+// anything else = further away (only decoded for the followed aircraft).
+//
+static bool decodeCPRrelative(int zone)
 {
     // convert incoming cprlxx values to the "fractions" (how far into current zone)
     float fractional_lat = mm.cprlat * 7.629394531e-6;  // = 1/131072 = 2^-17
@@ -225,41 +231,31 @@ static bool decodeCPRrelative()
     }
 
     // 'NL' is the number of logitude zones for the target's latitude.
-    // NL[] was pre-computed based on reflat (our location), not rlat (target's).
-    // Check whether the pre-computed NL is correct - likely, if target is close.
-    //   - correct if: (fabs(rlat) < NLtable[NL] && fabs(rlat) >= NLtable[NL+1])
-    float dLon2, scaled, flrlon2, modlon2;
-    float absrlat = fabs(rlat);         // the coding of rlon depends on rlat!
-    bool gt0 = (absrlat >= NLtable[NL[mm.fflag]]);
-    bool lt1 = (absrlat < NLtable[NL[mm.fflag]+1]);
-    if (gt0 || lt1) {
-        // NL is incorrect for the target, need to recompute dLon etc.
-        // First check whether the correct NL is the current one +-1,
-        // which is likely if the target is close to the ref location.
-        // For these adjacent NLs we've also pre-computed things.
-        if (lt1 && absrlat >= NLtable[NL[mm.fflag]+2]) {
-            //NL2 = NL[mm.fflag] + 1;
+    // NL[] was pre-computed based on reflat (our location), not rlat (target's),
+    // along with the values for the adjacent NL zones on either side.
+    float dLon2, flrlon2, modlon2;
+    if (zone == 0) {
+        dLon2 = dLon[mm.fflag];
+        flrlon2 = flrlon[mm.fflag];
+        modlon2 = modlon[mm.fflag];
+    } else if (zone > 0) {
+        if (zone == 1) {
             dLon2 = dLonPlus[mm.fflag];
             flrlon2 = flrlonPlus[mm.fflag];
             modlon2 = modlonPlus[mm.fflag];
-        } else if (gt0 && absrlat < NLtable[NL[mm.fflag]-1]) {
-            //NL2 = NL[mm.fflag] - 1;
-            dLon2 = dLonMinus[mm.fflag];
-            flrlon2 = flrlonMinus[mm.fflag];
-            modlon2 = modlonMinus[mm.fflag];
         } else {
-            // Shift into non-adjacent zone.  This can be < 100 miles away at lat>45.
+            // Shift into non-adjacent zone.  Always well beyond 15 nm.
             // No choice but to do the full NL search and recompute.
-            int NL2 = cprNLFunction_(absrlat, 1, 59);     // = cprNLFunction(rlat)
+            int NL2 = cprNLFunction(rlat);
             dLon2 = cprDlonFunction(mm.fflag, NL2);
-            scaled = reflon * cprDlonInvFunction(mm.fflag, NL2);
+            float scaled = reflon * cprDlonInvFunction(mm.fflag, NL2);
             flrlon2 = floor(scaled);
             modlon2 = scaled - flrlon2;
         }
-    } else {     // pre-computed NL is OK
-            dLon2 = dLon[mm.fflag];
-            flrlon2 = flrlon[mm.fflag];
-            modlon2 = modlon[mm.fflag];
+    } else {
+        dLon2 = dLonMinus[mm.fflag];
+        flrlon2 = flrlonMinus[mm.fflag];
+        modlon2 = modlonMinus[mm.fflag];
     }
 
     // Compute the Longitude Index "m"
@@ -344,13 +340,13 @@ static void CPRRelative_precomp()
         edgelat = NLtable[NL[k]+1];
         if (reflat < 0)  edgelat = -edgelat;
         cprNL1lat[k] = (int32_t)((edgelat-lat0) / dLat[k] * (float)(1<<17) + 0.5);
-        edgelat = NLtable[NL[k]+2];
+        edgelat = NLtable[NL[k] < 59 ? NL[k]+2 : 60];
         if (reflat < 0)  edgelat = -edgelat;
         cprPluslat[k] = (int32_t)((edgelat-lat0) / dLat[k] * (float)(1<<17) + 0.5);
 
         // pre-compute some other values for adjacent NL zones
 
-        int NL2 = NL[k] + 1;
+        int NL2 = (NL[k] < 59 ? NL[k] + 1 : 59);
         dLonPlus[k] = cprDlonFunction(k, NL2);
         dLonHalf = 0.5 * dLonPlus[0];      // for both odd and even, this value is conservative
         scaled = reflon * cprDlonInvFunction(k, NL2);
@@ -393,49 +389,181 @@ static void CPRRelative_setup()
 }
 
 
+// The track cache holds every ICAO address heard recently, whether or not it
+// has a slot in Container[].  It keeps the last even and odd CPR frame for
+// global decoding, and the identity and velocity that arrive before a position
+// message shows the target to be of interest.  Only then is it put into
+// Container[], complete with whatever the cache already knows.
+
+#define ADSB_TRACK_WAYS       8       // entries an address may occupy
+#define ADSB_CPR_PAIR_MS      10000   // max age of the other CPR frame (airborne)
+#define ADSB_VELOCITY_MS      10000   // max age of a velocity to carry over
+
+#define ADSB_TRK_IDENTITY     0x01
+#define ADSB_TRK_VELOCITY     0x02
+#define ADSB_TRK_HEADING      0x04
+
+typedef struct adsb_track_struct {
+    uint32_t  addr;           // 0 = unused
+    uint32_t  seen;           // millis() of the last message
+    uint32_t  cprtime[2];     // millis() of the last even/odd position
+    uint32_t  cprlat[2];
+    uint32_t  cprlon[2];
+    uint32_t  postime;        // millis() of the last decoded position, 0 = none
+    float     latitude;
+    float     longitude;
+    uint32_t  veltime;        // millis() of the last velocity
+    float     speed;          // knots
+    float     course;
+    float     heading;
+    float     vs;             // fpm
+    float     baro_alt_diff;
+    uint8_t   aircraft_type;
+    uint8_t   flags;
+    char      callsign[9];
+} adsb_track_t;
+
+static adsb_track_t adsb_tracks[ADSB_TRACKS];
+static adsb_track_t *trk;     // track of the message being parsed
+
+// set-associative: an address sits in one of ADSB_TRACK_WAYS entries from its
+// hash, a new address takes a free one or else the one not heard from longest
+static adsb_track_t *adsb_track(uint32_t addr)
+{
+    uint32_t now = millis();
+    uint32_t h = (addr * 2654435761u) >> 16;
+    adsb_track_t *victim = NULL;
+
+    for (int w=0; w < ADSB_TRACK_WAYS; w++) {
+        adsb_track_t *tp = &adsb_tracks[(h + w) & (ADSB_TRACKS - 1)];
+        if (tp->addr == addr) {
+            tp->seen = now;
+            return tp;
+        }
+        if (victim == NULL || tp->addr == 0
+         || (victim->addr != 0 && (int32_t)(tp->seen - victim->seen) < 0))
+            victim = tp;
+    }
+
+    memset(victim, 0, sizeof(adsb_track_t));
+    victim->addr = addr;
+    victim->seen = now;
+    return victim;
+}
+
+static void track_identity(ufo_t *cip)
+{
+    if (! (trk->flags & ADSB_TRK_IDENTITY))
+        return;
+    if (trk->aircraft_type != 0)
+        cip->aircraft_type = trk->aircraft_type;
+    if (cip->callsign[0] == '\0')
+        memcpy(cip->callsign, trk->callsign, sizeof(trk->callsign));
+}
+
+static void track_velocity(ufo_t *cip)
+{
+    if (! (trk->flags & ADSB_TRK_VELOCITY))
+        return;
+    if (millis() - trk->veltime > ADSB_VELOCITY_MS)
+        return;
+    if (trk->speed > 0)
+        cip->prevcourse = cip->course;
+    cip->course = trk->course;
+    cip->speed  = trk->speed;
+    cip->vs     = trk->vs;
+    cip->baro_alt_diff = trk->baro_alt_diff;
+    if (trk->flags & ADSB_TRK_HEADING) {
+        cip->prevheading = cip->heading;
+        cip->heading = trk->heading;
+    }
+}
+
+
+static int cprModInt(int a, int b)
+{
+    int res = a % b;
+    if (res < 0)
+        res += b;
+    return res;
+}
+
+// Globally unambiguous decoding, from the latest even and odd frames of the track
+// - from dump1090 decodeCPR(), using the dLat[] and dLonTable[] lookup tables
+//
+static bool decodeCPRglobal(uint32_t now)
+{
+    int f = mm.fflag;
+    if (trk->cprtime[f^1] == 0 || now - trk->cprtime[f^1] > ADSB_CPR_PAIR_MS)
+        return false;
+
+    int32_t lat0 = trk->cprlat[0];
+    int32_t lat1 = trk->cprlat[1];
+    int32_t lon0 = trk->cprlon[0];
+    int32_t lon1 = trk->cprlon[1];
+
+    // products stay below 2^24, exact in a float
+    int j = (int) floor((float)(59*lat0 - 60*lat1) * 7.629394531e-6 + 0.5);
+    float rlat0 = dLat[0] * (cprModInt(j,60) + lat0 * 7.629394531e-6);
+    float rlat1 = dLat[1] * (cprModInt(j,59) + lat1 * 7.629394531e-6);
+    if (rlat0 >= 270) rlat0 -= 360;
+    if (rlat1 >= 270) rlat1 -= 360;
+    if (rlat0 < -90 || rlat0 > 90 || rlat1 < -90 || rlat1 > 90)
+        return false;
+
+    // the two frames must be from the same NL zone
+    int nl = cprNLFunction(rlat0);
+    if (nl != cprNLFunction(rlat1))
+        return false;
+
+    int ni = nl - f;
+    if (ni < 1) ni = 1;
+    int m = (int) floor((float)(lon0*(nl-1) - lon1*nl) * 7.629394531e-6 + 0.5);
+    float rlon = cprDlonFunction(f, nl) * (cprModInt(m,ni) + trk->cprlon[f] * 7.629394531e-6);
+    rlon -= floor((rlon + 180) * (1.0/360)) * 360;
+
+    fo1090.latitude  = (f ? rlat1 : rlat0);
+    fo1090.longitude = rlon;
+    return (true);
+}
+
+
 // the code here repeats some things that are done in Traffic.cpp Addtraffic(),
 // would be better not to repeat, but here disjoint groups of fields are updated
 // via 3 different types of messages, complicating things.
 
 static int find_traffic_by_addr(uint32_t addr)
 {
-    for (int i=0; i<MAX_TRACKING_OBJECTS; i++) {
-        if (Container[i].addr == addr) {
-            if (Container[i].protocol == RF_PROTOCOL_ADSB_1090)
-                return i;      // found
-            if (ThisAircraft.timestamp - Container[i].timestamp <= ENTRY_EXPIRATION_TIME)
-                return -1;     // already tracked via other means
-            // was tracked via other means, but expired - clear this slot
-            Container[i].addr = 0;
-            return MAX_TRACKING_OBJECTS;
-        }
-    }
-    return MAX_TRACKING_OBJECTS;    // not found
+    int i = TrafficStore_Find(addr);
+    if (i < 0)
+        return MAX_TRACKING_OBJECTS;    // not found
+    if (Container[i].protocol == RF_PROTOCOL_ADSB_1090)
+        return i;      // found
+    if (ThisAircraft.timestamp - Container[i].timestamp <= ENTRY_EXPIRATION_TIME)
+        return -1;     // already tracked via other means
+    // was tracked via other means, but expired - clear this slot
+    TrafficStore_Remove(i);
+    return MAX_TRACKING_OBJECTS;
 }
 
 // make room for a new entry
 static int add_traffic_by_dist(float distance)
 {
-    int i;
     // replace an empty object if found
-    for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (Container[i].addr == 0) {
+    int i = TrafficStore_Alloc();
+    if (i >= 0)
         return i;
-      }
-    }
     // replace an expired object if found
-    for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (ThisAircraft.timestamp - Container[i].timestamp > ENTRY_EXPIRATION_TIME) {
+    i = TrafficStore_Oldest();
+    if (i >= 0 && ThisAircraft.timestamp - Container[i].timestamp > ENTRY_EXPIRATION_TIME)
         return i;
-      }
-    }
-    // may replace a non-expired object: identify a less important one
-    for (i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (Container[i].distance > distance
-       && Container[i].alarm_level == ALARM_LEVEL_NONE
-       && Container[i].addr != settings->follow_id) {
+    // may replace a non-expired object: the least important one, if farther
+    i = TrafficStore_LeastImportant();
+    if (i >= 0
+     && Container[i].distance > distance
+     && Container[i].alarm_level == ALARM_LEVEL_NONE
+     && Container[i].addr != settings->follow_id) {
             return i;
-      }
     }
     return MAX_TRACKING_OBJECTS;
 }
@@ -466,6 +594,9 @@ static void update_traffic_position()
         else
             cip->altitude += average_baro_alt_diff;
         cip->timerelayed = 0;
+        // whatever arrived before this target became of interest
+        track_identity(cip);
+        track_velocity(cip);
     } else {
         // this ID already tracked, just update some fields
         cip = &Container[i];
@@ -502,6 +633,8 @@ static void update_traffic_position()
             air_relay(cip);
     }
 
+    TrafficStore_Commit(i);
+
     mm.positiontime = ThisAircraft.timestamp;
 }
 
@@ -524,13 +657,13 @@ static void update_traffic_position()
 // ME (message body): 56 bits
 // PI (CRC etc): 24 bits - can ignore?
 
-// assume the data is always valid and uppercase
-//int hex2bin(char c) {
-//    if (c >= 'A')  return (0xA + (c - 'A'));
-//    return (c - '0');
-//}
-// make this inline:
-#define hex2bin(c) (((c)>='A')? (0xA+((c)-'A')) : ((c)-'0'))
+// the module sends uppercase hex, anything else means a garbled sentence
+static inline int hex2bin(char c)
+{
+    if (c >= '0' && c <= '9')  return (c - '0');
+    if (c >= 'A' && c <= 'F')  return (0xA + (c - 'A'));
+    return -1;
+}
 
 
 // decode Gillham ("Gray") coded altitude
@@ -598,16 +731,6 @@ static float decode_ac12_field() {
 
 static bool parse_identity()
 {
-    // do not create a new entry for an identity message,
-    //   wait until a position message arrives
-    int i = find_traffic_by_addr(fo1090.addr);
-    if (i == MAX_TRACKING_OBJECTS)  // not found
-        return false;
-    if (i < 0)                      // already tracked via other means
-        return false;
-
-    ufo_t *cip = &Container[i];
-
     uint8_t ac_type = 0;
     if (mm.sub != 0 && mm.type > 2)
         ac_type = msg[4] - 0x18;       // 0x18 = 00011000 TC=3, CA=0
@@ -629,30 +752,40 @@ static bool parse_identity()
         // 0xF rotorcraft
 
     if (ac_type != 0)
-        cip->aircraft_type = ac_type_table[ac_type];
+        trk->aircraft_type = ac_type_table[ac_type];
     //if (settings->debug_flags & DEBUG_RESVD1) {
     //    if (cip->aircraft_type == AIRCRAFT_TYPE_UNKNOWN)
     //        Serial.printf("mm.type=%d  mm.sub=%d  msg[4]=%d  ac_type=%d\r\n",
     //            mm.type, mm.sub, msg[4], ac_type);
     //}
 
-    if (cip->callsign[0])   // callsign already known
-        return true;
-
-    //raw_callsign = last 6 bytes
-    // decode callsign
-    static const char *ais_charset = "@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_ !\"#$%&'()*+,-./0123456789:;<=>?";
-    // Note that mapping 6-bit binary values into this table always results in a printable character.
-    // That is why callsign[0]!=0 is a valid check for having received an identity message.
-    cip->callsign[0] = ais_charset[msg[5]>>2];
-    cip->callsign[1] = ais_charset[((msg[5]&3)<<4)|(msg[6]>>4)];
-    cip->callsign[2] = ais_charset[((msg[6]&15)<<2)|(msg[7]>>6)];
-    cip->callsign[3] = ais_charset[msg[7]&63];
-    cip->callsign[4] = ais_charset[msg[8]>>2];
-    cip->callsign[5] = ais_charset[((msg[8]&3)<<4)|(msg[9]>>4)];
-    cip->callsign[6] = ais_charset[((msg[9]&15)<<2)|(msg[10]>>6)];
-    cip->callsign[7] = ais_charset[msg[10]&63];
-    cip->callsign[8] = '\0';
+    if (trk->callsign[0] == '\0') {   // callsign not known yet
+        //raw_callsign = last 6 bytes
+        // decode callsign
+        static const char *ais_charset = "@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_ !\"#$%&'()*+,-./0123456789:;<=>?";
+        // Note that mapping 6-bit binary values into this table always results in a printable character.
+        // That is why callsign[0]!=0 is a valid check for having received an identity message.
+        trk->callsign[0] = ais_charset[msg[5]>>2];
+        trk->callsign[1] = ais_charset[((msg[5]&3)<<4)|(msg[6]>>4)];
+        trk->callsign[2] = ais_charset[((msg[6]&15)<<2)|(msg[7]>>6)];
+        trk->callsign[3] = ais_charset[msg[7]&63];
+        trk->callsign[4] = ais_charset[msg[8]>>2];
+        trk->callsign[5] = ais_charset[((msg[8]&3)<<4)|(msg[9]>>4)];
+        trk->callsign[6] = ais_charset[((msg[9]&15)<<2)|(msg[10]>>6)];
+        trk->callsign[7] = ais_charset[msg[10]&63];
+        trk->callsign[8] = '\0';
+    }
+    trk->flags |= ADSB_TRK_IDENTITY;
+
+    // do not create a new entry for an identity message,
+    //   wait until a position message arrives
+    int i = find_traffic_by_addr(fo1090.addr);
+    if (i == MAX_TRACKING_OBJECTS)  // not found
+        return false;
+    if (i < 0)                      // already tracked via other means
+        return false;
+
+    track_identity(&Container[i]);
 
     return true;
 }
@@ -674,6 +807,17 @@ static bool parse_position()
         fo1090.altitude = (float)((msg[5] << 4) | ((msg[6] >> 4) & 0x0F));   // meters!
     }
 
+    mm.fflag = ((msg[6] & 0x4) >> 2);
+    //tflag = msg[6] & 0x8;
+    mm.cprlat = ((msg[6] & 3) << 15) | (msg[7] << 7) | (msg[8] >> 1);
+    mm.cprlon = ((msg[8]&1) << 16) | (msg[9] << 8) | msg[10];
+
+    // keep the frame for global decoding, even if this target is not of interest now
+    uint32_t now = millis();
+    trk->cprlat[mm.fflag]  = mm.cprlat;
+    trk->cprlon[mm.fflag]  = mm.cprlon;
+    trk->cprtime[mm.fflag] = now;
+
     // filter by altitude, but always include "followed" aircraft
     if (fabs(fo1090.altitude - ThisAircraft.altitude) > 2000) {
         if (fo1090.addr != settings->follow_id)
@@ -682,11 +826,6 @@ static bool parse_position()
 
     // prepare to decode lat/lon
 
-    mm.fflag = ((msg[6] & 0x4) >> 2);
-    //tflag = msg[6] & 0x8;
-    mm.cprlat = ((msg[6] & 3) << 15) | (msg[7] << 7) | (msg[8] >> 1);
-    mm.cprlon = ((msg[8]&1) << 16) | (msg[9] << 8) | msg[10];
-
     int32_t m = (int32_t) mm.cprlat;
     int32_t r = (int32_t) ourcprlat[mm.fflag];   // convert from unsigned to signed...
     if (m-r > (1<<16)) {
@@ -704,18 +843,22 @@ static bool parse_position()
     }
 
     // identify the NL zone, ours, an adjacent one, or beyond
-    bool adjacent = true;
-    if (reflat < 7.5 && reflat > 7.5) {              // one big NL zone around the equator
+    int zone = 0;
+    if (reflat < 7.5 && reflat > -7.5) {             // one big NL zone around the equator
         r = (int32_t) ourcprlon[mm.fflag];
     } else if (reflat > 0) {
       if (m < cprNL1lat[mm.fflag]) {                 // target lat in higher-NL zone
         if (m < cprPluslat[mm.fflag]) {              // beyond the adjacent zone
-            adjacent = false;
+            zone = 2;
+        } else {
+            zone = 1;
         }
         r = (int32_t) ourcprlonPlus[mm.fflag];
       } else if (m > cprNL0lat[mm.fflag]) {          // target lat in lower-NL zone
         if (m > cprMinuslat[mm.fflag]) {             // beyond the adjacent zone
-            adjacent = false;
+            zone = 2;
+        } else {
+            zone = -1;
         }
         r = (int32_t) ourcprlonMinus[mm.fflag];
       } else {
@@ -724,12 +867,16 @@ static bool parse_position()
     } else {                                         // reflat < 0
       if (m > cprNL1lat[mm.fflag]) {                 // in higher-NL zone (towards equator)
         if (m > cprPluslat[mm.fflag]) {              // beyond the adjacent zone
-            adjacent = false;
+            zone = 2;
+        } else {
+            zone = 1;
         }
         r = (int32_t) ourcprlonPlus[mm.fflag];
       } else if (m < cprNL0lat[mm.fflag]) {          // in lower-NL zone (towards south pole)
         if (m < cprMinuslat[mm.fflag]) {             // beyond the adjacent zone
-            adjacent = false;
+            zone = 2;
+        } else {
+            zone = -1;
         }
         r = (int32_t) ourcprlonMinus[mm.fflag];
       } else {
@@ -744,7 +891,11 @@ static bool parse_position()
     }
     int32_t cprlondiff = m - r;
     int32_t abslondiff = abs(cprlondiff);
-    if (adjacent) {
+    if (zone == 2) {
+      // beyond the adjacent NL zone is at least 0.46 deg of latitude away
+      if (fo1090.addr != settings->follow_id)
+          return false;
+    } else {
       if (fo1090.addr != settings->follow_id) {
         // reject some too-far traffic based on lon-diff alone
         if (abslondiff > maxcprdiff)
@@ -762,8 +913,23 @@ static bool parse_position()
 
     yield();
 
-    if (decodeCPRrelative() < 0)        // error decoding lat/lon
-        return false;
+    // the relative decode is a fallback until both an even and an odd frame are in
+    if (! decodeCPRglobal(now) && ! decodeCPRrelative(zone))
+        return false;                   // error decoding lat/lon
+
+    // a jump from the last position of this track is a garbled frame,
+    // forget the old position too in case that was the bad one
+    if (trk->postime != 0 && now - trk->postime < 30000) {
+        int32_t jy = (int32_t)(111300.0 * (fo1090.latitude - trk->latitude));
+        int32_t jx = (int32_t)(111300.0 * (fo1090.longitude - trk->longitude) * CosLat(reflat));
+        if (iapproxHypotenuse1(jx, jy) > 500 + ((now - trk->postime) >> 2)) {   // 250 m/s
+            trk->postime = 0;
+            return false;
+        }
+    }
+    trk->latitude  = fo1090.latitude;
+    trk->longitude = fo1090.longitude;
+    trk->postime   = now;
 
     // compute more exact distance, from this aircraft's actual location
     int32_t y = (int32_t)(111300.0 * (fo1090.latitude - ThisAircraft.latitude));     // meters
@@ -793,16 +959,6 @@ static bool parse_position()
 
 static bool parse_velocity()
 {
-    // do not create a new entry for a velocity message,
-    //   wait until position message arrives
-    int i = find_traffic_by_addr(fo1090.addr);
-    if (i == MAX_TRACKING_OBJECTS)  // not found
-        return false;
-    if (i < 0)                      // already tracked via other means
-        return false;
-
-    ufo_t *cip = &Container[i];
-
     int ew_dir;
     int ew_velocity;
     int ns_dir;
@@ -833,16 +989,15 @@ static bool parse_velocity()
           mm.nsv = ns_velocity;
 
       // Compute velocity and angle from the two speed components
-      cip->speed = (float) iapproxHypotenuse0(mm.nsv, mm.ewv);   // knots
-      if (cip->speed > 0) {
-          cip->prevcourse = cip->course;
-          cip->course = iatan2_approx(mm.nsv, mm.ewv);
+      trk->speed = (float) iapproxHypotenuse0(mm.nsv, mm.ewv);   // knots
+      if (trk->speed > 0) {
+          trk->course = iatan2_approx(mm.nsv, mm.ewv);
           // We don't want negative values but a 0-360 scale.
-          if (cip->course < 0)
-              cip->course += 360;
+          if (trk->course < 0)
+              trk->course += 360;
           mm.track_is_valid = 1;
       } else {
-          cip->course = 0;
+          trk->course = 0;
           mm.track_is_valid=0;
       }
 
@@ -852,10 +1007,10 @@ static bool parse_velocity()
     } else if (mm.sub == 3 || mm.sub == 4) {   // air speed (rare) (not processed here)
 
       mm.heading_is_valid = ((msg[5] & 4) >> 2);
-      cip->prevheading = cip->heading;
       int16_t iheading = (((msg[5] & 3) << 5) | ((msg[6] >> 3) & 0x1F));
-      //cip->heading = (360.0/128) * iheading;
-      cip->heading = ((iheading * 360 + 180) >> 7);
+      //trk->heading = (360.0/128) * iheading;
+      trk->heading = ((iheading * 360 + 180) >> 7);
+      trk->flags |= ADSB_TRK_HEADING;
       mm.airspeed_type = (((msg[7]) >> 7) & 1);
       mm.airspeed = ((msg[7]&0x7F) << 3) | (((msg[8]) >> 5) & 0x07);  // if 0, no info
       if (mm.airspeed > 0)        // zero means not available
@@ -870,14 +1025,29 @@ static bool parse_velocity()
     mm.vert_rate_source = (msg[8]&0x10) >> 4;   // 0=GNSS, 1=baro
     int vert_rate_sign = (msg[8]&0x8) >> 3;
     int raw_vert_rate = ((msg[8]&7) << 6) | ((msg[9]&0xfc) >> 2);
-    cip->vs = (float)((raw_vert_rate - 1) << 6);    // fpm
-    if (vert_rate_sign)  cip->vs = -cip->vs;
+    trk->vs = (float)((raw_vert_rate - 1) << 6);    // fpm
+    if (vert_rate_sign)  trk->vs = -trk->vs;
     int raw_alt_diff = msg[10];  // MSB is sign
     int alt_diff_sign = ((raw_alt_diff & 0x80) >> 7);
     // raw_alt_diff = ((raw_alt_diff & 0x7F) - 1) * 25;   // feet
     raw_alt_diff = ((((raw_alt_diff & 0x7F) - 1) * 7803) >> 10);   // meters
     if (alt_diff_sign)  raw_alt_diff = -raw_alt_diff;  // GNSS altitude is below baro altitude
-    cip->baro_alt_diff = (float)raw_alt_diff;
+    trk->baro_alt_diff = (float)raw_alt_diff;
+    trk->flags |= ADSB_TRK_VELOCITY;
+    trk->veltime = millis();
+
+    mm.velocitytime = ThisAircraft.timestamp;
+
+    // do not create a new entry for a velocity message,
+    //   wait until position message arrives
+    int i = find_traffic_by_addr(fo1090.addr);
+    if (i == MAX_TRACKING_OBJECTS)  // not found
+        return false;
+    if (i < 0)                      // already tracked via other means
+        return false;
+
+    ufo_t *cip = &Container[i];
+    track_velocity(cip);
 
     // keep an average estimate of baro alt diff as reporterd from nearby aircraft
     static uint32_t prev_addr = 0;
@@ -890,54 +1060,19 @@ static bool parse_velocity()
         prev_count = 127;
     }
 
-    mm.velocitytime = ThisAircraft.timestamp;
-
     return true;
 }
 
 
-// assume the n chars in buf[] include the starting '*' but not the ending ';'
+// msg[] has been filled in by gns5892_input() and the DF is already known to be 17 or 18
 
-static bool parse(char *buf, int n)
+static bool parse(uint8_t rssi)
 {
     mm = EmptyMsg;      // start with a clean slate of all zeros
     mm.msgtype = ' ';
-    int k=0;
-    int i=1;
-    if (buf[0] == '*') {
-        if (n != 29)
-            return false;     // not a 112-bit ES
-        mm.rssi = 0;
-    } else
-    if (buf[0] == '+') {
-        if (n != 31)
-            return false;     // not a 112-bit ES
-        mm.rssi = (hex2bin(buf[1]) << 4) | hex2bin(buf[2]);
-        i = 3;    // point to DF
-    }
-    else
-        return false;     // not a valid GNS5892 sentence
-
-    // parse just the first 4 bytes for now
-    int j=0;
-    while (j < 4) {
-        msg[j++] = (hex2bin(buf[i]) << 4) | hex2bin(buf[i+1]);
-        i += 2;
-    }
-
+    mm.rssi = rssi;
     mm.frame = msg[0]>>3;    // Downlink Format
 
-    if (mm.frame != 17 && mm.frame != 18)
-        return false;
-
-    // convert the rest of the message from hex to binary
-    n -= 6;               // skip the PI (checksum field)
-    j=4;
-    while (i < n) {
-        msg[j++] = (hex2bin(buf[i]) << 4) | hex2bin(buf[i+1]);
-        i += 2;
-    }
-
 /*
 To determine whether you receive an ADS-B message or a TIS-B message you should start
 looking at the Downlink Format (DF, first 5 bits of the message) if the DF = 17, then
@@ -977,6 +1112,8 @@ https://aviation.stackexchange.com/questions/17610/what-icao-codes-are-reserved-
     if (fo1090.addr == settings->ignore_id)      // ID told in settings to ignore
         return false;
 
+    trk = adsb_track(fo1090.addr);
+
     yield();
 
     // parsing of the 56-bit ME - just DF 17-18:
@@ -1055,6 +1192,112 @@ void gns5892_setup()
 }
 
 
+// Sentences are decoded as the characters come out of the UART driver's buffer,
+// the hex digits go straight into msg[] - nothing is assembled into a line first.
+// Once the first byte (DF) is complete anything other than DF17/18 is dropped,
+// the rest of that sentence is skipped over without being converted.
+
+enum {
+    GNS_RX_IDLE,    // waiting for '*', '+' or '#'
+    GNS_RX_RSSI,    // 2 hex digits after '+'
+    GNS_RX_DATA,    // up to 28 hex digits of the message
+    GNS_RX_REPLY    // response to a command, copied into buf1090[]
+};
+
+static uint8_t rx_state = GNS_RX_IDLE;
+static uint8_t rx_digits;         // hex digits received in the current field
+static uint8_t rx_rssi;
+static int     rx_n;              // chars in buf1090[]
+
+static void reply5892()
+{
+    if (rx_n <= 14)       // too short to be a complete response
+        return;
+    if (rx1090found == false) {
+        if (buf1090[1]=='4' && buf1090[2]=='9' && buf1090[5]=='3') {  // response to "play"
+            rx1090found = true;
+            Serial.println(">>> GNS5892 module responded");
+        }
+    }
+    Serial.write(buf1090, rx_n);        // copy to console
+    Serial.println("");
+}
+
+// returns the number of complete sentences seen
+static int gns5892_input(const uint8_t *p, int len)
+{
+    int sentences = 0;
+
+    while (len-- > 0) {
+        char c = *p++;
+        if (c=='*' || c=='+' || c=='#') {      // start new sentence, drop any preceding data
+            rx_digits = 0;
+            rx_rssi = 0;
+            if (c == '*') {
+                rx_state = GNS_RX_DATA;
+            } else if (c == '+') {
+                rx_state = GNS_RX_RSSI;
+            } else {
+                rx_state = GNS_RX_REPLY;
+                buf1090[0] = c;
+                rx_n = 1;
+            }
+            continue;
+        }
+        if (rx_state == GNS_RX_IDLE)
+            continue;
+        if (c==';' || c=='\r' || c=='\n') {     // completed sentence
+            if (rx_state == GNS_RX_DATA) {
+                if (rx_digits == 28)           // a 112-bit ES
+                    (void) parse(rx_rssi);
+                ++sentences;
+            } else if (rx_state == GNS_RX_REPLY) {
+                reply5892();
+                ++sentences;
+            }
+            rx_state = GNS_RX_IDLE;
+            continue;
+        }
+        if (rx_state == GNS_RX_REPLY) {
+            if (rx_n < (int) sizeof(buf1090))
+                buf1090[rx_n++] = c;
+            continue;
+        }
+        int v = hex2bin(c);
+        if (v < 0) {
+            rx_state = GNS_RX_IDLE;
+            continue;
+        }
+        if (rx_state == GNS_RX_RSSI) {
+            rx_rssi = (rx_rssi << 4) | v;
+            if (++rx_digits == 2) {
+                rx_digits = 0;
+                rx_state = GNS_RX_DATA;
+            }
+            continue;
+        }
+        // GNS_RX_DATA
+        if (rx_digits >= 28) {                 // longer than an ES
+            rx_state = GNS_RX_IDLE;
+            continue;
+        }
+        int j = (rx_digits >> 1);
+        if ((rx_digits & 1) == 0) {
+            msg[j] = (v << 4);
+        } else {
+            msg[j] |= v;
+            if (j == 0) {
+                int df = msg[0] >> 3;
+                if (df != 17 && df != 18)
+                    rx_state = GNS_RX_IDLE;    // not an ES, skip the rest
+            }
+        }
+        ++rx_digits;
+    }
+
+    return sentences;
+}
+
 // called from NMEA.cpp NMEA_loop() when appropriate
 void gns5892_loop()
 {
@@ -1063,53 +1306,26 @@ void gns5892_loop()
 
   CPRRelative_precomp();   // usually does nothing
 
+  // drain what has arrived so far, in bulk reads from the UART driver
+  // - no data is discarded, a busy terminal area fills the buffer quickly
   int avail = Serial2.available();
   if (avail <= 0)
       return;
-  if (avail > (GNS5892_INPUT_BUF_SIZE - 256))    // input buffer is getting full
-      Serial2.readBytes(buf1090, 256);           // discard some input data
-
-  static bool input_complete = false;
-  static int n = 0;  // inputchars
-  if (input_complete)
-      n = 0;          // start a new input sentence
-  input_complete = false;
-  while (Serial2.available()) {  // loop until a full sentence or no more data
-      char c = Serial2.read();
-      if (c=='*' || c=='+' || c=='#') {
-          buf1090[0] = c;            // start new sentence, drop any preceding data
-          n = 1;
-      } else if (n == 0) {      // wait for a valid starting char
-          continue;
-      } else if (c==';' || c=='\r' || c=='\n') {   // completed sentence
-          if (n > 14 /* && n <= 32 */ ) {
-              input_complete = true;
-              break;
-          }
-          n = 0;                 // invalid, start over
-      } else {
-          buf1090[n++] = c;
-      }
-  }
-  yield();
-  if (! input_complete || n == 0)
-      return;
 
-  if (buf1090[0] == '*' || buf1090[0] == '+') {    // ADS-B data received
-      (void) parse(buf1090, n);
+  int sentences = 0;
+  uint8_t chunk[128];
+  while (avail > 0) {
+      int n = (avail < (int) sizeof(chunk) ? avail : (int) sizeof(chunk));
+      n = Serial2.readBytes(chunk, n);
+      if (n <= 0)
+          break;
+      sentences += gns5892_input(chunk, n);
+      avail -= n;
       yield();
-  } else if (buf1090[0] == '#') {                  // response to commands
-      if (rx1090found == false) {
-        if (buf1090[1]=='4' && buf1090[2]=='9' && buf1090[5]=='3') {  // response to "play"
-            rx1090found = true;
-            Serial.println(">>> GNS5892 module responded");
-        }
-      }
-      Serial.write(buf1090, n);           // copy to console
-      Serial.println("");
   }
 
-  NMEA_bridge_sent = true;   // not really sent, but substantial processing
+  if (sentences > 0)
+      NMEA_bridge_sent = true;   // not really sent, but substantial processing
 }
 
 #endif  // ESP32
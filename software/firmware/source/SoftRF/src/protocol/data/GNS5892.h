@@ -19,6 +19,11 @@
 #ifndef GNS5892_H
 #define GNS5892_H
 
+/* ADS-B track cache entries, not tied to MAX_TRACKING_OBJECTS - a power of 2 */
+#ifndef ADSB_TRACKS
+#define ADSB_TRACKS     64
+#endif
+
 void play5892(void);
 void gns5892_setup(void);
 void gns5892_loop(void);
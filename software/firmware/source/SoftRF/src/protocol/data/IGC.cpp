@@ -32,6 +32,12 @@
 #include "../../driver/Baro.h"
 #include "NMEA.h"
 #include "IGC.h"
+#include "Recorder.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #define INI_FILE              "/logs/IGC_CONF.TXT"
 
@@ -50,6 +56,8 @@ static char brecord_template[] = "B1751494352910N07215306WA%05d%05d\r\n";
 #define PRE_POS_NUM   8    // number of pre-stored B-records
 //#define G_RECORD_SIZE (8 * (1+16+2))   // G+16+\r\n
 #define DATA_BLOCK_SIZE 3000
+static char *data_block[2];            // one filling, one being written
+static int data_block_active = 0;
 static char *data_block_buf = NULL;    // will be malloc()ed into PSRAM
 static int data_block_used = 0;
 static char *pre_positions_buf = NULL;
@@ -57,6 +65,21 @@ static int num_pre_positions = 0;
 static int pre_positions_head = 0;
 static int pre_positions_next = 0;
 
+// the full blocks are written out by a separate task, with the MD5 and G-records
+#define IGC_FLUSH_WAIT_MS 5000
+typedef struct igc_job_struct {
+    const char *buf;
+    int used;
+    bool final;       // write the G-record into the file for good
+} igc_job_t;
+static QueueHandle_t igc_queue = NULL;
+static SemaphoreHandle_t igc_idle = NULL;   // taken while a block is being written
+static TaskHandle_t igc_task_handle = NULL;
+// the writer owns FlightLog, FlightLogPosition and the MD5 contexts while it
+// holds igc_idle, and leaves a failure here for the main loop, which turns it
+// into FlightLogFail once it has the semaphore back
+static bool igc_write_fail = false;
+
 // default config
 static const char* CONFIG_DEFAULT_PILOT = "Chuck Yeager";
 static const char* CONFIG_DEFAULT_TYPE  = "ASW20";
@@ -69,17 +92,22 @@ static MD5_CTX md5_buf[8];   // or could malloc() it in PSRAM?
 static MD5_CTX *md5_a, *md5_b, *md5_c, *md5_d;
 static MD5_CTX *md5_a_copy, *md5_b_copy, *md5_c_copy, *md5_d_copy;
 
+static void igc_task(void *param);
+
 void FlightLog_setup()
 {
     if (FlightLogFail)
         return;
-    data_block_buf = (char *) malloc(DATA_BLOCK_SIZE + B_RECORD_SIZE*PRE_POS_NUM);
+    data_block_buf = (char *) malloc(2*DATA_BLOCK_SIZE + B_RECORD_SIZE*PRE_POS_NUM);
     // the combined block is intended to be stored in PSRAM if possible
     if (! data_block_buf) {
         FlightLogFail = true;
         return;
     }
-    pre_positions_buf = data_block_buf + DATA_BLOCK_SIZE;
+    data_block[0] = data_block_buf;
+    data_block[1] = data_block_buf + DATA_BLOCK_SIZE;
+    data_block_active = 0;
+    pre_positions_buf = data_block_buf + 2*DATA_BLOCK_SIZE;
     //MD5_CTX *p = (MD5_CTX *) malloc(8*sizeof(MD5_CTX));
     //if (! data_block_buf) {
     //    free(data_block_buf);
@@ -95,6 +123,23 @@ void FlightLog_setup()
     md5_b_copy = p++;
     md5_c_copy = p++;
     md5_d_copy = p;
+
+    // without the task the blocks are written from the main loop, as they fill
+    // - so they are when the SD card shares the VSPI bus, unlocked, with the radio
+    if (settings->sd_card == SD_CARD_LORA) {
+        Serial.println(F("SD card on the LoRa SPI bus, writing from the main loop"));
+        return;
+    }
+    igc_queue = xQueueCreate(1, sizeof(igc_job_t));
+    igc_idle = xSemaphoreCreateBinary();
+    if (igc_queue == NULL || igc_idle == NULL
+     || xTaskCreate(igc_task, "IGC", 4096, NULL, tskIDLE_PRIORITY + 1,
+                    &igc_task_handle) != pdPASS) {
+        Serial.println(F("No IGC flush task, writing from the main loop"));
+        igc_task_handle = NULL;
+        return;
+    }
+    xSemaphoreGive(igc_idle);
 }
 
 char clean_igc_char(char c)
@@ -112,13 +157,12 @@ char clean_igc_char(char c)
 void failFlightLog()
 {
     FlightLog.close();
-    FlightLogOpen = false;
-    FlightLogFail = true;
+    igc_write_fail = true;
 }
 
 void write_g_record(MD5_CTX *md5)
 {
-    if (FlightLogFail)
+    if (igc_write_fail)
         return;
     //if (! FlightLogOpen)
     //    return;
@@ -140,93 +184,174 @@ void write_g_record(MD5_CTX *md5)
 
 void reopenFlightLog()
 {
-    if (FlightLogFail)
-        return;
-    if (! FlightLogOpen)    // no log file in process
+    if (igc_write_fail)
         return;
     if (!FlightLogPath[0])  // file name has not been generated
         return;
     FlightLog = SD.open(FlightLogPath, FILE_WRITE);
     if (!FlightLog) {
         Serial.println("Failed to re-open flight log for writing");
-        FlightLogFail = true;
+        igc_write_fail = true;
         return;
     }
     if (!FlightLog.seek(FlightLogPosition)) {
         Serial.println("Flight log seek() failed");
         FlightLog.close();
-        FlightLogFail = true;
+        igc_write_fail = true;
         return;
     }
 }
 
-void closeFlightLog()
+void MD5_update(const char *data, size_t size)
 {
-    if (! FlightLogOpen)    // no log file in process
-        return;
-    if (!FlightLogFail)
-        reopenFlightLog();
-    if (FlightLogFail)
+    MD5::MD5Update(md5_a, data, size);
+    MD5::MD5Update(md5_b, data, size);
+    MD5::MD5Update(md5_c, data, size);
+    MD5::MD5Update(md5_d, data, size);
+}
+
+// The security hash covers the records as they are in the file, less the
+// CR LF and any commas, and skips the LPLT comments.  A block only holds
+// whole records.
+static void MD5_block(const char *p, int size)
+{
+    const char *end = p + size;
+    while (p < end) {
+        const char *eol = (const char *) memchr(p, '\r', end - p);
+        if (eol == NULL)
+            eol = end;
+        if (eol - p < 4 || strncmp(p, "LPLT", 4) != 0) {
+            const char *q = p;
+            for (const char *c = p; c < eol; c++) {
+                if (*c == 0x2C) {           // *skip* the commas in MD5 calculation
+                    if (c > q)
+                        MD5_update(q, c - q);
+                    q = c + 1;
+                }
+            }
+            if (eol > q)
+                MD5_update(q, eol - q);
+        }
+        p = eol + 2;
+    }
+}
+
+// write out a full block, or the last one, followed by the G-record
+static void igc_write_block(const char *buf, int used, bool final)
+{
+    reopenFlightLog();
+    if (igc_write_fail)
         return;
-    if (data_block_used > 0) {
-        if (FlightLog.write((const uint8_t*) data_block_buf, data_block_used) < data_block_used) {
+    MD5_block(buf, used);
+    if (used > 0) {
+        if (FlightLog.write((const uint8_t*) buf, used) < used) {
             failFlightLog();
             return;
         }
     }
-    //data_block_used = 0;
-    //FlightLogPosition = 0;
-    write_g_record(md5_a);
-    write_g_record(md5_b);
-    write_g_record(md5_c);
-    write_g_record(md5_d);
+    if (final) {
+        write_g_record(md5_a);
+        write_g_record(md5_b);
+        write_g_record(md5_c);
+        write_g_record(md5_d);
+        FlightLog.close();
+        FlightLogClosed = millis();
+        Serial.println("Flight log closed");
+        return;
+    }
+    FlightLogPosition += used;  // file position before the G-record
+    // temporarily close the file complete with a G-record
+    // finalize a copy of the MD5 context - keep the main context un-finalized
+    *md5_a_copy = *md5_a;
+    *md5_b_copy = *md5_b;
+    *md5_c_copy = *md5_c;
+    *md5_d_copy = *md5_d;
+    write_g_record(md5_a_copy);
+    write_g_record(md5_b_copy);
+    write_g_record(md5_c_copy);
+    write_g_record(md5_d_copy);
     FlightLog.close();
-    FlightLogOpen = false;
-    FlightLogClosed = millis();
-    //FlightLogPath[0] = '\0';   // leave intact for Web.cpp/flightlogfile()
-    Serial.println("Flight log closed");
+    Serial.print("Flight log updated, size now: ");
+    Serial.println(FlightLogPosition);
 }
 
-void MD5_update(const char *data, size_t size)
+static void igc_task(void *param)
 {
-    MD5::MD5Update(md5_a, data, size);
-    MD5::MD5Update(md5_b, data, size);
-    MD5::MD5Update(md5_c, data, size);
-    MD5::MD5Update(md5_d, data, size);
+    igc_job_t job;
+    for (;;) {
+        if (xQueueReceive(igc_queue, &job, portMAX_DELAY) != pdTRUE)
+            continue;
+        igc_write_block(job.buf, job.used, job.final);
+        xSemaphoreGive(igc_idle);
+    }
+}
+
+// hand the block being filled to the task, and start filling the other one;
+// false while the task may still be writing, then the log stays failed
+static bool igc_post_block(bool final)
+{
+    if (igc_task_handle == NULL) {
+        igc_write_block(data_block_buf, data_block_used, final);
+        data_block_used = 0;
+        if (igc_write_fail)
+            FlightLogFail = true;
+        return true;
+    }
+    // the previous block had all the time this one took to fill
+    if (xSemaphoreTake(igc_idle, pdMS_TO_TICKS(IGC_FLUSH_WAIT_MS)) != pdTRUE) {
+        Serial.println("Flight log write timed out");
+        FlightLogFail = true;
+        return false;
+    }
+    if (igc_write_fail) {
+        xSemaphoreGive(igc_idle);
+        FlightLogFail = true;
+        return true;
+    }
+    igc_job_t job = { data_block_buf, data_block_used, final };
+    xQueueSend(igc_queue, &job, 0);
+    data_block_active ^= 1;
+    data_block_buf = data_block[data_block_active];
+    data_block_used = 0;
+    if (final) {
+        // the file must be complete when this returns
+        if (xSemaphoreTake(igc_idle, pdMS_TO_TICKS(IGC_FLUSH_WAIT_MS)) != pdTRUE) {
+            Serial.println("Flight log close timed out");
+            FlightLogFail = true;
+            return false;
+        }
+        xSemaphoreGive(igc_idle);
+        if (igc_write_fail)
+            FlightLogFail = true;
+    }
+    return true;
+}
+
+void closeFlightLog()
+{
+    if (! FlightLogOpen)    // no log file in process
+        return;
+    if (FlightLogFail)
+        return;
+    if (! igc_post_block(true))
+        return;             // not while the task is still at the file
+    Recorder_close();
+    FlightLogOpen = false;
+    //FlightLogPath[0] = '\0';   // leave intact for Web.cpp/flightlogfile()
 }
 
 // common code to the functions below
+// - only a copy here, the writing and MD5 are done by igc_task()
 void igc_file_append(const char *data, size_t size)
 {
     if (data_block_used + size > DATA_BLOCK_SIZE) {
-        // flush the block before writing the new data
-        if (!FlightLogFail)
-            reopenFlightLog();
         if (FlightLogFail)
             return;
-        if (FlightLog.write((const uint8_t*) data_block_buf, data_block_used) < data_block_used) {
-            failFlightLog();
+        igc_post_block(false);
+        if (FlightLogFail)
             return;
-        }
-        FlightLogPosition += data_block_used;  // file position before the G-record
-        data_block_used = 0;
-        // temporarily close the file complete with a G-record
-        // finalize a copy of the MD5 context - keep the main context un-finalized
-        // this is based on the MD5 state *before* updating with the new data
-        *md5_a_copy = *md5_a;
-        *md5_b_copy = *md5_b;
-        *md5_c_copy = *md5_c;
-        *md5_d_copy = *md5_d;
-        write_g_record(md5_a_copy);
-        write_g_record(md5_b_copy);
-        write_g_record(md5_c_copy);
-        write_g_record(md5_d_copy);
-        FlightLog.close();
-        Serial.print("Flight log updated, size now: ");
-        Serial.println(FlightLogPosition);
-        yield();
     }
-    strncpy(data_block_buf + data_block_used, data, size);
+    memcpy(data_block_buf + data_block_used, data, size);
     data_block_used += size;
     //Serial.print("data_block_used = ");
     //Serial.println(data_block_used);
@@ -241,8 +366,6 @@ void igc_file_append_const(const char *data)
     if (size < 3)
         return;   // should not happen
     igc_file_append(data, size);         // include \r\n
-    MD5_update(data, size-2);            // exclude \r\n
-    yield();
 }
 
 // this checks and corrects the chars, they cannot be const
@@ -263,24 +386,7 @@ void igc_file_append_nonconst(char *data, bool keepcommas=false, bool iscomment=
     if (size == 0)
         return;   // should not happen
     igc_file_append(data, size+2);     // include \r\n
-    if (iscomment)
-        return;                       // skip MD5 calc
-    if (keepcommas) {
-        char *q = data;
-        for (p=data; *p; ++p) {
-            if (*p == '\r')
-                break;
-            if (*p != 0x2C) {
-                *q++ = *p;             // *skip* the commas in MD5 calculation
-            } else {
-                --size;
-                if (size == 0)
-                    return;
-            }
-        }
-    }
-    MD5_update(data, size);            // exclude \r\n
-    yield();
+    // the comment (LPLT) lines are left out of the MD5, see MD5_block()
 }
 
 // this checks and corrects the chars, they cannot be const
@@ -503,6 +609,8 @@ void openFlightLog()
         FlightLogPosition = 0;
         init_md5();
         writeIGCHeader();       // into PSRAM block
+        if (settings->logflight == FLIGHT_LOG_TRAFFIC)
+            Recorder_open(FlightLogPath);
         return;
     }
     Serial.println("Failed to open flight log for writing");
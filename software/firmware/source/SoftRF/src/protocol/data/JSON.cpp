@@ -29,6 +29,7 @@
 #include "../../driver/Baro.h"
 #include "../../driver/EPD.h"
 #include "../../TrafficHelper.h"
+#include "../../TrafficStore.h"
 #include "NMEA.h"
 #include "GDL90.h"
 #include "D1090.h"
@@ -220,36 +221,30 @@ void parsePING(JsonObject root)
         int j;
 
         /* Try to find and update an entry with the same aircraft ID */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == fo.addr && Container[j].protocol == fo.protocol) {
+        j = TrafficStore_Find(fo.addr);
+        if (j >= 0) {
+          /* same ID already tracked via other means - leave that be */
+          if (Container[j].protocol == fo.protocol ||
+              timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
             Container[j] = fo;
-            break;
+            TrafficStore_Commit(j);
           }
-        }
-
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
+          continue;
         }
 
         /* Fill a free entry if able */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == 0 &&
-             memcmp(Container[j].raw, EmptyFO.raw, sizeof(EmptyFO.raw)) == 0) {
-            Container[j] = fo;
-            break;
-          }
-        }
+        j = TrafficStore_Alloc();
 
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
+        /* Overwrite expired entry */
+        if (j < 0) {
+          j = TrafficStore_Oldest();
+          if (j >= 0 && timestamp - Container[j].timestamp <= ENTRY_EXPIRATION_TIME)
+            j = -1;
         }
 
-        /* Overwrite expired entry */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
-            Container[j] = fo;
-            break;
-          }
+        if (j >= 0) {
+          Container[j] = fo;
+          TrafficStore_Commit(j);
         }
       }
     }
@@ -417,36 +412,30 @@ void parseD1090(JsonObject root)
         int j;
 
         /* Try to find and update an entry with the same aircraft ID */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == fo.addr && Container[j].protocol == fo.protocol) {
+        j = TrafficStore_Find(fo.addr);
+        if (j >= 0) {
+          /* same ID already tracked via other means - leave that be */
+          if (Container[j].protocol == fo.protocol ||
+              timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
             Container[j] = fo;
-            break;
+            TrafficStore_Commit(j);
           }
-        }
-
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
+          continue;
         }
 
         /* Fill a free entry if able */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == 0 &&
-             memcmp(Container[j].raw, EmptyFO.raw, sizeof(EmptyFO.raw)) == 0) {
-            Container[j] = fo;
-            break;
-          }
-        }
+        j = TrafficStore_Alloc();
 
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
+        /* Overwrite expired entry */
+        if (j < 0) {
+          j = TrafficStore_Oldest();
+          if (j >= 0 && timestamp - Container[j].timestamp <= ENTRY_EXPIRATION_TIME)
+            j = -1;
         }
 
-        /* Overwrite expired entry */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
-            Container[j] = fo;
-            break;
-          }
+        if (j >= 0) {
+          Container[j] = fo;
+          TrafficStore_Commit(j);
         }
       }
     }
@@ -510,24 +499,19 @@ void parseRAW(JsonObject root)
         int j;
 
         /* Fill a free entry if able */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (Container[j].addr == 0 &&
-             memcmp(Container[j].raw, EmptyFO.raw, sizeof(EmptyFO.raw)) == 0) {
-            Container[j] = fo;
-            break;
-          }
-        }
+        j = TrafficStore_Alloc();
 
-        if (j < MAX_TRACKING_OBJECTS) {
-            continue;
+        /* Overwrite expired entry */
+        if (j < 0) {
+          j = TrafficStore_Oldest();
+          if (j >= 0 && timestamp - Container[j].timestamp <= ENTRY_EXPIRATION_TIME)
+            j = -1;
         }
 
-        /* Overwrite expired entry */
-        for (j=0; j < MAX_TRACKING_OBJECTS; j++) {
-          if (timestamp - Container[j].timestamp > ENTRY_EXPIRATION_TIME) {
-            Container[j] = fo;
-            break;
-          }
+        if (j >= 0) {
+          /* raw frames have no addr, but the slot stays in use until relayed */
+          Container[j] = fo;
+          TrafficStore_Commit(j);
         }
       }
     }
@@ -30,6 +30,10 @@
 #endif /* RASPBERRY_PI */
 
 #define JSON_BUFFER_SIZE  65536
+
+/* dump1090 traffic beyond these is dropped by parseD1090_stream() */
+#define D1090_MAX_RANGE     30000   /* m, twice ALARM_ZONE_NONE */
+#define D1090_MAX_ALT_DIFF  3000    /* m */
 #define isValidGPSDFix() (hasValidGPSDFix)
 
 enum
@@ -83,6 +87,7 @@ extern void parseTPV(JsonObject);
 extern void parseSettings(JsonObject);
 extern void parseUISettings(JsonObject);
 extern void parseD1090(JsonObject);
+extern bool parseD1090_stream(const char *);
 extern void parsePING(JsonObject);
 extern void parseRAW(JsonObject);
 extern byte getVal(char);
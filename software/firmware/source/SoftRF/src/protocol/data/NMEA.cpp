@@ -29,6 +29,9 @@
 #include "../../system/SoC.h"
 // which does #include "../../SoftRF.h"
 #include "../../system/Time.h"
+#include "../../system/Perf.h"
+#include "../../system/LinkQ.h"
+#include "../../system/NetIO.h"
 #include "../../driver/WiFi.h"
 #include "../../driver/EEPROM.h"
 #include "../../driver/RF.h"
@@ -178,7 +181,8 @@ const char *NMEA_CallSign_Prefix[] = {
 #define isTimeToPGRMZ() (millis() - PGRMZ_TimeMarker > 1000)
 unsigned long PGRMZ_TimeMarker = 0;
 
-extern uint32_t tx_packets_counter, rx_packets_counter;
+extern uint32_t tx_packets_counter, rx_packets_counter, rx_queue_drops;
+extern uint32_t rx_fec_frames;
 
 #if defined(ENABLE_AHRS)
 #include "../../driver/AHRSHelper.h"
@@ -578,6 +582,21 @@ void NMEA_Out(uint8_t dest, const char *buf, size_t size, bool nl)
         if (nl)
           WiFi_transmit_TCP("\n", 1);
       }
+#elif defined(RASPBERRY_PI)
+      if (nl) {
+        /* one enqueue: a client ring short of room drops all of it or none */
+        char line[NMEA_BUFFER_SIZE + 1];
+        size_t line_size = size;
+
+        if (size >= sizeof(line))
+          line_size = sizeof(line) - 1;
+        memcpy(line, buf, line_size);
+        line[line_size] = '\n';
+
+        NetIO_send(line, line_size + 1);
+      } else {
+        NetIO_send(buf, size);
+      }
 #endif
     }
     break;
@@ -1274,13 +1293,48 @@ if (settings->debug_flags) {
 
 #if !defined(EXCLUDE_SOFTRF_HEARTBEAT)
     snprintf_P(NMEABuffer, sizeof(NMEABuffer),
-            PSTR("$PSRFH,%06X,%d,%d,%d,%d,%d,%d*"),
+            PSTR("$PSRFH,%06X,%d,%d,%d,%d,%d,%d,%d,%d,%d*"),
             ThisAircraft.addr,settings->rf_protocol,
-            rx_packets_counter,tx_packets_counter,millis(),(int)(voltage*100),ESP.getFreeHeap());
+            rx_packets_counter,tx_packets_counter,millis(),(int)(voltage*100),ESP.getFreeHeap(),
+            rx_queue_drops,rx_fec_frames,rx_failed_frames);
     nmealen = NMEA_add_checksum();
     NMEA_Outs(settings->nmea_l, settings->nmea2_l, NMEABuffer, nmealen, false);
 #endif /* EXCLUDE_SOFTRF_HEARTBEAT */
 
+    /* runtime of the subsystems: count, min, avg, max us, histogram */
+    if (settings->nmea_d || settings->nmea2_d) {
+        for (int i=0; i < PERF_COUNT; i++) {
+            perf_stat_t *sp = &Perf[i];
+            if (sp->count == 0)
+                continue;
+            snprintf_P(NMEABuffer, sizeof(NMEABuffer),
+                PSTR("$PSRFP,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u*"),
+                Perf_name[i], (unsigned) sp->count, (unsigned) sp->min_us,
+                (unsigned) (sp->total_us / sp->count), (unsigned) sp->max_us,
+                (unsigned) sp->hist[0], (unsigned) sp->hist[1], (unsigned) sp->hist[2],
+                (unsigned) sp->hist[3], (unsigned) sp->hist[4], (unsigned) sp->hist[5],
+                (unsigned) sp->hist[6], (unsigned) sp->hist[7]);
+            nmealen = NMEA_add_checksum();
+            NMEA_Outs(settings->nmea_d, settings->nmea2_d, NMEABuffer, nmealen, false);
+        }
+
+        /* reception per sender: address, protocol, packets, FEC repaired, */
+        /* failed, missed, frames per 10 s, RSSI avg and max, slot, channel, age s */
+        for (int i=0; i < LINKQ_SIZE; i++) {
+            linkq_t *lp = &LinkQ[i];
+            if (lp->addr == 0)
+                continue;
+            snprintf_P(NMEABuffer, sizeof(NMEABuffer),
+                PSTR("$PSRFQ,%06X,%d,%u,%u,%u,%u,%u,%d,%d,%d,%d,%u*"),
+                (unsigned) lp->addr, lp->protocol, (unsigned) lp->packets,
+                (unsigned) lp->fixed, (unsigned) lp->failed, (unsigned) lp->missed,
+                LinkQ_rate(lp), lp->rssi_avg / 16, lp->rssi_max,
+                lp->slot, lp->chan, (unsigned) ((millis() - lp->last_ms) / 1000));
+            nmealen = NMEA_add_checksum();
+            NMEA_Outs(settings->nmea_d, settings->nmea2_d, NMEABuffer, nmealen, false);
+        }
+    }
+
     if (settings->debug_flags & DEBUG_DEEPER) {
         Serial.printf("ThisAircraft.baro_alt_diff = %.0f\r\n", ThisAircraft.baro_alt_diff);
         Serial.printf("OthAcfts Avg baro_alt_diff = %.0f\r\n", average_baro_alt_diff);
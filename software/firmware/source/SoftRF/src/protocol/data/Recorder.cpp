@@ -0,0 +1,273 @@
+/*
+ * Recorder.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <SD.h>
+
+// include this first, to get USE_SD_CARD
+#include "../../system/SoC.h"
+
+#if defined(USE_SD_CARD)
+
+#include "../../driver/EEPROM.h"
+#include "../../driver/GNSS.h"
+#include "../../ApproxMath.h"
+#include "../../Wind.h"
+#include "Recorder.h"
+
+static_assert(sizeof(rec_frame_t) == REC_FRAME_SIZE, "recorder frame size");
+
+bool RecorderOpen = false;
+
+static File RecFile;
+static rec_frame_t *rec_block[2] = {NULL, NULL};
+static int rec_active = 0;         // the block being filled
+static int rec_used = 0;           // frames in it
+static bool rec_full = false;      // the other block is waiting to be written
+static uint32_t rec_written_ms = 0;
+static uint32_t rec_dropped = 0;
+
+// what the decoder will have reconstructed so far
+static bool rec_need_key = true;
+static bool rec_have_key = false;
+static uint32_t key_ms = 0;        // millis() of the keyframe fix
+static int32_t last_lat = 0;       // 1e-7 degrees
+static int32_t last_lon = 0;
+
+static inline int16_t clamp16(float x)
+{
+    if (x > 32767.0f)   return 32767;
+    if (x < -32768.0f)  return -32768;
+    return (int16_t) x;
+}
+
+static inline int8_t clamp8(float x)
+{
+    if (x > 127.0f)   return 127;
+    if (x < -128.0f)  return -128;
+    return (int8_t) x;
+}
+
+static inline uint16_t angle100(float deg)
+{
+    if (deg < 0)
+        deg += 360.0f;
+    return (uint16_t) (deg * 100.0f);
+}
+
+// the next free frame, or NULL if both blocks are full
+static rec_frame_t *rec_next(uint8_t type, uint8_t info, uint32_t dt)
+{
+    if (rec_used >= REC_BLOCK_FRAMES) {
+        if (rec_full) {     // the SD card is not keeping up
+            ++rec_dropped;
+            return NULL;
+        }
+        rec_full = true;
+        rec_active ^= 1;
+        rec_used = 0;
+        rec_need_key = true;
+    }
+    rec_frame_t *fp = &rec_block[rec_active][rec_used++];
+    memset(fp, 0, sizeof(rec_frame_t));
+    fp->type = type;
+    fp->info = info;
+    fp->dt = (uint16_t) dt;
+    return fp;
+}
+
+static void rec_write(const rec_frame_t *buf, int frames)
+{
+    size_t size = frames * sizeof(rec_frame_t);
+    if (RecFile.write((const uint8_t *) buf, size) != size) {
+        // perhaps out of space on the SD card
+        Serial.println(F("Recorder: write failed, stopped"));
+        RecFile.close();
+        RecorderOpen = false;
+        return;
+    }
+    RecFile.flush();
+    rec_written_ms = millis();
+}
+
+// start a recording alongside the given IGC file
+void Recorder_open(const char *igcpath)
+{
+    if (RecorderOpen)
+        return;
+
+    if (rec_block[0] == NULL) {
+        size_t size = 2 * REC_BLOCK_FRAMES * sizeof(rec_frame_t);
+        rec_frame_t *p = (rec_frame_t *) (psramFound() ? ps_malloc(size) : malloc(size));
+        if (p == NULL) {
+            Serial.println(F("Not enough RAM for the recorder"));
+            return;
+        }
+        rec_block[0] = p;
+        rec_block[1] = p + REC_BLOCK_FRAMES;
+    }
+
+    char path[32];
+    strncpy(path, igcpath, sizeof(path)-1);
+    path[sizeof(path)-1] = '\0';
+    char *dot = strrchr(path, '.');
+    if (dot == NULL || (dot - path) + 4 >= (int) sizeof(path))
+        return;
+    strcpy(dot, ".SRB");
+
+    RecFile = SD.open(path, FILE_WRITE);
+    if (! RecFile) {
+        Serial.println(F("Failed to open the recorder file"));
+        return;
+    }
+    Serial.print(F("Recording to "));
+    Serial.println(path);
+
+    rec_active = 0;
+    rec_used = 0;
+    rec_full = false;
+    rec_dropped = 0;
+    rec_need_key = true;
+    rec_have_key = false;
+    rec_written_ms = millis();
+    RecorderOpen = true;
+
+    rec_frame_t *fp = rec_next(REC_HEADER, REC_VERSION, 0);
+    memcpy(fp->header.magic, "SRB1", 4);
+    fp->header.addr = ThisAircraft.addr;
+    fp->header.aircraft_type = ThisAircraft.aircraft_type;
+    fp->header.protocol = settings->rf_protocol;
+    fp->header.alarm = settings->alarm;
+}
+
+// called after each new GNSS fix
+void Recorder_own()
+{
+    if (! RecorderOpen)
+        return;
+
+    int32_t lat = (int32_t) (ThisAircraft.latitude * 1.0e7f);
+    int32_t lon = (int32_t) (ThisAircraft.longitude * 1.0e7f);
+    int32_t dlat = lat - last_lat;
+    int32_t dlon = lon - last_lon;
+    uint32_t ms = ThisAircraft.gnsstime_ms;
+
+    if (rec_need_key || ms - key_ms > REC_KEYFRAME_MS
+          || dlat != (int16_t) dlat || dlon != (int16_t) dlon) {
+        rec_frame_t *fp = rec_next(REC_KEY, 0, 0);
+        if (fp == NULL)
+            return;
+        fp->key.utc = ThisAircraft.timestamp;
+        fp->key.lat = lat;
+        fp->key.lon = lon;
+        fp->key.geoid = clamp16(ThisAircraft.geoid_separation);
+        key_ms = ms;
+        last_lat = lat;
+        last_lon = lon;
+        dlat = dlon = 0;
+        rec_need_key = false;
+        rec_have_key = true;
+    }
+
+    uint16_t hdop = ThisAircraft.hdop / 10;
+    rec_frame_t *fp = rec_next(REC_OWN, (hdop > 255 ? 255 : hdop), ms - key_ms);
+    if (fp == NULL)
+        return;
+    rec_own_t *op = &fp->own;
+    op->dlat = dlat;
+    op->dlon = dlon;
+    op->alt = clamp16(ThisAircraft.altitude);
+    op->palt = clamp16(ThisAircraft.pressure_altitude);
+    op->course = angle100(ThisAircraft.course);
+    op->heading = angle100(ThisAircraft.heading);
+    op->speed = (uint16_t) (ThisAircraft.speed * 10.0f);
+    op->vs = clamp16(ThisAircraft.vs);
+    op->turnrate = clamp16(ThisAircraft.turnrate * 10.0f);
+    op->wind_dir = (uint8_t) (angle100(wind_direction) / 200);
+    op->wind_speed = (uint8_t) (wind_speed * (1.0 / _GPS_MPS_PER_KNOT));
+    last_lat += dlat;
+    last_lon += dlon;
+}
+
+// a received packet (REC_PACKET) or an alarm decision (REC_ALARM, REC_NOTIFY)
+void Recorder_traffic(ufo_t *fop, uint8_t type, uint8_t info)
+{
+    if (! RecorderOpen || ! rec_have_key)
+        return;
+    uint32_t dt = millis() - key_ms;
+    if (dt > 0xFFFF)      // no own-ship fix for a minute
+        return;
+
+    rec_frame_t *fp = rec_next(type, info, dt);
+    if (fp == NULL)
+        return;
+    rec_traffic_t *tp = &fp->traffic;
+    uint32_t addr = (fop->no_track ? 0xAAAAAA : fop->addr);
+    tp->addr[0] = addr;
+    tp->addr[1] = addr >> 8;
+    tp->addr[2] = addr >> 16;
+    tp->aircraft_type = fop->aircraft_type;
+    tp->protocol = fop->protocol;
+    tp->flags = (fop->no_track ? REC_NO_TRACK : 0)
+              | (fop->stealth  ? REC_STEALTH  : 0)
+              | (fop->relayed  ? REC_RELAYED  : 0)
+              | (fop->airborne ? REC_AIRBORNE : 0);
+    // relative to own-ship now, not to the last recorded fix
+    float dy = (fop->latitude - ThisAircraft.latitude) * 111300.0f;
+    float dx = (fop->longitude - ThisAircraft.longitude) * 111300.0f
+                  * CosLat(ThisAircraft.latitude);
+    tp->dx = clamp16(dx);
+    tp->dy = clamp16(dy);
+    tp->dz = clamp16(fop->altitude - ThisAircraft.altitude);
+    tp->speed = (uint16_t) (fop->speed * 10.0f);
+    tp->course = angle100(fop->course);
+    tp->vs = clamp16(fop->vs);
+    tp->turnrate = clamp8(fop->turnrate);
+    tp->rssi = fop->rssi;
+}
+
+// called from loop(), writes out what has filled up
+void Recorder_loop()
+{
+    if (! RecorderOpen)
+        return;
+    if (rec_full) {
+        rec_write(rec_block[rec_active ^ 1], REC_BLOCK_FRAMES);
+        rec_full = false;
+    } else if (rec_used > 0 && millis() - rec_written_ms > REC_FLUSH_MS) {
+        rec_write(rec_block[rec_active], rec_used);
+        rec_used = 0;
+        rec_need_key = true;
+    }
+}
+
+void Recorder_close()
+{
+    if (! RecorderOpen)
+        return;
+    if (rec_full)
+        rec_write(rec_block[rec_active ^ 1], REC_BLOCK_FRAMES);
+    if (RecorderOpen && rec_used > 0)
+        rec_write(rec_block[rec_active], rec_used);
+    if (RecorderOpen)
+        RecFile.close();
+    RecorderOpen = false;
+    if (rec_dropped)
+        Serial.printf("Recorder: %u frames dropped\r\n", rec_dropped);
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Recorder.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#if defined(USE_SD_CARD)
+
+/*
+ * Binary flight recorder, written next to the IGC file (same name, .SRB)
+ * while logging with traffic.  Every GNSS fix, received packet and alarm
+ * evaluation is one fixed-size little-endian frame.  Frame times are in ms
+ * since the last own-ship keyframe, and own-ship positions are deltas from
+ * the previous own-ship frame.  A keyframe starts every block written and
+ * follows at least every REC_KEYFRAME_MS.
+ *
+ * software/utils/srb2igc.py converts the file to IGC and CSV.
+ */
+
+#define REC_VERSION         1
+#define REC_FRAME_SIZE      24
+#define REC_BLOCK_FRAMES    170     /* 4080 bytes per write to the SD card */
+#define REC_KEYFRAME_MS     10000
+#define REC_FLUSH_MS        60000   /* write a partial block after this long */
+
+enum {
+  REC_HEADER = 'H',     /* once, at the start of the file */
+  REC_KEY    = 'K',     /* own-ship time and absolute position */
+  REC_OWN    = 'O',     /* own-ship state, position relative to the last one */
+  REC_PACKET = 'P',     /* a received packet, as decoded */
+  REC_ALARM  = 'A',     /* a target evaluated at an alarm level above NONE */
+  REC_NOTIFY = 'N'      /* an alarm was sounded for this target */
+};
+
+/* rec_traffic_t flags */
+#define REC_NO_TRACK        0x01
+#define REC_STEALTH         0x02
+#define REC_RELAYED         0x04
+#define REC_AIRBORNE        0x08
+
+typedef struct __attribute__((packed)) rec_header_struct {
+  char      magic[4];       /* "SRB1" */
+  uint32_t  addr;
+  uint8_t   aircraft_type;
+  uint8_t   protocol;
+  uint8_t   alarm;          /* settings->alarm */
+  uint8_t   reserved[9];
+} rec_header_t;
+
+typedef struct __attribute__((packed)) rec_key_struct {
+  uint32_t  utc;            /* unix time of the fix */
+  int32_t   lat;            /* 1e-7 degrees */
+  int32_t   lon;
+  int16_t   geoid;          /* meters */
+  uint8_t   reserved[6];
+} rec_key_t;
+
+typedef struct __attribute__((packed)) rec_own_struct {
+  int16_t   dlat;           /* 1e-7 degrees since the previous K or O frame */
+  int16_t   dlon;
+  int16_t   alt;            /* meters, GNSS */
+  int16_t   palt;           /* meters, pressure altitude */
+  uint16_t  course;         /* 0.01 degrees */
+  uint16_t  heading;
+  uint16_t  speed;          /* 0.1 knots */
+  int16_t   vs;             /* feet per minute */
+  int16_t   turnrate;       /* 0.1 degrees per second */
+  uint8_t   wind_dir;       /* 2 degrees */
+  uint8_t   wind_speed;     /* knots */
+} rec_own_t;
+
+typedef struct __attribute__((packed)) rec_traffic_struct {
+  uint8_t   addr[3];        /* little-endian, 0xAAAAAA if no_track */
+  uint8_t   aircraft_type;
+  uint8_t   protocol;
+  uint8_t   flags;
+  int16_t   dx;             /* meters east of own-ship */
+  int16_t   dy;             /* meters north */
+  int16_t   dz;             /* meters above */
+  uint16_t  speed;          /* 0.1 knots */
+  uint16_t  course;         /* 0.01 degrees */
+  int16_t   vs;             /* feet per minute */
+  int8_t    turnrate;       /* degrees per second */
+  int8_t    rssi;
+} rec_traffic_t;
+
+typedef struct __attribute__((packed)) rec_frame_struct {
+  uint8_t   type;
+  uint8_t   info;           /* H: version, O: hdop/10, P/A: alarm level,
+                               N: alarm level + 16 * count */
+  uint16_t  dt;             /* ms since the last keyframe */
+  union {
+    rec_header_t  header;
+    rec_key_t     key;
+    rec_own_t     own;
+    rec_traffic_t traffic;
+  };
+} rec_frame_t;
+
+void Recorder_open(const char *igcpath);
+void Recorder_own();
+void Recorder_traffic(ufo_t *fop, uint8_t type, uint8_t info);
+void Recorder_loop();
+void Recorder_close();
+
+extern bool RecorderOpen;
+
+#endif
+
+#endif
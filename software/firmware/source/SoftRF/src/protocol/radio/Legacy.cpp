@@ -26,6 +26,7 @@
 
 #include "../../../SoftRF.h"
 #include "../../TrafficHelper.h"
+#include "../../TrafficStore.h"
 #include "../../Wind.h"
 #include "../../ApproxMath.h"
 #include "../../system/Time.h"
@@ -177,6 +178,36 @@ void make_key(uint32_t key[4], uint32_t timestamp, uint32_t address) {
     }
 }
 
+/*
+ * make_key() only depends on (timestamp >> 6) and the address, so each
+ * sender's key is kept - by traffic slot - for the rest of its 64-second window
+ */
+typedef struct legacy_key_struct {
+    bool     valid;
+    uint32_t addr;
+    uint32_t window;
+    uint32_t key[4];
+} legacy_key_t;
+
+static legacy_key_t legacy_keys[MAX_TRACKING_OBJECTS];
+static legacy_key_t own_key;
+
+static void cached_key(legacy_key_t *kp, uint32_t key[4], uint32_t timestamp, uint32_t addr)
+{
+    uint32_t window = (timestamp >> 6);
+    if (kp && kp->valid && kp->addr == addr && kp->window == window) {
+        memcpy(key, kp->key, sizeof(kp->key));
+        return;
+    }
+    make_key(key, timestamp, (addr << 8) & 0xffffff);
+    if (kp) {
+        kp->valid  = true;
+        kp->addr   = addr;
+        kp->window = window;
+        memcpy(kp->key, key, sizeof(kp->key));
+    }
+}
+
 // lookup the divisor for latitude for new protocol
 int londiv(int ilat)
 {
@@ -254,7 +285,7 @@ bool latest_decode(void* buffer, ufo_t* this_aircraft, ufo_t* fop)
 {
     //uint32_t timestamp = (uint32_t) this_aircraft->timestamp;
     //uint32_t timestamp = (uint32_t) OurTime;
-    uint32_t timestamp = (uint32_t) RF_time;   // incremented in RF.cpp 300 ms after PPS
+    uint32_t timestamp = (uint32_t) RF_last_time;   // RF_time when the frame was received
 
 #if 0
     if (settings->nmea_d || settings->nmea2_d) {
@@ -439,20 +470,18 @@ bool legacy_decode(void *buffer, ufo_t *this_aircraft, ufo_t *fop) {
     if (fop->addr == ThisAircraft.addr)
          return false;                 /* same ID as this aircraft - ignore */
 
-    for (int i=0; i < MAX_TRACKING_OBJECTS; i++) {
-      if (Container[i].addr == fop->addr) {
+    int i = TrafficStore_Find(fop->addr);
+    if (i >= 0) {
         if (RF_last_crc != 0 && RF_last_crc == Container[i].last_crc) {
           //Serial.println("duplicate packet");      // usually duplicated in 2nd time slot
           return false;
-          //break;
         }
-      }
     }
     fop->last_crc = RF_last_crc;
 
     //uint32_t timestamp = (uint32_t) this_aircraft->timestamp;
     //uint32_t timestamp = (uint32_t) OurTime;
-    uint32_t timestamp = (uint32_t) RF_time;   // incremented in RF.cpp 300 ms after PPS
+    uint32_t timestamp = (uint32_t) RF_last_time;   // RF_time when the frame was received
     fop->timestamp = timestamp;
     fop->gnsstime_ms = millis();
 
@@ -479,7 +508,7 @@ bool legacy_decode(void *buffer, ufo_t *this_aircraft, ufo_t *fop) {
     int ndx;
     uint8_t pkt_parity=0;
 
-    make_key(key, timestamp, (pkt->addr << 8) & 0xffffff);
+    cached_key((i >= 0 ? &legacy_keys[i] : NULL), key, timestamp, pkt->addr);
     btea((uint32_t *) pkt + 1, -5, key);
 
     for (ndx = 0; ndx < sizeof (legacy_packet_t); ndx++) {
@@ -922,7 +951,12 @@ size_t legacy_encode(void *pkt_buffer, ufo_t *aircraft)
     //uint32_t timestamp = (uint32_t) aircraft->timestamp;
     uint32_t timestamp = (uint32_t) RF_time;   // incremented in RF.cpp 300 ms after PPS
 
-    make_key(key, timestamp , (pkt->addr << 8) & 0xffffff);
+    if (relay) {
+        int i = TrafficStore_Find(aircraft->addr);
+        cached_key((i >= 0 ? &legacy_keys[i] : NULL), key, timestamp, pkt->addr);
+    } else {
+        cached_key(&own_key, key, timestamp, pkt->addr);
+    }
     btea((uint32_t *) pkt + 1, 5, key);
 
     return (sizeof(legacy_packet_t));
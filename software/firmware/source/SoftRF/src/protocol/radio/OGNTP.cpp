@@ -210,3 +210,56 @@ size_t ogntp_encode(void *pkt, ufo_t *this_aircraft) {
   memcpy((void *) pkt,  ogn_tx_pkt.Byte(), ogn_tx_pkt.Bytes);
   return (ogn_tx_pkt.Bytes);
 }
+
+#if !defined(__AVR__)
+static LDPC_Decoder ogntp_ldpc;  /* only ever used by the receiving context */
+#endif
+
+/*
+ * Recover an OGNTP frame, 20 data and 6 parity bytes, that fails the
+ * parity checks.  err marks the bits a software Manchester decoder found
+ * invalid, NULL where the radio decodes Manchester itself.  Returns the
+ * number of bits corrected in place, or -1 if the frame is lost.
+ */
+int ogntp_ldpc_correct(uint8_t *frame, const uint8_t *err)
+{
+#if !defined(__AVR__)
+  static const uint8_t no_err[LDPC_Decoder::CodeBytes] = { 0 };
+  uint8_t out[LDPC_Decoder::CodeBytes];
+  int fixed = 0, flips = 0, erased = 0;
+  int iter;
+
+  if (err == NULL)
+    err = no_err;
+
+  for (int i = 0; i < LDPC_Decoder::CodeBytes; i++)
+    erased += Count1s(err[i]);
+  if (erased > OGNTP_LDPC_MAX_COST)
+    return -1;                  /* noise, most likely */
+
+  ogntp_ldpc.Input(frame, (uint8_t *) err);
+  for (iter = 0; iter < OGNTP_LDPC_ITER; iter++) {
+    if (ogntp_ldpc.ProcessChecks() == 0)
+      break;
+  }
+  if (iter == OGNTP_LDPC_ITER)
+    return -1;
+
+  ogntp_ldpc.Output(out);
+  if (LDPC_Check(out) != 0)
+    return -1;
+
+  for (int i = 0; i < LDPC_Decoder::CodeBytes; i++) {
+    uint8_t diff = out[i] ^ frame[i];
+    fixed += Count1s(diff);
+    flips += Count1s((uint8_t) (diff & ~err[i]));
+  }
+  if (erased + 4 * flips > OGNTP_LDPC_MAX_COST)
+    return -1;
+
+  memcpy(frame, out, sizeof(out));
+  return fixed;
+#else
+  return -1;
+#endif /* __AVR__ */
+}
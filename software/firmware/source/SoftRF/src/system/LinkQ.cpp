@@ -0,0 +1,132 @@
+/*
+ * LinkQ.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SoC.h"
+#include "LinkQ.h"
+#include "../driver/RF.h"
+
+linkq_t  LinkQ[LINKQ_SIZE];
+uint32_t LinkQ_unknown = 0;
+
+void LinkQ_setup()
+{
+  LinkQ_reset();
+}
+
+void LinkQ_reset()
+{
+  memset(LinkQ, 0, sizeof(LinkQ));
+  LinkQ_unknown = 0;
+}
+
+static linkq_t *LinkQ_find(uint32_t addr)
+{
+  for (int i=0; i < LINKQ_SIZE; i++) {
+    if (LinkQ[i].addr == addr)
+      return &LinkQ[i];
+  }
+  return NULL;
+}
+
+/* a free entry, else the one heard from least recently */
+static linkq_t *LinkQ_new(uint32_t addr)
+{
+  linkq_t *lp = &LinkQ[0];
+
+  for (int i=0; i < LINKQ_SIZE; i++) {
+    if (LinkQ[i].addr == 0) {
+      lp = &LinkQ[i];
+      break;
+    }
+    if ((int32_t) (LinkQ[i].last_ms - lp->last_ms) < 0)
+      lp = &LinkQ[i];
+  }
+
+  memset(lp, 0, sizeof(linkq_t));
+  lp->addr     = addr;
+  lp->first_ms = RF_last_ms;
+  lp->rssi_max = -128;
+  return lp;
+}
+
+/*
+ * The frame ParseFrame() just decoded into fop, with the RF_last_* of its
+ * reception.  Relayed frames are left out, their RSSI is the relayer's.
+ */
+void LinkQ_Packet(ufo_t *fop)
+{
+  if (fop->addr == 0 || fop->relayed)
+    return;
+
+  linkq_t *lp = LinkQ_find(fop->addr);
+  if (lp == NULL)
+    lp = LinkQ_new(fop->addr);
+
+  int16_t rssi = RF_last_rssi * 16;
+
+  if (lp->packets == 0) {
+    lp->rssi_avg = rssi;
+  } else {
+    uint32_t dt = RF_last_ms - lp->last_ms;
+
+    lp->rssi_avg += (rssi - lp->rssi_avg) / 8;
+    if (dt < LINKQ_GAP_MS) {
+      uint16_t mid = RF_Tx_Interval();
+      uint16_t gap = RF_Tx_Gap_Max();
+
+      if (lp->interval_ms == 0)
+        lp->interval_ms = dt;
+      else
+        lp->interval_ms += ((int32_t) dt - lp->interval_ms) / 8;
+      /* the gaps of a clean link run up to gap, each mid past it is a miss */
+      if (mid > 0 && dt > gap)
+        lp->missed += 1 + (dt - gap) / mid;
+    }
+  }
+  if (RF_last_rssi > lp->rssi_max)
+    lp->rssi_max = RF_last_rssi;
+
+  lp->protocol = fop->protocol;
+  lp->slot     = RF_last_slot;
+  lp->chan     = RF_last_chan;
+  lp->last_ms  = RF_last_ms;
+  lp->packets++;
+  if (RF_last_fixed > 0)
+    lp->fixed++;
+}
+
+/*
+ * A frame dropped on the CRC or the FEC, with the address its header
+ * would have had, 0 if the protocol has no plain one.  That can be
+ * damaged as well, so only senders already in the table are charged.
+ */
+void LinkQ_Failed(uint32_t addr)
+{
+  linkq_t *lp = (addr == 0 ? NULL : LinkQ_find(addr));
+
+  if (lp != NULL)
+    lp->failed++;
+  else
+    LinkQ_unknown++;
+}
+
+/* frames per 10 seconds, from the average interval */
+uint16_t LinkQ_rate(const linkq_t *lp)
+{
+  return lp->interval_ms ? (10000 + lp->interval_ms / 2) / lp->interval_ms : 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * LinkQ.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINKQ_H
+#define LINKQ_H
+
+/*
+ * Reception quality per sender, kept for as long as there is room in the
+ * table - well past the expiry of the traffic entry - so that antennas and
+ * installations can be compared.  Updated by ParseData() with every frame
+ * decoded, and by RF_Receive() with the frames the drivers dropped on the
+ * CRC or the FEC.  Reported by $PSRFQ and on /linkq.
+ */
+
+#if !defined(LINKQ_SIZE)
+#if defined(RASPBERRY_PI)
+#define LINKQ_SIZE      64
+#elif defined(__AVR__)
+#define LINKQ_SIZE      4
+#else
+#define LINKQ_SIZE      16
+#endif
+#endif /* LINKQ_SIZE */
+
+#define LINKQ_GAP_MS    30000           /* longer silences start afresh */
+
+typedef struct linkq_struct {
+  uint32_t  addr;               /* 0 while the entry is free */
+  uint8_t   protocol;
+  uint8_t   slot;               /* of the last frame */
+  uint8_t   chan;
+  int8_t    rssi_max;
+  int16_t   rssi_avg;           /* dBm * 16, EWMA over 8 frames */
+  uint16_t  interval_ms;        /* between frames, EWMA over 8 */
+  uint32_t  packets;
+  uint32_t  fixed;              /* of those, repaired by the FEC */
+  uint32_t  failed;             /* dropped on the CRC or the FEC */
+  uint32_t  missed;             /* from gaps over RF_Tx_Gap_Max() */
+  uint32_t  first_ms;
+  uint32_t  last_ms;
+} linkq_t;
+
+extern linkq_t  LinkQ[LINKQ_SIZE];
+extern uint32_t LinkQ_unknown;  /* failed frames of no sender in the table */
+
+void     LinkQ_setup(void);
+void     LinkQ_reset(void);
+void     LinkQ_Packet(ufo_t *);
+void     LinkQ_Failed(uint32_t);
+uint16_t LinkQ_rate(const linkq_t *);
+
+#endif /* LINKQ_H */
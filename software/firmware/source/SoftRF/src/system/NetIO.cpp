@@ -0,0 +1,710 @@
+/*
+ * NetIO.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(RASPBERRY_PI)
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "SoC.h"
+#include "NetIO.h"
+
+enum {                          /* slot state, handed over with __atomic */
+  NETIO_FREE,
+  NETIO_OPEN,
+  NETIO_CLOSED                  /* output client, until the main loop lets go */
+};
+
+enum {
+  NETIO_LISTENER,
+  NETIO_STREAM,                 /* accepted TCP connection */
+  NETIO_DGRAM,
+  NETIO_PEER                    /* NetIO_connect(), kept connected */
+};
+
+typedef struct netio_conn_struct {
+  int         fd;
+  uint8_t     type;
+  uint8_t     role;
+  uint8_t     state;
+  bool        connecting;
+  bool        out_armed;        /* waiting for EPOLLOUT */
+
+  /* framing of the input, a JSON object or a line */
+  uint32_t    in_len;
+  int         depth;
+  bool        in_string;
+  bool        escape;
+  bool        overrun;          /* skipping to the next newline or '{' */
+
+  /* output ring: head moved by the main loop, tail by the thread */
+  uint32_t    out_head;
+  uint32_t    out_tail;
+
+  /* NETIO_PEER */
+  struct sockaddr_in peer;
+  char       *hello;
+  uint32_t    retry_ms;
+} netio_conn_t;
+
+netio_stats_t NetIO_stats;
+
+static netio_conn_t netio_conn[NETIO_MAX_CONN];
+static char netio_in [NETIO_MAX_CONN][NETIO_MSG_MAX];
+static char netio_out[NETIO_MAX_CONN][NETIO_TX_RING];
+
+/* messages to the main loop, each behind a length | role << 24 word */
+static char     netio_rx[NETIO_RX_RING];
+static uint32_t netio_rx_head = 0;          /* the thread */
+static uint32_t netio_rx_tail = 0;          /* the main loop */
+
+static int       netio_epfd = -1;
+static int       netio_evfd = -1;           /* wakes the thread */
+static int       netio_udp  = -1;           /* NetIO_sendto() */
+static pthread_t netio_thread;
+static bool      netio_running = false;
+static volatile bool netio_stop = false;
+
+static void ring_put(char *ring, uint32_t size, uint32_t pos,
+                     const void *src, uint32_t len)
+{
+  uint32_t off   = pos & (size - 1);
+  uint32_t first = (len < size - off) ? len : size - off;
+
+  memcpy(ring + off, src, first);
+  memcpy(ring, (const char *) src + first, len - first);
+}
+
+static void ring_get(const char *ring, uint32_t size, uint32_t pos,
+                     void *dst, uint32_t len)
+{
+  uint32_t off   = pos & (size - 1);
+  uint32_t first = (len < size - off) ? len : size - off;
+
+  memcpy(dst, ring + off, first);
+  memcpy((char *) dst + first, ring, len - first);
+}
+
+static inline int netio_index(netio_conn_t *cp)
+{
+  return cp - netio_conn;
+}
+
+static void netio_wake()
+{
+  uint64_t one = 1;
+  if (write(netio_evfd, &one, sizeof(one)) < 0) { /* already pending */ }
+}
+
+/* in the thread */
+static void netio_push(uint8_t role, const char *msg, uint32_t len)
+{
+  while (len > 0 && (msg[len-1] == '\n' || msg[len-1] == '\r'))
+    --len;
+  if (len == 0)
+    return;
+
+  uint32_t head = netio_rx_head;
+  uint32_t tail = __atomic_load_n(&netio_rx_tail, __ATOMIC_ACQUIRE);
+
+  if (NETIO_RX_RING - (head - tail) < len + sizeof(uint32_t)) {
+    ++NetIO_stats.rx_dropped;
+    return;
+  }
+
+  uint32_t hdr = len | ((uint32_t) role << 24);
+  ring_put(netio_rx, NETIO_RX_RING, head, &hdr, sizeof(hdr));
+  ring_put(netio_rx, NETIO_RX_RING, head + sizeof(hdr), msg, len);
+  __atomic_store_n(&netio_rx_head, head + sizeof(hdr) + len, __ATOMIC_RELEASE);
+
+  ++NetIO_stats.rx_msgs;
+}
+
+static void netio_frame_reset(netio_conn_t *cp)
+{
+  cp->in_len    = 0;
+  cp->depth     = 0;
+  cp->in_string = false;
+  cp->escape    = false;
+  cp->overrun   = false;
+}
+
+/*
+ * a message ends with the brace that closes a JSON object, or a newline.
+ * One that outgrows NETIO_MSG_MAX is dropped, and the framing resyncs at
+ * the next newline or '{', so an unbalanced brace costs only itself.
+ */
+static void netio_frame(netio_conn_t *cp, const char *data, size_t size)
+{
+  char *in = netio_in[netio_index(cp)];
+
+  for (size_t i = 0; i < size; i++) {
+    char c = data[i];
+    bool end = false;
+
+    if (cp->in_len == NETIO_MSG_MAX) {
+      ++NetIO_stats.rx_dropped;
+      netio_frame_reset(cp);
+      cp->overrun = true;
+    }
+
+    if (cp->overrun) {
+      if (c != '\n' && c != '{')
+        continue;
+      cp->overrun = false;
+    }
+
+    if (cp->in_len == 0 && cp->depth == 0 &&
+        (c == '\n' || c == '\r' || c == ' ' || c == '\t'))
+      continue;
+
+    in[cp->in_len++] = c;
+
+    if (cp->in_string) {
+      if (cp->escape)
+        cp->escape = false;
+      else if (c == '\\')
+        cp->escape = true;
+      else if (c == '"')
+        cp->in_string = false;
+    } else if (c == '"' && cp->depth > 0) {
+      cp->in_string = true;
+    } else if (c == '{' || c == '[') {
+      cp->depth++;
+    } else if ((c == '}' || c == ']') && cp->depth > 0) {
+      end = (--cp->depth == 0);
+    } else if (c == '\n' && cp->depth == 0) {
+      end = true;
+    }
+
+    if (end) {
+      netio_push(cp->role, in, cp->in_len);
+      netio_frame_reset(cp);
+    }
+  }
+}
+
+static netio_conn_t *netio_slot()
+{
+  for (int i = 0; i < NETIO_MAX_CONN; i++) {
+    if (__atomic_load_n(&netio_conn[i].state, __ATOMIC_ACQUIRE) == NETIO_FREE)
+      return &netio_conn[i];
+  }
+  return NULL;
+}
+
+static bool netio_open(netio_conn_t *cp, int fd, uint8_t type, uint8_t role)
+{
+  struct epoll_event ev;
+
+  cp->fd         = fd;
+  cp->type       = type;
+  cp->role       = role;
+  cp->connecting = false;
+  cp->out_armed  = false;
+  cp->out_head   = 0;
+  cp->out_tail   = 0;
+  netio_frame_reset(cp);
+
+  ev.events   = EPOLLIN;
+  ev.data.ptr = cp;
+  if (epoll_ctl(netio_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    close(fd);
+    cp->fd = -1;
+    return false;
+  }
+
+  if (type == NETIO_STREAM && role == NETIO_ROLE_OUTPUT)
+    ++NetIO_stats.clients;
+
+  __atomic_store_n(&cp->state, NETIO_OPEN, __ATOMIC_RELEASE);
+  return true;
+}
+
+static void netio_close(netio_conn_t *cp)
+{
+  epoll_ctl(netio_epfd, EPOLL_CTL_DEL, cp->fd, NULL);
+  close(cp->fd);
+  cp->fd = -1;
+
+  if (cp->type == NETIO_PEER) {
+    cp->connecting = false;
+    cp->retry_ms   = millis() + NETIO_RETRY_MS;
+  } else if (cp->role == NETIO_ROLE_OUTPUT) {
+    --NetIO_stats.clients;
+    __atomic_store_n(&cp->state, NETIO_CLOSED, __ATOMIC_RELEASE);
+  } else {
+    __atomic_store_n(&cp->state, NETIO_FREE, __ATOMIC_RELEASE);
+  }
+}
+
+static void netio_arm(netio_conn_t *cp, bool out)
+{
+  struct epoll_event ev;
+
+  ev.events   = (uint32_t) EPOLLIN | (out ? (uint32_t) EPOLLOUT : 0);
+  ev.data.ptr = cp;
+  epoll_ctl(netio_epfd, EPOLL_CTL_MOD, cp->fd, &ev);
+  cp->out_armed = out;
+}
+
+/* write what the main loop has queued, until the socket is full */
+static void netio_drain(netio_conn_t *cp)
+{
+  char *out = netio_out[netio_index(cp)];
+
+  for (;;) {
+    uint32_t head = __atomic_load_n(&cp->out_head, __ATOMIC_SEQ_CST);
+    uint32_t tail = cp->out_tail;
+
+    if (head == tail) {
+      if (cp->out_armed)
+        netio_arm(cp, false);
+      return;
+    }
+
+    uint32_t off = tail & (NETIO_TX_RING - 1);
+    uint32_t len = head - tail;
+    if (len > NETIO_TX_RING - off)
+      len = NETIO_TX_RING - off;
+
+    ssize_t n = send(cp->fd, out + off, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (!cp->out_armed)
+          netio_arm(cp, true);
+      } else if (errno != EINTR) {
+        netio_close(cp);
+      }
+      return;
+    }
+    __atomic_store_n(&cp->out_tail, tail + n, __ATOMIC_SEQ_CST);
+  }
+}
+
+static void netio_accept(netio_conn_t *lp)
+{
+  for (;;) {
+    int fd = accept4(lp->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+
+    netio_conn_t *cp = netio_slot();
+    if (cp == NULL) {
+      close(fd);
+      continue;
+    }
+    if (lp->role == NETIO_ROLE_OUTPUT) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (netio_open(cp, fd, NETIO_STREAM, lp->role))
+      ++NetIO_stats.accepted;
+  }
+}
+
+static void netio_recv(netio_conn_t *cp)
+{
+  char buf[4096];
+
+  for (;;) {
+    ssize_t n = recv(cp->fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n > 0) {
+      /* output clients may talk, nobody listens */
+      if (cp->role != NETIO_ROLE_OUTPUT)
+        netio_frame(cp, buf, n);
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      return;
+    netio_close(cp);
+    return;
+  }
+}
+
+static void netio_recv_dgram(netio_conn_t *cp)
+{
+  char *in = netio_in[netio_index(cp)];
+
+  for (;;) {
+    ssize_t n = recv(cp->fd, in, NETIO_MSG_MAX, MSG_DONTWAIT | MSG_TRUNC);
+    if (n < 0)
+      return;
+    if (n > NETIO_MSG_MAX)
+      ++NetIO_stats.rx_dropped;
+    else
+      netio_push(cp->role, in, n);
+  }
+}
+
+static void netio_dial(netio_conn_t *cp)
+{
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  struct epoll_event ev;
+
+  cp->retry_ms = millis() + NETIO_RETRY_MS;
+  if (fd < 0)
+    return;
+
+  if (connect(fd, (struct sockaddr *) &cp->peer, sizeof(cp->peer)) < 0 &&
+      errno != EINPROGRESS) {
+    close(fd);
+    return;
+  }
+
+  cp->fd         = fd;
+  cp->connecting = true;
+  netio_frame_reset(cp);
+
+  ev.events   = EPOLLIN | EPOLLOUT;
+  ev.data.ptr = cp;
+  if (epoll_ctl(netio_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    close(fd);
+    cp->fd = -1;
+    cp->connecting = false;
+  }
+}
+
+static void netio_connected(netio_conn_t *cp)
+{
+  int err = 0;
+  socklen_t len = sizeof(err);
+
+  if (getsockopt(cp->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+    netio_close(cp);
+    return;
+  }
+  cp->connecting = false;
+  netio_arm(cp, false);
+
+  if (cp->hello != NULL &&
+      send(cp->fd, cp->hello, strlen(cp->hello), MSG_NOSIGNAL) < 0)
+    netio_close(cp);
+}
+
+/* reconnects, and how long epoll_wait() may sleep until the next one */
+static int netio_retry()
+{
+  int timeout = -1;
+
+  for (int i = 0; i < NETIO_MAX_CONN; i++) {
+    netio_conn_t *cp = &netio_conn[i];
+
+    if (cp->type != NETIO_PEER || cp->state != NETIO_OPEN || cp->fd >= 0)
+      continue;
+
+    int32_t left = (int32_t) (cp->retry_ms - millis());
+    if (left <= 0) {
+      netio_dial(cp);
+      left = NETIO_RETRY_MS;
+      if (cp->fd >= 0)
+        continue;
+    }
+    if (timeout < 0 || left < timeout)
+      timeout = left;
+  }
+  return timeout;
+}
+
+static void *netio_loop(void *arg)
+{
+  struct epoll_event ev[NETIO_MAX_CONN];
+
+  (void) arg;
+
+  while (!netio_stop) {
+    int n = epoll_wait(netio_epfd, ev, NETIO_MAX_CONN, netio_retry());
+
+    for (int i = 0; i < n; i++) {
+      netio_conn_t *cp = (netio_conn_t *) ev[i].data.ptr;
+      uint32_t events = ev[i].events;
+
+      if (cp == NULL) {
+        uint64_t count;
+        if (read(netio_evfd, &count, sizeof(count)) < 0) { /* nothing */ }
+
+        for (int j = 0; j < NETIO_MAX_CONN; j++) {
+          netio_conn_t *op = &netio_conn[j];
+          if (op->type == NETIO_STREAM && op->role == NETIO_ROLE_OUTPUT &&
+              op->state == NETIO_OPEN && !op->out_armed)
+            netio_drain(op);
+        }
+        continue;
+      }
+
+      switch (cp->type)
+      {
+      case NETIO_LISTENER:
+        netio_accept(cp);
+        break;
+      case NETIO_DGRAM:
+        netio_recv_dgram(cp);
+        break;
+      case NETIO_PEER:
+        if (cp->connecting) {
+          netio_connected(cp);
+          break;
+        }
+        /* FALLTHROUGH */
+      case NETIO_STREAM:
+      default:
+        if (events & EPOLLOUT)
+          netio_drain(cp);
+        if (cp->fd >= 0 && (events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+          netio_recv(cp);
+        break;
+      }
+    }
+  }
+  return NULL;
+}
+
+/* output clients the thread has closed go back to the pool */
+static void netio_reclaim()
+{
+  for (int i = 0; i < NETIO_MAX_CONN; i++) {
+    if (__atomic_load_n(&netio_conn[i].state, __ATOMIC_ACQUIRE) == NETIO_CLOSED)
+      __atomic_store_n(&netio_conn[i].state, NETIO_FREE, __ATOMIC_RELEASE);
+  }
+}
+
+static int netio_socket(int type, uint16_t port)
+{
+  int fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int one = 1;
+  struct sockaddr_in addr;
+
+  if (fd < 0)
+    return -1;
+
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(port);
+
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      (type == SOCK_STREAM && listen(fd, 8) < 0)) {
+    fprintf(stderr, "NetIO: port %u: %s\n", port, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool NetIO_setup()
+{
+  struct epoll_event ev;
+  int one = 1;
+
+  for (int i = 0; i < NETIO_MAX_CONN; i++) {
+    netio_conn[i].fd    = -1;
+    netio_conn[i].state = NETIO_FREE;
+  }
+  memset(&NetIO_stats, 0, sizeof(NetIO_stats));
+
+  netio_epfd = epoll_create1(EPOLL_CLOEXEC);
+  netio_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (netio_epfd < 0 || netio_evfd < 0)
+    return false;
+
+  ev.events   = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(netio_epfd, EPOLL_CTL_ADD, netio_evfd, &ev) < 0)
+    return false;
+
+  netio_udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (netio_udp >= 0)
+    setsockopt(netio_udp, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+
+  return true;
+}
+
+bool NetIO_listen(uint16_t port, uint8_t role)
+{
+  netio_conn_t *cp = netio_slot();
+  int fd;
+
+  if (cp == NULL || (fd = netio_socket(SOCK_STREAM, port)) < 0)
+    return false;
+  return netio_open(cp, fd, NETIO_LISTENER, role);
+}
+
+bool NetIO_bind_udp(uint16_t port, uint8_t role)
+{
+  netio_conn_t *cp = netio_slot();
+  int fd;
+
+  if (cp == NULL || (fd = netio_socket(SOCK_DGRAM, port)) < 0)
+    return false;
+  return netio_open(cp, fd, NETIO_DGRAM, role);
+}
+
+/* kept connected by the thread, hello is sent on every connect */
+bool NetIO_connect(const char *host, uint16_t port, uint8_t role,
+                   const char *hello)
+{
+  netio_conn_t *cp = netio_slot();
+  struct addrinfo hints, *res;
+
+  if (cp == NULL)
+    return false;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, NULL, &hints, &res) != 0) {
+    fprintf(stderr, "NetIO: %s: unknown host\n", host);
+    return false;
+  }
+  memcpy(&cp->peer, res->ai_addr, sizeof(cp->peer));
+  cp->peer.sin_port = htons(port);
+  freeaddrinfo(res);
+
+  cp->fd         = -1;
+  cp->type       = NETIO_PEER;
+  cp->role       = role;
+  cp->connecting = false;
+  cp->hello      = (hello != NULL ? strdup(hello) : NULL);
+  cp->retry_ms   = millis();
+  __atomic_store_n(&cp->state, NETIO_OPEN, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+bool NetIO_start()
+{
+  netio_stop = false;
+  if (pthread_create(&netio_thread, NULL, netio_loop, NULL) != 0)
+    return false;
+  netio_running = true;
+  return true;
+}
+
+/* next message with a terminating NUL, 0 if there is none */
+size_t NetIO_read(char *buf, size_t size, uint8_t *role)
+{
+  netio_reclaim();
+
+  uint32_t tail = netio_rx_tail;
+  uint32_t head = __atomic_load_n(&netio_rx_head, __ATOMIC_ACQUIRE);
+  uint32_t hdr;
+
+  if (head == tail)
+    return 0;
+
+  ring_get(netio_rx, NETIO_RX_RING, tail, &hdr, sizeof(hdr));
+
+  uint32_t len = hdr & 0xFFFFFF;
+  size_t n = (len < size - 1) ? len : size - 1;
+
+  ring_get(netio_rx, NETIO_RX_RING, tail + sizeof(hdr), buf, n);
+  buf[n] = 0;
+  if (role != NULL)
+    *role = hdr >> 24;
+
+  __atomic_store_n(&netio_rx_tail, tail + sizeof(hdr) + len, __ATOMIC_RELEASE);
+  return n;
+}
+
+/* to every output client with room for all of it */
+void NetIO_send(const void *buf, size_t size)
+{
+  bool wake = false;
+
+  for (int i = 0; i < NETIO_MAX_CONN; i++) {
+    netio_conn_t *cp = &netio_conn[i];
+    uint8_t state = __atomic_load_n(&cp->state, __ATOMIC_ACQUIRE);
+
+    if (state == NETIO_CLOSED) {
+      __atomic_store_n(&cp->state, NETIO_FREE, __ATOMIC_RELEASE);
+      continue;
+    }
+    if (state != NETIO_OPEN || cp->type != NETIO_STREAM ||
+        cp->role != NETIO_ROLE_OUTPUT)
+      continue;
+
+    uint32_t head = cp->out_head;
+    uint32_t tail = __atomic_load_n(&cp->out_tail, __ATOMIC_SEQ_CST);
+
+    if (NETIO_TX_RING - (head - tail) < size) {
+      ++NetIO_stats.tx_dropped;
+      continue;
+    }
+    ring_put(netio_out[i], NETIO_TX_RING, head, buf, size);
+    __atomic_store_n(&cp->out_head, head + size, __ATOMIC_SEQ_CST);
+
+    /* the thread only needs a kick if it had caught up */
+    if (__atomic_load_n(&cp->out_tail, __ATOMIC_SEQ_CST) == head)
+      wake = true;
+  }
+
+  if (wake)
+    netio_wake();
+}
+
+/* UDP broadcast, dropped if the socket buffer is full */
+void NetIO_sendto(uint16_t port, const void *buf, size_t size)
+{
+  struct sockaddr_in addr;
+
+  if (netio_udp < 0)
+    return;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+  addr.sin_port        = htons(port);
+
+  sendto(netio_udp, buf, size, MSG_DONTWAIT,
+         (struct sockaddr *) &addr, sizeof(addr));
+}
+
+void NetIO_fini()
+{
+  if (netio_running) {
+    netio_stop = true;
+    netio_wake();
+    pthread_join(netio_thread, NULL);
+    netio_running = false;
+  }
+
+  for (int i = 0; i < NETIO_MAX_CONN; i++) {
+    if (netio_conn[i].fd >= 0)
+      close(netio_conn[i].fd);
+    netio_conn[i].fd    = -1;
+    netio_conn[i].state = NETIO_FREE;
+  }
+  if (netio_udp >= 0)
+    close(netio_udp);
+  netio_udp = -1;
+}
+
+#endif /* RASPBERRY_PI */
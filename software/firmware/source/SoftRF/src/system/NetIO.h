@@ -0,0 +1,67 @@
+/*
+ * NetIO.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETIO_H
+#define NETIO_H
+
+/*
+ * Network I/O of the Raspberry Pi build, on one epoll thread.
+ *
+ * Ingest sources (dump1090 and PingStation over TCP or UDP, gpsd) are
+ * framed into messages - a JSON object, or a line - and passed to the
+ * main loop through a single-producer single-consumer ring, NetIO_read().
+ * Output clients each have their own ring, filled by NetIO_send() from
+ * the main loop and drained by the thread; a client that does not keep
+ * up loses messages, nothing waits for it.
+ *
+ * Sockets are set up with NetIO_listen(), NetIO_bind_udp() and
+ * NetIO_connect() between NetIO_setup() and NetIO_start().
+ */
+
+#define NETIO_MAX_CONN      16
+#define NETIO_MSG_MAX       65536       /* largest ingest message */
+#define NETIO_RX_RING       (256*1024)  /* to the main loop, power of 2 */
+#define NETIO_TX_RING       16384       /* per output client, power of 2 */
+#define NETIO_RETRY_MS      5000        /* reconnect of NetIO_connect() */
+
+/* what a socket is for */
+#define NETIO_ROLE_TRAFFIC  0           /* traffic JSON, settings, "quit" */
+#define NETIO_ROLE_GNSS     1           /* gpsd JSON or NMEA */
+#define NETIO_ROLE_OUTPUT   2           /* NMEA and GDL90 clients */
+
+typedef struct netio_stats_struct {
+  uint32_t  rx_msgs;
+  uint32_t  rx_dropped;                 /* ring full, or over NETIO_MSG_MAX */
+  uint32_t  tx_dropped;                 /* a client's ring was full */
+  uint32_t  accepted;
+  uint8_t   clients;                    /* output clients now */
+} netio_stats_t;
+
+bool   NetIO_setup(void);
+bool   NetIO_listen(uint16_t, uint8_t);
+bool   NetIO_bind_udp(uint16_t, uint8_t);
+bool   NetIO_connect(const char *, uint16_t, uint8_t, const char *);
+bool   NetIO_start(void);
+size_t NetIO_read(char *, size_t, uint8_t *);
+void   NetIO_send(const void *, size_t);
+void   NetIO_sendto(uint16_t, const void *, size_t);
+void   NetIO_fini(void);
+
+extern netio_stats_t NetIO_stats;
+
+#endif /* NETIO_H */
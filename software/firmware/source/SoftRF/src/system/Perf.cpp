@@ -0,0 +1,68 @@
+/*
+ * Perf.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SoC.h"
+#include "Perf.h"
+
+perf_stat_t Perf[PERF_COUNT];
+
+const char *Perf_name[PERF_COUNT] = {
+  "loop", "rf", "gnss", "parse", "traffic", "export", "display", "web"
+};
+
+static uint32_t perf_cycles_per_us = 1;
+
+void Perf_setup()
+{
+#if defined(ESP32)
+  perf_cycles_per_us = getCpuFrequencyMhz();
+#elif defined(ARDUINO_ARCH_NRF52)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  perf_cycles_per_us = SystemCoreClock / 1000000;
+#elif defined(RASPBERRY_PI)
+  perf_cycles_per_us = 1000;
+#endif
+  Perf_reset();
+}
+
+void Perf_reset()
+{
+  memset(Perf, 0, sizeof(Perf));
+  for (int i=0; i < PERF_COUNT; i++)
+    Perf[i].min_us = 0xFFFFFFFF;
+}
+
+void Perf_add(uint8_t id, uint32_t cycles)
+{
+  perf_stat_t *sp = &Perf[id];
+  uint32_t us = cycles / perf_cycles_per_us;
+
+  ++sp->count;
+  sp->total_us += us;
+  if (us < sp->min_us)
+    sp->min_us = us;
+  if (us > sp->max_us)
+    sp->max_us = us;
+
+  int b = 0;
+  for (uint32_t lim = 16; b < PERF_BUCKETS-1 && us >= lim; lim <<= 2)
+    ++b;
+  ++sp->hist[b];
+}
@@ -0,0 +1,89 @@
+/*
+ * Perf.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#if defined(RASPBERRY_PI)
+#include <time.h>
+#endif
+
+/*
+ * Runtime of the main-loop subsystems, timed with the CPU cycle counter
+ * where there is one (CCOUNT on ESP32, DWT on nRF52, the monotonic clock
+ * on the Pi), else with micros().  Reported by $PSRFP and on /perf.
+ */
+
+enum {
+  PERF_LOOP,            /* one pass of loop() */
+  PERF_RF,              /* RF_loop(), the time slots and channels */
+  PERF_GNSS,            /* GNSS_loop() */
+  PERF_PARSE,           /* ParseData() */
+  PERF_TRAFFIC,         /* Traffic_loop() */
+  PERF_EXPORT,          /* NMEA, GDL90 and D1090 exports */
+  PERF_DISPLAY,         /* OLED or e-paper refresh */
+  PERF_WEB,             /* Web_loop() */
+  PERF_COUNT
+};
+
+/* microseconds, bucket i counts runs under 16 << 2i, the last one the rest */
+#define PERF_BUCKETS    8
+
+typedef struct perf_stat_struct {
+  uint32_t  count;
+  uint32_t  min_us;
+  uint32_t  max_us;
+  uint64_t  total_us;           /* PERF_LOOP passes 2^32 in 72 minutes */
+  uint32_t  hist[PERF_BUCKETS];
+} perf_stat_t;
+
+extern perf_stat_t Perf[PERF_COUNT];
+extern const char *Perf_name[PERF_COUNT];
+
+void Perf_setup(void);
+void Perf_reset(void);
+void Perf_add(uint8_t id, uint32_t cycles);
+
+static inline uint32_t perf_cycles()
+{
+#if defined(ESP32)
+  return ESP.getCycleCount();
+#elif defined(ARDUINO_ARCH_NRF52)
+  return DWT->CYCCNT;
+#elif defined(RASPBERRY_PI)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t) ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#else
+  return micros();
+#endif
+}
+
+/* times the rest of the enclosing block */
+class PerfScope {
+public:
+  PerfScope(uint8_t id) : _id(id), _start(perf_cycles()) {}
+  ~PerfScope() { Perf_add(_id, perf_cycles() - _start); }
+private:
+  uint8_t  _id;
+  uint32_t _start;
+};
+
+#define PERF_SCOPE(id)  PerfScope perf_scope_##id(id)
+
+#endif /* PERF_H */
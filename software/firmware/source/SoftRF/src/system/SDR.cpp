@@ -0,0 +1,714 @@
+/*
+ * SDR.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(RASPBERRY_PI)
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <TimeLib.h>
+#include <TinyGPS++.h>
+#include <fec.h>
+
+extern "C" {
+#include <mode-s.h>
+}
+
+#include "SoC.h"
+#include "SDR.h"
+#include "../driver/RF.h"
+#include "../driver/GNSS.h"
+#include "../TrafficHelper.h"
+#include "../ApproxMath.h"
+#include "../protocol/data/GDL90.h"
+#include "../protocol/data/JSON.h"
+
+#define SDR_POLL_US         1000        /* a reader or worker with nothing to do */
+
+/* the end of a buffer is scanned again at the start of the next one */
+#define ES_OVERLAP          ((8 + 112) * 2 * 2)   /* preamble and long frame */
+
+#define UAT_SYNC_BITS       36
+#define UAT_SYNC_MASK       ((1ULL << UAT_SYNC_BITS) - 1)
+#define UAT_ADSB_SYNC_WORD  0xEACDDA4E2ULL
+#define UAT_MAX_SYNC_ERRORS 4
+#define UAT_OVERLAP         ((UAT_SYNC_BITS + LONG_FRAME_BITS + 2) * 2 * 2)
+
+typedef struct sdr_frame_struct {
+  uint32_t  ms;                         /* when its samples were read */
+  union {
+    struct mode_s_msg es;               /* DF17, CRC checked */
+    uint8_t uat[LONG_FRAME_BYTES];      /* after the FEC */
+  };
+} sdr_frame_t;
+
+typedef struct sdr_band_struct sdr_band_t;
+
+struct sdr_band_struct {
+  uint8_t     id;
+  const char *name;
+  const char *path;
+  int         fd;
+  uint32_t    overlap;                  /* bytes */
+  void      (*demod)(sdr_band_t *, const uint8_t *, uint32_t, uint32_t);
+
+  /* I/Q buffers: 'filled' moved by the reader, 'consumed' by the worker */
+  uint8_t    *iq[SDR_BUFFERS];
+  uint32_t    iq_len[SDR_BUFFERS];
+  uint32_t    iq_ms[SDR_BUFFERS];
+  uint32_t    filled;
+  uint32_t    consumed;
+  bool        eof;                      /* the reader is done */
+  bool        done;                     /* and so is the worker */
+
+  /* frames: head moved by the worker, tail by the main loop */
+  sdr_frame_t out[SDR_OUT_RING];
+  uint32_t    out_head;
+  uint32_t    out_tail;
+
+  pthread_t   reader;
+  pthread_t   worker;
+  bool        configured;
+  bool        running;
+  bool        reported;
+};
+
+typedef struct sdr_track_struct {
+  uint32_t  addr;
+  uint32_t  seen_ms;
+  uint32_t  velocity_ms;                /* of course, speed and vs */
+  float     course;
+  float     speed;                      /* knots */
+  float     vs;                         /* feet per minute */
+  uint8_t   category;                   /* GDL90 emitter category */
+  char      callsign[9];
+} sdr_track_t;
+
+sdr_stats_t SDR_stats[SDR_BAND_COUNT];
+
+static sdr_band_t sdr_band[SDR_BAND_COUNT];
+static volatile bool sdr_stop = false;
+
+/* the 1090 worker */
+static mode_s_t   sdr_modes;
+static uint16_t  *sdr_mag      = NULL;
+static uint32_t   sdr_es_ms;
+
+/* the 978 worker */
+static uint16_t  *sdr_iqphase  = NULL;  /* I | Q << 8 to phase, 0..2pi */
+static uint16_t  *sdr_phi      = NULL;
+
+/* the main loop */
+static sdr_track_t sdr_tracks[SDR_ES_TRACKS];
+
+static sdr_frame_t *sdr_out_slot(sdr_band_t *bp)
+{
+  uint32_t head = bp->out_head;
+
+  if (head - __atomic_load_n(&bp->out_tail, __ATOMIC_ACQUIRE) >= SDR_OUT_RING) {
+    __atomic_fetch_add(&SDR_stats[bp->id].dropped, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  return &bp->out[head & (SDR_OUT_RING - 1)];
+}
+
+static void sdr_out_commit(sdr_band_t *bp)
+{
+  __atomic_store_n(&bp->out_head, bp->out_head + 1, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&SDR_stats[bp->id].frames, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * 1090ES: magnitude, preamble detection, CRC check and correction, and
+ * the decode of the fields, all by libmodes.  Only DF17 identification,
+ * airborne position and velocity are passed on.
+ */
+static void sdr_es_msg(mode_s_t *self, struct mode_s_msg *mm)
+{
+  sdr_band_t *bp = &sdr_band[SDR_BAND_1090];
+
+  (void) self;
+
+  if (mm->msgtype != 17 ||
+      !((mm->metype >= 1 && mm->metype <= 4) ||
+        (mm->metype >= 9 && mm->metype <= 18) ||
+        (mm->metype == 19)))
+    return;
+
+  sdr_frame_t *fp = sdr_out_slot(bp);
+  if (fp == NULL)
+    return;
+
+  fp->ms = sdr_es_ms;
+  fp->es = *mm;
+  if (mm->errorbit != -1)
+    __atomic_fetch_add(&SDR_stats[bp->id].fixed, 1, __ATOMIC_RELAXED);
+  sdr_out_commit(bp);
+}
+
+static void sdr_es_demod(sdr_band_t *bp, const uint8_t *iq, uint32_t len,
+                         uint32_t ms)
+{
+  (void) bp;
+
+  sdr_es_ms = ms;
+  mode_s_compute_magnitude_vector((unsigned char *) iq, sdr_mag, len);
+  mode_s_detect(&sdr_modes, sdr_mag, len / 2, sdr_es_msg);
+}
+
+/*
+ * UAT: the method of dump978 (Oliver Jowett).  Two samples per bit, the
+ * bits are the sign of the phase change between them.  A sync word found
+ * at either sample phase sets the slicing level of the frame, the FEC
+ * then tells whether it was one.
+ */
+static inline int16_t uat_dphi(uint16_t from, uint16_t to)
+{
+  return (int16_t) (uint16_t) (to - from);
+}
+
+static bool uat_sync_match(uint64_t bits)
+{
+  return __builtin_popcountll((bits ^ UAT_ADSB_SYNC_WORD) & UAT_SYNC_MASK) <=
+         UAT_MAX_SYNC_ERRORS;
+}
+
+/* the level halfway between the ones and the zeros of the sync word */
+static bool uat_sync_level(const uint16_t *phi, int16_t *center)
+{
+  int32_t one_total = 0, zero_total = 0;
+  int ones = 0, zeros = 0, errors = 0;
+  int i;
+
+  for (i = 0; i < UAT_SYNC_BITS; i++) {
+    int16_t dphi = uat_dphi(phi[i*2], phi[i*2+1]);
+
+    if (UAT_ADSB_SYNC_WORD & (1ULL << (UAT_SYNC_BITS - 1 - i))) {
+      one_total += dphi;
+      ones++;
+    } else {
+      zero_total += dphi;
+      zeros++;
+    }
+  }
+  *center = (one_total / ones + zero_total / zeros) / 2;
+
+  for (i = 0; i < UAT_SYNC_BITS; i++) {
+    int16_t dphi = uat_dphi(phi[i*2], phi[i*2+1]);
+
+    if (UAT_ADSB_SYNC_WORD & (1ULL << (UAT_SYNC_BITS - 1 - i))) {
+      if (dphi < *center)
+        errors++;
+    } else {
+      if (dphi >= *center)
+        errors++;
+    }
+  }
+  return errors <= UAT_MAX_SYNC_ERRORS;
+}
+
+/* bits of the frame that starts with the sync word at phi, 0 if none */
+static int uat_demod_frame(const uint16_t *phi, uint8_t *frame, int *rs_errors)
+{
+  int16_t center;
+
+  *rs_errors = 9999;
+  if (!uat_sync_level(phi, &center))
+    return 0;
+
+  phi += UAT_SYNC_BITS * 2;
+  for (int i = 0; i < LONG_FRAME_BYTES; i++) {
+    uint8_t b = 0;
+
+    for (int k = 0; k < 8; k++, phi += 2)
+      b = (b << 1) | (uat_dphi(phi[0], phi[1]) > center ? 1 : 0);
+    frame[i] = b;
+  }
+
+  switch (correct_adsb_frame(frame, rs_errors))
+  {
+  case 1:
+    return UAT_SYNC_BITS + SHORT_FRAME_BITS;
+  case 2:
+    return UAT_SYNC_BITS + LONG_FRAME_BITS;
+  default:
+    return 0;
+  }
+}
+
+static void sdr_uat_push(sdr_band_t *bp, const uint8_t *frame, int rs_errors,
+                         uint32_t ms)
+{
+  sdr_frame_t *fp = sdr_out_slot(bp);
+  if (fp == NULL)
+    return;
+
+  fp->ms = ms;
+  memcpy(fp->uat, frame, LONG_FRAME_BYTES);
+  if (rs_errors > 0)
+    __atomic_fetch_add(&SDR_stats[bp->id].fixed, 1, __ATOMIC_RELAXED);
+  sdr_out_commit(bp);
+}
+
+static void sdr_uat_demod(sdr_band_t *bp, const uint8_t *iq, uint32_t len,
+                          uint32_t ms)
+{
+  uint32_t n = len / 2;
+  int lenbits = (int) (n - UAT_OVERLAP / 2) / 2;
+  uint64_t sync0 = 0, sync1 = 0;
+  uint16_t *phi = sdr_phi;
+
+  for (uint32_t k = 0; k < n; k++)
+    phi[k] = sdr_iqphase[iq[2*k] | (iq[2*k+1] << 8)];
+
+  /* sync words that start in the first lenbits bits */
+  for (int bit = 0; bit < lenbits + UAT_SYNC_BITS - 1; bit++) {
+    sync0 = ((sync0 << 1) | (uat_dphi(phi[bit*2],   phi[bit*2+1]) > 0)) & UAT_SYNC_MASK;
+    sync1 = ((sync1 << 1) | (uat_dphi(phi[bit*2+1], phi[bit*2+2]) > 0)) & UAT_SYNC_MASK;
+
+    if (bit < UAT_SYNC_BITS - 1)
+      continue;
+
+    bool match0 = uat_sync_match(sync0);
+    if (!match0 && !uat_sync_match(sync1))
+      continue;
+
+    /*
+     * that sample and the next, the one the FEC had less to fix in wins;
+     * nothing can beat a frame that needed no fixing
+     */
+    int startbit = bit - UAT_SYNC_BITS + 1;
+    int index = startbit * 2 + (match0 ? 0 : 1);
+    uint8_t frame0[LONG_FRAME_BYTES], frame1[LONG_FRAME_BYTES];
+    int errors0, errors1 = 9999;
+    int skip0 = uat_demod_frame(phi + index,     frame0, &errors0);
+    int skip1 = (skip0 && errors0 == 0) ? 0 :
+                uat_demod_frame(phi + index + 1, frame1, &errors1);
+
+    if (skip0 && errors0 <= errors1) {
+      sdr_uat_push(bp, frame0, errors0, ms);
+      bit = startbit + skip0 - 1;
+    } else if (skip1) {
+      sdr_uat_push(bp, frame1, errors1, ms);
+      bit = startbit + skip1 - 1;
+    } else {
+      continue;
+    }
+    sync0 = sync1 = 0;
+  }
+}
+
+static void *sdr_reader(void *arg)
+{
+  sdr_band_t *bp = (sdr_band_t *) arg;
+  uint32_t seq = 0;
+
+  /* a FIFO blocks here until rtl_sdr opens it */
+  bp->fd = open(bp->path, O_RDONLY);
+  if (bp->fd < 0)
+    perror(bp->path);
+
+  while (bp->fd >= 0 && !sdr_stop) {
+    if (seq - __atomic_load_n(&bp->consumed, __ATOMIC_ACQUIRE) >= SDR_BUFFERS) {
+      usleep(SDR_POLL_US);
+      continue;
+    }
+
+    uint32_t i = seq & (SDR_BUFFERS - 1);
+    uint8_t *buf = bp->iq[i];
+    uint32_t len = bp->overlap;
+
+    if (seq == 0) {
+      memset(buf, 127, bp->overlap);          /* no signal */
+    } else {
+      uint32_t prev = (seq - 1) & (SDR_BUFFERS - 1);
+      memcpy(buf, bp->iq[prev] + bp->iq_len[prev] - bp->overlap, bp->overlap);
+    }
+
+    while (len < SDR_BLOCK) {
+      ssize_t n = read(bp->fd, buf + len, SDR_BLOCK - len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      len += n;
+    }
+    len &= ~1U;                               /* whole I/Q pairs */
+
+    if (len > bp->overlap) {
+      bp->iq_len[i] = len;
+      bp->iq_ms[i]  = millis();
+      __atomic_store_n(&bp->filled, ++seq, __ATOMIC_RELEASE);
+    }
+    if (len < SDR_BLOCK)
+      break;                                  /* end of file, or an error */
+  }
+
+  __atomic_store_n(&bp->eof, true, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+static void *sdr_worker(void *arg)
+{
+  sdr_band_t *bp = (sdr_band_t *) arg;
+  uint32_t seq = 0;
+
+  while (!sdr_stop) {
+    if (seq == __atomic_load_n(&bp->filled, __ATOMIC_ACQUIRE)) {
+      if (__atomic_load_n(&bp->eof, __ATOMIC_ACQUIRE) &&
+          seq == __atomic_load_n(&bp->filled, __ATOMIC_ACQUIRE))
+        break;
+      usleep(SDR_POLL_US);
+      continue;
+    }
+
+    uint32_t i = seq & (SDR_BUFFERS - 1);
+    bp->demod(bp, bp->iq[i], bp->iq_len[i], bp->iq_ms[i]);
+    __atomic_fetch_add(&SDR_stats[bp->id].blocks, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&bp->consumed, ++seq, __ATOMIC_RELEASE);
+  }
+
+  __atomic_store_n(&bp->done, true, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/*
+ * The main loop: 1090ES positions are decoded relative to our own (the
+ * CPR "local" decode, good within 180 NM), and take the velocity and the
+ * identity last heard from the same aircraft.
+ */
+static int cpr_NL(double lat)
+{
+  double a = 1.0 - cos(M_PI / (2 * 15));
+  double c = cos(M_PI / 180.0 * lat);
+  double x;
+
+  if (lat < 0)
+    lat = -lat;
+  if (lat >= 87.0)
+    return lat > 87.0 ? 1 : 2;
+  x = 1.0 - a / (c * c);
+  return (int) floor(2.0 * M_PI / acos(x));
+}
+
+static double cpr_mod(double x, double y)
+{
+  return x - y * floor(x / y);
+}
+
+static void cpr_local(int fflag, int raw_lat, int raw_lon,
+                      float *lat, float *lon)
+{
+  double lat0 = ThisAircraft.latitude;
+  double lon0 = ThisAircraft.longitude;
+  double fraction_lat = raw_lat / 131072.0;
+  double fraction_lon = raw_lon / 131072.0;
+  double dlat = 360.0 / (fflag ? 59 : 60);
+  double j = floor(lat0 / dlat) +
+             floor(0.5 + cpr_mod(lat0, dlat) / dlat - fraction_lat);
+  double rlat = dlat * (j + fraction_lat);
+
+  int ni = cpr_NL(rlat) - fflag;
+  double dlon = 360.0 / (ni > 1 ? ni : 1);
+  double m = floor(lon0 / dlon) +
+             floor(0.5 + cpr_mod(lon0, dlon) / dlon - fraction_lon);
+  double rlon = dlon * (m + fraction_lon);
+
+  if (rlon > 180.0)
+    rlon -= 360.0;
+  else if (rlon < -180.0)
+    rlon += 360.0;
+
+  *lat = rlat;
+  *lon = rlon;
+}
+
+/* as parseD1090_stream() does with what dump1090 sends */
+static bool sdr_in_range(float lat, float lon, float altitude)
+{
+  float dy = (lat - ThisAircraft.latitude) * 111300.0;
+  float dx = (lon - ThisAircraft.longitude) * 111300.0 *
+             CosLat(ThisAircraft.latitude);
+
+  return fabs(dy) <= D1090_MAX_RANGE && fabs(dx) <= D1090_MAX_RANGE &&
+         dx * dx + dy * dy <= (float) D1090_MAX_RANGE * D1090_MAX_RANGE &&
+         fabs(altitude - ThisAircraft.altitude) <= D1090_MAX_ALT_DIFF;
+}
+
+static sdr_track_t *sdr_track(uint32_t addr, uint32_t ms)
+{
+  sdr_track_t *oldest = &sdr_tracks[0];
+
+  for (int i = 0; i < SDR_ES_TRACKS; i++) {
+    sdr_track_t *tp = &sdr_tracks[i];
+
+    if (tp->addr == addr) {
+      tp->seen_ms = ms;
+      return tp;
+    }
+    if (ms - tp->seen_ms > ms - oldest->seen_ms)
+      oldest = tp;
+  }
+
+  memset(oldest, 0, sizeof(sdr_track_t));
+  oldest->addr    = addr;
+  oldest->seen_ms = ms;
+  return oldest;
+}
+
+static void sdr_traffic(sdr_band_t *bp, sdr_frame_t *fp)
+{
+  sdr_stats_t *sp = &SDR_stats[bp->id];
+
+  AddTraffic(&fo);
+  ++sp->traffic;
+
+  sp->latency_ms = millis() - fp->ms;
+  if (sp->latency_ms > sp->latency_max_ms)
+    sp->latency_max_ms = sp->latency_ms;
+}
+
+static void sdr_es_frame(sdr_band_t *bp, sdr_frame_t *fp)
+{
+  struct mode_s_msg *mm = &fp->es;
+  uint32_t ms = millis();
+  sdr_track_t *tp = sdr_track((mm->aa1 << 16) | (mm->aa2 << 8) | mm->aa3, ms);
+
+  if (mm->metype >= 1 && mm->metype <= 4) {
+    /* identification and category, sets A and B as GDL90 has them */
+    int i = 8;
+
+    memcpy(tp->callsign, mm->flight, sizeof(tp->callsign));
+    while (i > 0 && tp->callsign[i-1] == ' ')
+      tp->callsign[--i] = '\0';
+    if (mm->metype == 4)
+      tp->category = mm->mesub;
+    else if (mm->metype == 3 && mm->mesub)
+      tp->category = 8 + mm->mesub;
+    return;
+  }
+
+  if (mm->metype == 19) {
+    /* ground speed subtypes only */
+    if (mm->mesub == 1 || mm->mesub == 2) {
+      tp->velocity_ms = ms;
+      tp->course = mm->heading;
+      tp->speed  = mm->velocity;
+      tp->vs     = mm->vert_rate ? (mm->vert_rate - 1) * 64 : 0;
+      if (mm->vert_rate_sign)
+        tp->vs = -tp->vs;
+    }
+    return;
+  }
+
+  if (mm->altitude == 0)
+    return;                     /* no barometric altitude */
+
+  float lat, lon;
+  float pressure_altitude = mm->altitude / _GPS_FEET_PER_METER;
+
+  cpr_local(mm->fflag ? 1 : 0, mm->raw_latitude, mm->raw_longitude, &lat, &lon);
+  if (!sdr_in_range(lat, lon, pressure_altitude))
+    return;
+
+  fo = EmptyFO;
+  fo.timestamp = now();
+  fo.gnsstime_ms = ms;
+  fo.protocol = RF_PROTOCOL_ADSB_1090;
+  fo.addr = tp->addr;
+  fo.addr_type = ADDR_TYPE_ICAO;
+  fo.latitude = lat;
+  fo.longitude = lon;
+  fo.pressure_altitude = pressure_altitude;
+
+  /* TBD */
+  fo.altitude = fo.pressure_altitude;
+
+  if (ms - tp->velocity_ms <= SDR_ES_TTL_MS) {
+    fo.course = tp->course;
+    fo.speed = tp->speed;
+    fo.vs = tp->vs;
+  }
+  fo.aircraft_type = tp->category ? GDL90_TO_AT(tp->category) :
+                                    AIRCRAFT_TYPE_JET;
+  memcpy(fo.callsign, tp->callsign, sizeof(tp->callsign));
+  fo.stealth = false;
+  fo.no_track = false;
+
+  sdr_traffic(bp, fp);
+}
+
+static void sdr_uat_frame(sdr_band_t *bp, sdr_frame_t *fp)
+{
+  fo = EmptyFO;
+  if (!uat978_decode(fp->uat, &ThisAircraft, &fo) ||
+      (fo.latitude == 0.0 && fo.longitude == 0.0))
+    return;
+
+  if (fo.altitude == 0.0)
+    fo.altitude = fo.pressure_altitude;
+  if (!sdr_in_range(fo.latitude, fo.longitude, fo.altitude))
+    return;
+
+  sdr_traffic(bp, fp);
+}
+
+bool SDR_setup(uint8_t band, const char *path)
+{
+  sdr_band_t *bp;
+
+  if (band >= SDR_BAND_COUNT)
+    return false;
+  if (access(path, R_OK) != 0) {
+    perror(path);
+    return false;
+  }
+
+  bp = &sdr_band[band];
+  bp->id   = band;
+  bp->path = path;
+  bp->fd   = -1;
+
+  for (int i = 0; i < SDR_BUFFERS; i++) {
+    if (bp->iq[i] == NULL && (bp->iq[i] = (uint8_t *) malloc(SDR_BLOCK)) == NULL)
+      return false;
+  }
+
+  if (band == SDR_BAND_1090) {
+    bp->name    = "1090";
+    bp->overlap = ES_OVERLAP;
+    bp->demod   = sdr_es_demod;
+    if (sdr_mag == NULL &&
+        (sdr_mag = (uint16_t *) malloc(SDR_BLOCK / 2 * sizeof(uint16_t))) == NULL)
+      return false;
+    mode_s_init(&sdr_modes);
+  } else {
+    bp->name    = "978";
+    bp->overlap = UAT_OVERLAP;
+    bp->demod   = sdr_uat_demod;
+    if (sdr_phi == NULL &&
+        (sdr_phi = (uint16_t *) malloc(SDR_BLOCK / 2 * sizeof(uint16_t))) == NULL)
+      return false;
+    if (sdr_iqphase == NULL) {
+      if ((sdr_iqphase = (uint16_t *) malloc(65536 * sizeof(uint16_t))) == NULL)
+        return false;
+      for (int i = 0; i < 256; i++) {
+        for (int q = 0; q < 256; q++) {
+          double angle = atan2(q - 127.5, i - 127.5) + M_PI;
+          sdr_iqphase[i | (q << 8)] = (uint16_t) lround(32768.0 * angle / M_PI);
+        }
+      }
+    }
+    init_fec();
+  }
+
+  bp->configured = true;
+  return true;
+}
+
+bool SDR_start()
+{
+  sdr_stop = false;
+
+  for (int b = 0; b < SDR_BAND_COUNT; b++) {
+    sdr_band_t *bp = &sdr_band[b];
+
+    if (!bp->configured || bp->running)
+      continue;
+    if (pthread_create(&bp->worker, NULL, sdr_worker, bp) != 0)
+      return false;
+    if (pthread_create(&bp->reader, NULL, sdr_reader, bp) != 0) {
+      sdr_stop = true;
+      pthread_join(bp->worker, NULL);
+      return false;
+    }
+    bp->running = true;
+  }
+  return true;
+}
+
+void SDR_loop()
+{
+  for (int b = 0; b < SDR_BAND_COUNT; b++) {
+    sdr_band_t *bp = &sdr_band[b];
+
+    if (!bp->running)
+      continue;
+
+    uint32_t tail = bp->out_tail;
+    uint32_t head = __atomic_load_n(&bp->out_head, __ATOMIC_ACQUIRE);
+
+    for (; tail != head; tail++) {
+      sdr_frame_t *fp = &bp->out[tail & (SDR_OUT_RING - 1)];
+
+      if (isValidFix()) {
+        if (b == SDR_BAND_1090)
+          sdr_es_frame(bp, fp);
+        else
+          sdr_uat_frame(bp, fp);
+      }
+      __atomic_store_n(&bp->out_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    if (!bp->reported && __atomic_load_n(&bp->done, __ATOMIC_ACQUIRE) &&
+        tail == __atomic_load_n(&bp->out_head, __ATOMIC_ACQUIRE)) {
+      sdr_stats_t *sp = &SDR_stats[b];
+
+      fprintf(stderr, "SDR %s: end of %s, %u blocks, %u frames (%u corrected),"
+                      " %u dropped, %u traffic, latency max %u ms\n",
+                      bp->name, bp->path, sp->blocks, sp->frames, sp->fixed,
+                      sp->dropped, sp->traffic, sp->latency_max_ms);
+      bp->reported = true;
+    }
+  }
+}
+
+/* samples or frames of the band still to go */
+bool SDR_active(uint8_t band)
+{
+  return band < SDR_BAND_COUNT && sdr_band[band].running &&
+         !sdr_band[band].reported;
+}
+
+void SDR_fini()
+{
+  sdr_stop = true;
+
+  for (int b = 0; b < SDR_BAND_COUNT; b++) {
+    sdr_band_t *bp = &sdr_band[b];
+
+    if (!bp->running)
+      continue;
+
+    /* the reader may be blocked on a FIFO with no writer */
+    pthread_cancel(bp->reader);
+    pthread_join(bp->reader, NULL);
+    pthread_join(bp->worker, NULL);
+    if (bp->fd >= 0)
+      close(bp->fd);
+    bp->fd = -1;
+    bp->running = false;
+  }
+}
+
+#endif /* RASPBERRY_PI */
@@ -0,0 +1,66 @@
+/*
+ * SDR.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SDR_H
+#define SDR_H
+
+/*
+ * In-process 1090ES and UAT reception of the Raspberry Pi build, from raw
+ * 8-bit unsigned I/Q - a file, or a FIFO fed by rtl_sdr:
+ *
+ *   rtl_sdr -f 1090000000 -s 2000000 /tmp/1090.iq
+ *   rtl_sdr -f 978000000  -s 2083334 /tmp/978.iq
+ *
+ * Each band has a reader thread, filling a ring of sample buffers, and a
+ * worker that demodulates them - libmodes for 1090, the dump978 method
+ * and its Reed-Solomon FEC for 978 - into a ring of frames.  SDR_loop(),
+ * from the main loop, decodes those into AddTraffic().  The rings are
+ * single-producer single-consumer, nothing takes a lock.
+ */
+
+enum {
+  SDR_BAND_1090,                        /* Mode S ES, 2 MS/s */
+  SDR_BAND_978,                         /* UAT, 2.083334 MS/s */
+  SDR_BAND_COUNT
+};
+
+#define SDR_BUFFERS     16              /* of I/Q per band, power of 2 */
+#define SDR_BLOCK       (128*1024)      /* bytes, about 32 ms of I/Q */
+#define SDR_OUT_RING    256             /* frames per band, power of 2 */
+#define SDR_ES_TRACKS   64              /* 1090ES aircraft being followed */
+#define SDR_ES_TTL_MS   10000           /* velocity and identity kept for */
+
+typedef struct sdr_stats_struct {
+  uint32_t  blocks;                     /* buffers demodulated */
+  uint32_t  frames;                     /* passed the CRC or the FEC */
+  uint32_t  fixed;                      /* of those, after correction */
+  uint32_t  dropped;                    /* the main loop was behind */
+  uint32_t  traffic;                    /* passed to AddTraffic() */
+  uint32_t  latency_ms;                 /* samples read to AddTraffic(), last */
+  uint32_t  latency_max_ms;
+} sdr_stats_t;
+
+bool SDR_setup(uint8_t, const char *);
+bool SDR_start(void);
+void SDR_loop(void);
+bool SDR_active(uint8_t);
+void SDR_fini(void);
+
+extern sdr_stats_t SDR_stats[SDR_BAND_COUNT];
+
+#endif /* SDR_H */
@@ -0,0 +1,154 @@
+/*
+ * Sched.cpp
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SoC.h"
+#include "Sched.h"
+
+#if defined(USE_SCHED_SLEEP)
+#if defined(ESP32)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <FreeRTOS.h>
+#include <task.h>
+#endif
+
+static TaskHandle_t sched_waiter = NULL;    /* the loop() task */
+#endif /* USE_SCHED_SLEEP */
+
+#if !defined(IRAM_ATTR)
+#define IRAM_ATTR
+#endif
+
+/* ARMv6-M and AVR cores have no __atomic_*_4 libcalls, they mask interrupts */
+#if defined(ESP32) || defined(ARDUINO_ARCH_NRF52) || defined(RASPBERRY_PI)
+#define SCHED_ATOMIC
+#endif
+
+static sched_task_t *sched_head = NULL;     /* earliest deadline first */
+static volatile uint32_t sched_events = 0;
+
+uint32_t Sched_slept_ms = 0;
+
+static void sched_insert(sched_task_t *tp)
+{
+  sched_task_t **pp = &sched_head;
+  while (*pp != NULL && (int32_t) ((*pp)->next_ms - tp->next_ms) <= 0)
+    pp = &(*pp)->link;
+  tp->link = *pp;
+  *pp = tp;
+}
+
+void Sched_add(sched_task_t *tp)
+{
+  tp->next_ms = millis() + tp->period_ms;
+  sched_insert(tp);
+}
+
+sched_task_t *Sched_tasks()
+{
+  return sched_head;
+}
+
+/* from an interrupt handler */
+void IRAM_ATTR Sched_event_ISR(uint32_t events)
+{
+#if defined(SCHED_ATOMIC)
+  __atomic_fetch_or(&sched_events, events, __ATOMIC_RELAXED);
+#else
+  sched_events |= events;     /* Sched_run() masks interrupts around its part */
+#endif
+#if defined(USE_SCHED_SLEEP)
+  if (sched_waiter != NULL)
+    vTaskNotifyGiveFromISR(sched_waiter, NULL);
+#endif
+}
+
+/* run whatever is due, in deadline order */
+void Sched_run()
+{
+#if defined(SCHED_ATOMIC)
+  uint32_t events = __atomic_exchange_n(&sched_events, 0, __ATOMIC_RELAXED);
+#else
+  noInterrupts();
+  uint32_t events = sched_events;
+  sched_events = 0;
+  interrupts();
+#endif
+  uint32_t now_ms = millis();
+
+  /* take the due tasks off the list first, they go back with new deadlines */
+  sched_task_t *due = NULL;
+  sched_task_t **tail = &due;
+  sched_task_t **pp = &sched_head;
+  while (*pp != NULL) {
+    sched_task_t *tp = *pp;
+    if ((int32_t) (now_ms - tp->next_ms) >= 0 || (tp->events & events)) {
+      *pp = tp->link;
+      *tail = tp;
+      tail = &tp->link;
+      tp->link = NULL;
+    } else {
+      pp = &tp->link;
+    }
+  }
+
+  while (due != NULL) {
+    sched_task_t *tp = due;
+    due = tp->link;
+
+    uint32_t start_us = micros();
+    (*tp->run)();
+    uint32_t us = micros() - start_us;
+
+    ++tp->runs;
+    tp->total_us += us;
+    if (us > tp->max_us)
+      tp->max_us = us;
+
+    /* as the TimeMarker = millis() after the work it replaces */
+    tp->next_ms = millis() + tp->period_ms;
+    sched_insert(tp);
+  }
+}
+
+/* at the end of loop(), until the next deadline or event */
+void Sched_sleep()
+{
+#if defined(USE_SCHED_SLEEP)
+  if (sched_waiter == NULL)
+    sched_waiter = xTaskGetCurrentTaskHandle();
+
+  if (sched_events != 0)
+    return;
+
+  uint32_t ms = SCHED_MAX_SLEEP_MS;
+  if (sched_head != NULL) {
+    int32_t left = (int32_t) (sched_head->next_ms - millis());
+    if (left < (int32_t) ms)
+      ms = (left > 0 ? left : 0);
+  }
+  if (ms == 0)
+    return;
+
+  /* an event posted since the check above leaves a notification pending */
+  uint32_t start_ms = millis();
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+  Sched_slept_ms += millis() - start_ms;
+#endif /* USE_SCHED_SLEEP */
+}
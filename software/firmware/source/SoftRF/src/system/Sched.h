@@ -0,0 +1,65 @@
+/*
+ * Sched.h
+ * Copyright (C) 2024 SoftRF project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+/*
+ * Cooperative scheduler for the periodic work in normal().
+ * Tasks are kept ordered by deadline and run from Sched_run(), or earlier
+ * when one of their events is posted - SCHED_EV_PPS from the GNSS PPS
+ * interrupt on ESP32 and nRF52, which the display and the exports take
+ * so that they keep in step with the fix.  With USE_SCHED_SLEEP the main loop
+ * sleeps in Sched_sleep() until the next deadline or event, but no longer
+ * than SCHED_MAX_SLEEP_MS.  loop() only sleeps while the RF task services
+ * the radio; the UARTs left to it are buffered by the core drivers, which
+ * hold well over SCHED_MAX_SLEEP_MS of data at the GNSS baud rates.
+ */
+
+#define SCHED_MAX_SLEEP_MS  10
+
+/* events */
+#define SCHED_EV_PPS        0x01
+
+typedef struct sched_task_struct {
+  const char  *name;
+  void       (*run)(void);
+  uint32_t    period_ms;
+  uint32_t    events;           /* also run when any of these is posted */
+
+  uint32_t    next_ms;          /* deadline */
+  struct sched_task_struct *link;
+
+  /* per-task runtime */
+  uint32_t    runs;
+  uint64_t    total_us;
+  uint32_t    max_us;
+} sched_task_t;
+
+#define SCHED_TASK(name, fn, period_ms, events) \
+  { name, fn, period_ms, events, 0, NULL, 0, 0, 0 }
+
+void Sched_add(sched_task_t *);
+void Sched_run(void);
+void Sched_sleep(void);
+void Sched_event_ISR(uint32_t);
+sched_task_t *Sched_tasks(void);
+
+extern uint32_t Sched_slept_ms;
+
+#endif /* SCHED_H */
@@ -25,6 +25,42 @@ time_t  OurTime = 0;           /* UTC time in seconds since start of 1970 */
 uint32_t base_time_ms = 0;     /* this device millis() at last verified PPS */
 uint32_t ref_time_ms = 0;      /* assumed local millis() at last PPS */
 
+#if defined(USE_RF_TASK)
+#if defined(ESP32)
+static portMUX_TYPE Time_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void Time_lock()    { portENTER_CRITICAL(&Time_mux); }
+void Time_unlock()  { portEXIT_CRITICAL(&Time_mux); }
+#elif defined(RASPBERRY_PI)
+#include <pthread.h>
+
+static pthread_mutex_t Time_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void Time_lock()    { pthread_mutex_lock(&Time_mutex); }
+void Time_unlock()  { pthread_mutex_unlock(&Time_mutex); }
+#else
+#include <FreeRTOS.h>
+#include <task.h>
+
+void Time_lock()    { taskENTER_CRITICAL(); }
+void Time_unlock()  { taskEXIT_CRITICAL(); }
+#endif
+#else
+void Time_lock()    {}
+void Time_unlock()  {}
+#endif /* USE_RF_TASK */
+
+/* the free-running second between fixes, from either thread */
+void Time_tick(uint32_t now_ms)
+{
+  Time_lock();
+  if (ref_time_ms > 0 && now_ms >= ref_time_ms + 1000) {
+    OurTime += 1;
+    ref_time_ms += 1000;
+  }
+  Time_unlock();
+}
+
 #define ADJ_FOR_FLARM_RECEPTION 25     // was 40 - seemed to receive FLARM packets better that way
 
 #if defined(ESP32)
@@ -269,10 +305,7 @@ no_pps_time = latest_Commit_Time - no_pps_corr;
 
     /* between fixes (but not before first fix): free-running clock */
     if (! newfix) {
-        if (ref_time_ms > 0 && now_ms >= ref_time_ms + 1000) {
-          OurTime += 1;
-          ref_time_ms += 1000;
-        }
+        Time_tick(now_ms);
         return;
     }
 
@@ -297,8 +330,6 @@ Serial.println(diff);
       //ref_time_ms = base_time_ms = newtime;
     }
 
-    ref_time_ms = base_time_ms = newtime;
-
     int yr = gnss.date.year();
     if( yr > 99)
         yr = yr - 1970;
@@ -312,9 +343,14 @@ Serial.println(diff);
     tm.Minute = gnss.time.minute();
     tm.Second = gnss.time.second();
 
-    OurTime = makeTime(tm);
+    time_t newsec = makeTime(tm);
     if (gnss_age + time_corr_neg >= 1000)
-        OurTime += 1;
+        newsec += 1;
+
+    Time_lock();
+    ref_time_ms = base_time_ms = newtime;
+    OurTime = newsec;
+    Time_unlock();
     /* updated ref_time_ms is the other side effect */
 
     /* system clock also gets updated, by GNSSTimeSync() called from GNSS_loop() */
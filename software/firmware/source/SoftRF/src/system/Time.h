@@ -31,4 +31,12 @@ extern uint32_t ref_time_ms;
 void Time_setup(void);
 void Time_loop(void);
 
+/*
+ * OurTime and ref_time_ms go together.  With USE_RF_TASK the radio thread
+ * reads and steps them as well, so they only change under Time_lock().
+ */
+void Time_lock(void);
+void Time_unlock(void);
+void Time_tick(uint32_t);
+
 #endif /* TIMEHELPER_H */
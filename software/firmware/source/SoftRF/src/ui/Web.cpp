@@ -45,6 +45,9 @@ void Web_fini()     {}
 #include "../driver/Buzzer.h"
 #include "../driver/Voice.h"
 #include "../driver/Bluetooth.h"
+#include "../system/Perf.h"
+#include "../system/LinkQ.h"
+#include "../system/Sched.h"
 #if defined(USE_SD_CARD)
 #include "../driver/SDcard.h"
 #endif
@@ -363,7 +366,7 @@ void handleSettings() {
   if (hw_info.model == SOFTRF_MODEL_PRIME_MK2 /* && hw_info.revision >= 5 */)
     is_prime_mk2 = true;
 
-  size_t size = 13100;
+  size_t size = 13400;
   char *offset;
   size_t len = 0;
   char *Settings_temp = (char *) malloc(size);
@@ -1200,6 +1203,13 @@ void handleSettings() {
 </td>\
 </tr>\
 <tr>\
+<th align=left>GDL90 batching</th>\
+<td align=right>\
+<input type='radio' name='gdl90_batch' value='0' %s>Off\
+<input type='radio' name='gdl90_batch' value='1' %s>On\
+</td>\
+</tr>\
+<tr>\
 <th align=left>Power save</th>\
 <td align=right>\
 <select name='power_save'>\
@@ -1241,6 +1251,7 @@ void handleSettings() {
 <input type='radio' name='no_track' value='1' %s>On\
 </td>\
 </tr>"),
+  (!settings->gdl90_batch ? "checked" : "") , (settings->gdl90_batch ? "checked" : ""),
   (settings->power_save == POWER_SAVE_NONE ? "selected" : ""), POWER_SAVE_NONE,
   (settings->power_save == POWER_SAVE_WIFI ? "selected" : ""), POWER_SAVE_WIFI,
 //(settings->power_save == POWER_SAVE_GNSS ? "selected" : ""), POWER_SAVE_GNSS,
@@ -1414,39 +1425,10 @@ void handleSettings() {
   free(Settings_temp);
 }
 
-void handleRoot() {
-
-  Serial.println(F("handleRoot()..."));
-
-  stop_bluetooth();
-
-  int sec = millis() / 1000;
-  int min = sec / 60;
-  int hr = min / 60;
-
-  float vdd = Battery_voltage() ;
-  bool low_voltage = (Battery_voltage() <= Battery_threshold());
-
-  time_t timestamp = ThisAircraft.timestamp;
-  unsigned int sats = gnss.satellites.value(); // Number of satellites in use (u32)
-  char str_lat[16];
-  char str_lon[16];
-  char str_alt[16];
-  char str_Vcc[8];
-
-  char *Root_temp = (char *) malloc(3500);
-  if (Root_temp == NULL) {
-    Serial.println(F(">>> not enough RAM"));
-    return;
-  }
-
-  dtostrf(ThisAircraft.latitude,  8, 4, str_lat);
-  dtostrf(ThisAircraft.longitude, 8, 4, str_lon);
-  dtostrf(ThisAircraft.altitude,  7, 1, str_alt);
-  dtostrf(vdd, 4, 2, str_Vcc);
+/* the status page, sized from its format, the flight log buttons and these */
+#define ROOT_VALUES_SIZE 640    /* numbers, names and notices, at most */
 
-  snprintf_P ( Root_temp, 3500,
-    PSTR("<html>\
+static const char Root_format[] PROGMEM = "<html>\
  <head>\
   <meta name='viewport' content='width=device-width, initial-scale=1'>\
   <title>SoftRF status</title>\
@@ -1483,6 +1465,7 @@ void handleRoot() {
    <td align=right><table><tr>\
     <th align=left>Tx&nbsp;&nbsp;</th><td align=right>%u</td>\
     <th align=left>&nbsp;&nbsp;&nbsp;&nbsp;Rx&nbsp;&nbsp;</th><td align=right>%u</td>\
+    <th align=left>&nbsp;&nbsp;&nbsp;&nbsp;Dropped&nbsp;&nbsp;</th><td align=right>%u</td>\
   </tr></table></td></tr>\
  </table>\
  <hr>\
@@ -1502,6 +1485,8 @@ void handleRoot() {
    <td><input type=button onClick=\"location.href='/reboot'\" value='Reboot'></td>\
    <td><input type=button onClick=\"location.href='/firmware'\" value='Firmware update'></td>\
    <td><input type=button onClick=\"location.href='/about'\" value='About'></td>\
+   <td><input type=button onClick=\"location.href='/perf'\" value='Perf'></td>\
+   <td><input type=button onClick=\"location.href='/linkq'\" value='Reception'></td>\
   </tr>\
  </table>\
  <hr>\
@@ -1522,7 +1507,57 @@ void handleRoot() {
  </table>\
  %s\
 </body>\
-</html>"),
+</html>";
+
+static const char Root_flightlogs[] =
+#if defined(USE_SD_CARD)
+ "  <hr>\
+ <table width=100%>\
+  <tr>\
+   <td>Flight Logs:</td>\
+   <td><input type=button onClick=\"location.href='/listlogs'\" value='List'></td>\
+   <td><input type=button onClick=\"location.href='/flightlog'\" value='Download Latest'></td>\
+   <td><input type=button onClick=\"location.href='/clearlogs'\" value='Clear'></td>\
+   <td><input type=button onClick=\"location.href='/clearoldlogs'\" value='Empty trash'></td>\
+  </tr>\
+ </table>";
+#else
+ "";
+#endif
+
+void handleRoot() {
+
+  Serial.println(F("handleRoot()..."));
+
+  stop_bluetooth();
+
+  int sec = millis() / 1000;
+  int min = sec / 60;
+  int hr = min / 60;
+
+  float vdd = Battery_voltage() ;
+  bool low_voltage = (Battery_voltage() <= Battery_threshold());
+
+  time_t timestamp = ThisAircraft.timestamp;
+  unsigned int sats = gnss.satellites.value(); // Number of satellites in use (u32)
+  char str_lat[16];
+  char str_lon[16];
+  char str_alt[16];
+  char str_Vcc[8];
+
+  size_t size = strlen_P(Root_format) + sizeof(Root_flightlogs) + ROOT_VALUES_SIZE;
+  char *Root_temp = (char *) malloc(size);
+  if (Root_temp == NULL) {
+    Serial.println(F(">>> not enough RAM"));
+    return;
+  }
+
+  dtostrf(ThisAircraft.latitude,  8, 4, str_lat);
+  dtostrf(ThisAircraft.longitude, 8, 4, str_lon);
+  dtostrf(ThisAircraft.altitude,  7, 1, str_alt);
+  dtostrf(vdd, 4, 2, str_Vcc);
+
+  snprintf_P ( Root_temp, size, Root_format,
     (default_settings_used ?
        "<tr><td align=center><h4>(Warning: reverted to default settings)</h4></td></tr>" : ""),
     (BTpaused ?
@@ -1537,7 +1572,7 @@ void handleRoot() {
 #endif /* ENABLE_AHRS */
     hr, min % 60, sec % 60, ESP.getFreeHeap(),
     low_voltage ? "red" : "green", str_Vcc,
-    tx_packets_counter, rx_packets_counter,
+    tx_packets_counter, rx_packets_counter, rx_queue_drops,
     timestamp, sats, str_lat, str_lon, str_alt,
     ((hw_info.model == SOFTRF_MODEL_PRIME_MK2) ?
  "<tr><td align=middle>\
@@ -1545,23 +1580,10 @@ void handleRoot() {
  </td></tr>"
           : ""),
     num_wav_files,
-#if defined(USE_SD_CARD)
- "  <hr>\
- <table width=100%%>\
-  <tr>\
-   <td>Flight Logs:</td>\
-   <td><input type=button onClick=\"location.href='/listlogs'\" value='List'></td>\
-   <td><input type=button onClick=\"location.href='/flightlog'\" value='Download Latest'></td>\
-   <td><input type=button onClick=\"location.href='/clearlogs'\" value='Clear'></td>\
-   <td><input type=button onClick=\"location.href='/clearoldlogs'\" value='Empty trash'></td>\
-  </tr>\
- </table>"
-#else
- ""
-#endif
+    Root_flightlogs
   );
   Serial.print(F("Status page size: ")); Serial.println(strlen(Root_temp));
-  // currently about 2800
+  // currently about 3600 with the flight log buttons
   SoC->swSer_enableRx(false);
   server.sendHeader(String(F("Cache-Control")), String(F("no-cache, no-store, must-revalidate")));
   server.sendHeader(String(F("Pragma")), String(F("no-cache")));
@@ -1682,6 +1704,8 @@ void handleInput() {
       settings->gdl90_in = server.arg(i).toInt();
     } else if (server.argName(i).equals("gdl90")) {
       settings->gdl90 = server.arg(i).toInt();
+    } else if (server.argName(i).equals("gdl90_batch")) {
+      settings->gdl90_batch = server.arg(i).toInt();
     } else if (server.argName(i).equals("d1090")) {
       settings->d1090 = server.arg(i).toInt();
     } else if (server.argName(i).equals("relay")) {
@@ -1899,7 +1923,7 @@ void handleInput() {
       settings->txpower == RF_TX_POWER_FULL;
 
   /* show new settings before rebooting */
-  size_t size = 3800;
+  size_t size = 3900;
   char *Input_temp = (char *) malloc(size);
   if (Input_temp != NULL) {
     snprintf_P ( Input_temp, size,
@@ -1953,6 +1977,7 @@ PSTR("<html>\
 <tr><th align=left>ADS-B Receiver</th><td align=right>%d</td></tr>\
 <tr><th align=left>GDL90 in</th><td align=right>%d</td></tr>\
 <tr><th align=left>GDL90 out</th><td align=right>%d</td></tr>\
+<tr><th align=left>GDL90 batching</th><td align=right>%s</td></tr>\
 <tr><th align=left>DUMP1090</th><td align=right>%d</td></tr>\
 <tr><th align=left>Air-Relay</th><td align=right>%d</td></tr>\
 <tr><th align=left>Stealth</th><td align=right>%s</td></tr>\
@@ -1985,7 +2010,8 @@ PSTR("<html>\
     settings->nmea_out2,
     BOOL_STR(settings->nmea2_g), BOOL_STR(settings->nmea2_p), BOOL_STR(settings->nmea2_l),
     BOOL_STR(settings->nmea2_s), BOOL_STR(settings->nmea2_d), BOOL_STR(settings->nmea2_e),
-    settings->rx1090, settings->gdl90_in, settings->gdl90, settings->d1090,
+    settings->rx1090, settings->gdl90_in, settings->gdl90,
+    BOOL_STR(settings->gdl90_batch), settings->d1090,
     settings->relay, BOOL_STR(settings->stealth), BOOL_STR(settings->no_track),
     settings->power_save, settings->power_external, settings->freq_corr, settings->logalarms,
     settings->gnss_pins, settings->ppswire, settings->sd_card, settings->debug_flags,
@@ -2268,6 +2294,139 @@ void serve_P_html(const char *html)
     SoC->swSer_enableRx(true);
 }
 
+/* a table row is up to 420 bytes with all the counters in the millions */
+#define PERF_PAGE_SIZE (1200 + 420 * PERF_COUNT)
+
+/* snprintf() at page+len, with len kept inside the page once it is full */
+static int page_printf(char *page, int len, int size, const char *fmt, ...)
+{
+  if (len >= size - 1)
+      return size - 1;
+
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(page+len, size-len, fmt, ap);
+  va_end(ap);
+
+  if (n < 0)
+      return len;
+  return (len + n < size - 1) ? len + n : size - 1;
+}
+
+// runtime of the subsystems and of the scheduled tasks, in microseconds
+void handlePerf()
+{
+  if (server.hasArg("reset"))
+      Perf_reset();
+
+  char *page = (char *) malloc(PERF_PAGE_SIZE);
+  if (! page) {
+      server.send ( 200, "text/html", "(cannot allocate memory for the page)");
+      return;
+  }
+
+  int len = snprintf(page, PERF_PAGE_SIZE,
+     "<html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
+     "<title>Performance</title></head><body>"
+     "<h2 align=center>Runtime, microseconds</h2>"
+     "<table width=100%% border=1><tr><th>Subsystem</th><th>Runs</th><th>Min</th><th>Avg</th>"
+     "<th>Max</th><th>&lt;16</th><th>&lt;64</th><th>&lt;256</th><th>&lt;1k</th>"
+     "<th>&lt;4k</th><th>&lt;16k</th><th>&lt;64k</th><th>more</th></tr>");
+
+  for (int i=0; i < PERF_COUNT && len < PERF_PAGE_SIZE-200; i++) {
+      perf_stat_t *sp = &Perf[i];
+      if (sp->count == 0)
+          continue;
+      len = page_printf(page, len, PERF_PAGE_SIZE,
+         "<tr><td>%s</td><td align=right>%u</td><td align=right>%u</td>"
+         "<td align=right>%u</td><td align=right>%u</td>",
+         Perf_name[i], (unsigned) sp->count, (unsigned) sp->min_us,
+         (unsigned) (sp->total_us / sp->count), (unsigned) sp->max_us);
+      for (int b=0; b < PERF_BUCKETS; b++)
+          len = page_printf(page, len, PERF_PAGE_SIZE,
+                            "<td align=right>%u</td>", (unsigned) sp->hist[b]);
+      len = page_printf(page, len, PERF_PAGE_SIZE, "</tr>");
+  }
+
+  len = page_printf(page, len, PERF_PAGE_SIZE,
+     "</table><h2 align=center>Scheduled tasks</h2>"
+     "<table width=100%% border=1><tr><th>Task</th><th>Runs</th><th>Avg</th><th>Max</th></tr>");
+  for (sched_task_t *tp = Sched_tasks(); tp != NULL && len < PERF_PAGE_SIZE-200; tp = tp->link) {
+      len = page_printf(page, len, PERF_PAGE_SIZE,
+         "<tr><td>%s</td><td align=right>%u</td><td align=right>%u</td><td align=right>%u</td></tr>",
+         tp->name, (unsigned) tp->runs,
+         (unsigned) (tp->runs ? tp->total_us / tp->runs : 0), (unsigned) tp->max_us);
+  }
+
+  page_printf(page, len, PERF_PAGE_SIZE,
+     "</table><p>Slept %u of %u ms</p>"
+     "<p align=center><input type=button onClick=\"location.href='/perf?reset=1'\" value='Reset'>"
+     "&nbsp;<input type=button onClick=\"location.href='/'\" value='Status'></p>"
+     "</body></html>",
+     (unsigned) Sched_slept_ms, (unsigned) millis());
+
+  SoC->swSer_enableRx(false);
+  server.sendHeader(String(F("Cache-Control")), String(F("no-cache, no-store, must-revalidate")));
+  server.send ( 200, "text/html", page );
+  SoC->swSer_enableRx(true);
+  free(page);
+}
+
+/* a table row is up to 320 bytes */
+#define LINKQ_PAGE_SIZE (1000 + 320 * LINKQ_SIZE)
+
+// reception per sender, since the last reset
+void handleLinkQ()
+{
+  if (server.hasArg("reset"))
+      LinkQ_reset();
+
+  char *page = (char *) malloc(LINKQ_PAGE_SIZE);
+  if (! page) {
+      server.send ( 200, "text/html", "(cannot allocate memory for the page)");
+      return;
+  }
+
+  int len = snprintf(page, LINKQ_PAGE_SIZE,
+     "<html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
+     "<title>Reception</title></head><body>"
+     "<h2 align=center>Reception per sender</h2>"
+     "<table width=100%% border=1><tr><th>Address</th><th>Protocol</th><th>Packets</th>"
+     "<th>FEC</th><th>Failed</th><th>Missed</th><th>Per 10 s</th><th>RSSI avg</th>"
+     "<th>RSSI max</th><th>Slot</th><th>Chan</th><th>Age, s</th></tr>");
+
+  uint32_t now_ms = millis();
+  for (int i=0; i < LINKQ_SIZE && len < LINKQ_PAGE_SIZE-320; i++) {
+      linkq_t *lp = &LinkQ[i];
+      if (lp->addr == 0)
+          continue;
+      len = page_printf(page, len, LINKQ_PAGE_SIZE,
+         "<tr><td>%06X</td><td>%s</td><td align=right>%u</td><td align=right>%u</td>"
+         "<td align=right>%u</td><td align=right>%u</td><td align=right>%u</td>"
+         "<td align=right>%d</td><td align=right>%d</td><td align=right>%d</td>"
+         "<td align=right>%d</td><td align=right>%u</td></tr>",
+         (unsigned) lp->addr, Protocol_ID[lp->protocol], (unsigned) lp->packets,
+         (unsigned) lp->fixed, (unsigned) lp->failed, (unsigned) lp->missed,
+         LinkQ_rate(lp), lp->rssi_avg / 16, lp->rssi_max, lp->slot, lp->chan,
+         (unsigned) ((now_ms - lp->last_ms) / 1000));
+  }
+
+  page_printf(page, len, LINKQ_PAGE_SIZE,
+     "</table><p>%u frames received, %u failed the CRC or the FEC, "
+     "%u of which from no sender listed</p>"
+     "<p align=center><input type=button onClick=\"location.href='/linkq?reset=1'\" value='Reset'>"
+     "&nbsp;<input type=button onClick=\"location.href='/'\" value='Status'></p>"
+     "</body></html>",
+     (unsigned) rx_packets_counter, (unsigned) rx_failed_frames,
+     (unsigned) LinkQ_unknown);
+
+  SoC->swSer_enableRx(false);
+  server.sendHeader(String(F("Cache-Control")), String(F("no-cache, no-store, must-revalidate")));
+  server.send ( 200, "text/html", page );
+  SoC->swSer_enableRx(true);
+  free(page);
+}
+
 void Web_setup()
 {
   server.on ( "/", handleRoot );
@@ -2281,6 +2440,9 @@ void Web_setup()
     reboot();
   } );
 
+  server.on ( "/perf", handlePerf );
+  server.on ( "/linkq", handleLinkQ );
+
   server.on ( "/about", []() {
     serve_P_html(about_html);
   } );
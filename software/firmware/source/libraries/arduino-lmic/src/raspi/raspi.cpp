@@ -14,6 +14,10 @@
 static uint64_t epochMilli ;
 static uint64_t epochMicro ;
 
+// Virtual clock for replays, millis()/micros() return it once set
+static bool     virtualClock = false ;
+static uint32_t virtualMilli = 0 ;
+
 SPIClass::SPIClass(uint8_t spi_bus)
     :_spi_num(spi_bus)
 {}
@@ -155,9 +159,16 @@ void initialiseEpoch() {
   digitalWrite(lmic_pins.nss, HIGH);
 }
 
+void setVirtualMillis(unsigned int ms) {
+  virtualMilli = ms ;
+  virtualClock = true ;
+}
+
 unsigned int millis() {
   struct timeval tv ;
   uint64_t now ;
+  if (virtualClock)
+    return virtualMilli ;
   gettimeofday (&tv, NULL) ;
   now  = (uint64_t)tv.tv_sec * (uint64_t)1000 + (uint64_t)(tv.tv_usec / 1000) ;
   return (uint32_t)(now - epochMilli) ;
@@ -166,6 +177,8 @@ unsigned int millis() {
 unsigned int micros() {
   struct timeval tv ;
   uint64_t now ;
+  if (virtualClock)
+    return virtualMilli * 1000 ;
   gettimeofday (&tv, NULL) ;
   now  = (uint64_t)tv.tv_sec * (uint64_t)1000000 + (uint64_t)tv.tv_usec ;
   return (uint32_t)(now - epochMicro) ;
@@ -244,6 +244,7 @@ unsigned char digitalRead(unsigned char) ;
 void          initialiseEpoch();
 unsigned int  millis();
 unsigned int  micros();
+void          setVirtualMillis(unsigned int);
 
 #ifdef __cplusplus
 }
@@ -44,6 +44,12 @@ void init_fec(void)
 
 int correct_adsb_frame(uint8_t *to, int *rs_errors)
 {
+    // A Basic UAT that arrived intact need not fail as a Long UAT first.
+    if ((to[0]>>3) == 0 && check_rs_char(rs_adsb_short, to) == 0) {
+        *rs_errors = 0;
+        return 1;
+    }
+
     // Try decoding as a Long UAT.
     // We rely on decode_rs_char not modifying the data if there were
     // uncorrectable errors.
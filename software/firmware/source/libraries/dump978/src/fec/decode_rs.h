@@ -79,15 +79,31 @@
   int syn_error, count;
 
   /* form the syndromes; i.e., evaluate data(x) at roots of g(x) */
-  for(i=0;i<NROOTS;i++)
-    s[i] = data[0];
+  {
+    /* Most blocks are codewords, and this is all the work done on them.
+     * The code parameters are read once: stores to data_t could alias
+     * them.  Root exponents are reduced up front, so a single conditional
+     * subtraction replaces MODNN in the loop.
+     */
+    const data_t *alpha_to = ALPHA_TO, *index_of = INDEX_OF;
+    const int nn = NN, nroots = NROOTS, len = NN-PAD;
+    int root_exp[NROOTS];
 
-  for(j=1;j<NN-PAD;j++){
-    for(i=0;i<NROOTS;i++){
-      if(s[i] == 0){
-	s[i] = data[j];
-      } else {
-	s[i] = data[j] ^ ALPHA_TO[MODNN(INDEX_OF[s[i]] + (FCR+i)*PRIM)];
+    for(i=0;i<nroots;i++){
+      root_exp[i] = MODNN((FCR+i)*PRIM);
+      s[i] = data[0];
+    }
+
+    for(j=1;j<len;j++){
+      data_t d = data[j];
+
+      for(i=0;i<nroots;i++){
+	if(s[i] == 0){
+	  s[i] = d;
+	} else {
+	  int x = index_of[s[i]] + root_exp[i];
+	  s[i] = d ^ alpha_to[x >= nn ? x - nn : x];
+	}
       }
     }
   }
@@ -215,27 +231,34 @@
   /* Find roots of the error+erasure locator polynomial by Chien search */
   memcpy(&reg[1],&lambda[1],NROOTS*sizeof(reg[0]));
   count = 0;		/* Number of roots of lambda(x) */
-  for (i = 1,k=IPRIM-1; i <= NN; i++,k = MODNN(k+IPRIM)) {
-    q = 1; /* lambda[0] is always 0 */
-    for (j = deg_lambda; j > 0; j--){
-      if (reg[j] != A0) {
-	reg[j] = MODNN(reg[j] + j);
-	q ^= ALPHA_TO[reg[j]];
+  {
+    /* as for the syndromes, reg[j] + j is below 2*NN */
+    const data_t *alpha_to = ALPHA_TO;
+    const int nn = NN;
+
+    for (i = 1,k=IPRIM-1; i <= nn; i++,k = MODNN(k+IPRIM)) {
+      q = 1; /* lambda[0] is always 0 */
+      for (j = deg_lambda; j > 0; j--){
+	if (reg[j] != A0) {
+	  int x = reg[j] + j;
+	  reg[j] = x >= nn ? x - nn : x;
+	  q ^= alpha_to[reg[j]];
+	}
       }
-    }
-    if (q != 0)
-      continue; /* Not a root */
-    /* store root (index-form) and error location number */
+      if (q != 0)
+	continue; /* Not a root */
+      /* store root (index-form) and error location number */
 #if DEBUG>=2
-    printf("count %d root %d loc %d\n",count,i,k);
+      printf("count %d root %d loc %d\n",count,i,k);
 #endif
-    root[count] = i;
-    loc[count] = k;
-    /* If we've already found max possible roots,
-     * abort the search to save time
-     */
-    if(++count == deg_lambda)
-      break;
+      root[count] = i;
+      loc[count] = k;
+      /* If we've already found max possible roots,
+       * abort the search to save time
+       */
+      if(++count == deg_lambda)
+	break;
+    }
   }
   if (deg_lambda != count) {
     /*
@@ -20,3 +20,30 @@ int decode_rs_char(void *p, data_t *data, int *eras_pos, int no_eras){
   
   return retval;
 }
+
+/* Returns 0 if data is a codeword, 1 otherwise, without decoding it.
+ * The syndromes are evaluated one root at a time, so a block with errors
+ * is usually told apart after the first.
+ */
+int check_rs_char(void *p, data_t *data){
+  struct rs *rs = (struct rs *)p;
+  const data_t *alpha_to = ALPHA_TO, *index_of = INDEX_OF;
+  const int nn = NN, len = NN-PAD;
+  int i, j;
+
+  for(i=0;i<NROOTS;i++){
+    int root_exp = MODNN((FCR+i)*PRIM);
+    data_t s = data[0];
+
+    for(j=1;j<len;j++){
+      if(s != 0){
+	int x = index_of[s] + root_exp;
+	s = alpha_to[x >= nn ? x - nn : x];
+      }
+      s ^= data[j];
+    }
+    if(s != 0)
+      return 1;
+  }
+  return 0;
+}
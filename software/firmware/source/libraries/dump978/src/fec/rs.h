@@ -9,6 +9,7 @@
 /* General purpose RS codec, 8-bit symbols */
 int decode_rs_char(void *rs,unsigned char *data,int *eras_pos,
                    int no_eras);
+int check_rs_char(void *rs,unsigned char *data);
 void *init_rs_char(int symsize,int gfpoly,
                    int fcr,int prim,int nroots,
                    int pad);
@@ -1,5 +1,19 @@
 #include "mode-s.h"
 
+// The preamble scan uses SSE2 or NEON when the compiler targets them. Build
+// with -DMODE_S_NO_SIMD to get the plain C version. aarch64 always has NEON;
+// 32-bit armhf needs -mfpu=neon-vfpv4, which the SoftRF Makefile adds on
+// CPUs that have it, and ARMv6 (Pi Zero/1) gets the plain C version.
+#if !defined(MODE_S_NO_SIMD)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MODE_S_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MODE_S_SIMD_NEON
+#endif
+#endif
+
 #define MODE_S_PREAMBLE_US 8       // microseconds
 #define MODE_S_LONG_MSG_BITS 112
 #define MODE_S_SHORT_MSG_BITS 56
@@ -10,6 +24,8 @@
 static uint16_t maglut[129*129*2];
 static int maglut_initialized = 0;
 
+static void syndrome_init(void);
+
 // =============================== Initialization ===========================
 
 void mode_s_init(mode_s_t *self) {
@@ -37,6 +53,8 @@ void mode_s_init(mode_s_t *self) {
     }
     maglut_initialized = 1;
   }
+
+  syndrome_init();
 }
 
 // ===================== Mode S detection and decoding  =====================
@@ -103,75 +121,162 @@ int mode_s_msg_len_by_type(int type) {
     return MODE_S_SHORT_MSG_BITS;
 }
 
-// Try to fix single bit errors using the checksum. On success modifies the
-// original buffer with the fixed version, and returns the position of the
-// error bit. Otherwise if fixing failed -1 is returned.
-int fix_single_bit_errors(unsigned char *msg, int bits) {
+// Error correction by syndrome.
+//
+// The syndrome of a message is the CRC field xored with the CRC computed over
+// the data bits: zero for a good message. The code is linear, so a message
+// damaged in bit j only has the syndrome of bit j - its checksum table entry
+// for a data bit, the bit itself for a bit of the CRC field - and a message
+// damaged in bits j and i has the xor of the two. Instead of flipping every
+// bit, or every pair of bits, and computing the checksum again, we look the
+// syndrome up in tables of all the single and two bit errors, sorted by
+// syndrome. Every single and two bit error of a 56 or 112 bit message has a
+// syndrome of its own, so a match is the only correction possible.
+typedef struct {
+  uint32_t syndrome;
+  uint8_t bit1;               // Bit in error.
+  uint8_t bit2;               // Second bit in error, for the pair tables.
+} mode_s_syndrome_t;
+
+#define MODE_S_SHORT_MSG_PAIRS (MODE_S_SHORT_MSG_BITS*(MODE_S_SHORT_MSG_BITS-1)/2)
+#define MODE_S_LONG_MSG_PAIRS (MODE_S_LONG_MSG_BITS*(MODE_S_LONG_MSG_BITS-1)/2)
+
+static mode_s_syndrome_t syndrome_short[MODE_S_SHORT_MSG_BITS];
+static mode_s_syndrome_t syndrome_long[MODE_S_LONG_MSG_BITS];
+static int syndrome_initialized = 0;
+
+// The two bit tables take about 60 KB and are only needed in Aggressive Mode,
+// so they are allocated the first time fix_two_bits_errors() is called.
+static mode_s_syndrome_t *syndrome_short_pairs = NULL;
+static mode_s_syndrome_t *syndrome_long_pairs = NULL;
+
+// Syndrome of an error in bit j of a message of the given length.
+static uint32_t bit_syndrome(int j, int bits) {
+  int offset = (bits == 112) ? 0 : (112-56);
+
+  if (j < bits-24)
+    return mode_s_checksum_table[j+offset];
+  else
+    return (uint32_t) 1 << (bits-1-j);
+}
+
+static uint32_t message_syndrome(unsigned char *msg, int bits) {
+  uint32_t crc = ((uint32_t)msg[(bits/8)-3] << 16) |
+                 ((uint32_t)msg[(bits/8)-2] << 8) |
+                  (uint32_t)msg[(bits/8)-1];
+  return crc ^ mode_s_checksum(msg, bits);
+}
+
+static int syndrome_cmp(const void *a, const void *b) {
+  const mode_s_syndrome_t *x = a, *y = b;
+
+  if (x->syndrome != y->syndrome)
+    return x->syndrome < y->syndrome ? -1 : 1;
+  return (x->bit1*256 + x->bit2) - (y->bit1*256 + y->bit2);
+}
+
+static void syndrome_build(mode_s_syndrome_t *table, int bits) {
   int j;
-  unsigned char aux[MODE_S_LONG_MSG_BITS/8];
 
   for (j = 0; j < bits; j++) {
-    int byte = j/8;
-    int bitmask = 1 << (7-(j%8));
-    uint32_t crc1, crc2;
-
-    memcpy(aux, msg, bits/8);
-    aux[byte] ^= bitmask; // Flip j-th bit.
+    table[j].syndrome = bit_syndrome(j, bits);
+    table[j].bit1 = j;
+    table[j].bit2 = 0;
+  }
+  qsort(table, bits, sizeof(mode_s_syndrome_t), syndrome_cmp);
+}
 
-    crc1 = ((uint32_t)aux[(bits/8)-3] << 16) |
-           ((uint32_t)aux[(bits/8)-2] << 8) |
-            (uint32_t)aux[(bits/8)-1];
-    crc2 = mode_s_checksum(aux, bits);
+static void syndrome_build_pairs(mode_s_syndrome_t *table, int bits) {
+  int j, i, n = 0;
 
-    if (crc1 == crc2) {
-      // The error is fixed. Overwrite the original buffer with the
-      // corrected sequence, and returns the error bit position.
-      memcpy(msg, aux, bits/8);
-      return j;
+  for (j = 0; j < bits; j++) {
+    for (i = j+1; i < bits; i++) {
+      table[n].syndrome = bit_syndrome(j, bits) ^ bit_syndrome(i, bits);
+      table[n].bit1 = j;
+      table[n].bit2 = i;
+      n++;
     }
   }
-  return -1;
+  qsort(table, n, sizeof(mode_s_syndrome_t), syndrome_cmp);
 }
 
-// Similar to fix_single_bit_errors() but try every possible two bit
-// combination. This is very slow and should be tried only against DF17
-// messages that don't pass the checksum, and only in Aggressive Mode.
-int fix_two_bits_errors(unsigned char *msg, int bits) {
-  int j, i;
-  unsigned char aux[MODE_S_LONG_MSG_BITS/8];
+static void syndrome_init(void) {
+  if (!syndrome_initialized) {
+    syndrome_build(syndrome_short, MODE_S_SHORT_MSG_BITS);
+    syndrome_build(syndrome_long, MODE_S_LONG_MSG_BITS);
+    syndrome_initialized = 1;
+  }
+}
 
-  for (j = 0; j < bits; j++) {
-    int byte1 = j/8;
-    int bitmask1 = 1 << (7-(j%8));
+// Binary search of a syndrome table. Returns NULL if there is no match.
+static const mode_s_syndrome_t *syndrome_find(const mode_s_syndrome_t *table,
+                                              int n, uint32_t syndrome) {
+  int lo = 0, hi = n;
+
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (table[mid].syndrome < syndrome)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return (lo < n && table[lo].syndrome == syndrome) ? &table[lo] : NULL;
+}
 
-    // Don't check the same pairs multiple times, so i starts from j+1
-    for (i = j+1; i < bits; i++) {
-      int byte2 = i/8;
-      int bitmask2 = 1 << (7-(i%8));
-      uint32_t crc1, crc2;
-
-      memcpy(aux, msg, bits/8);
-
-      aux[byte1] ^= bitmask1; // Flip j-th bit.
-      aux[byte2] ^= bitmask2; // Flip i-th bit.
-
-      crc1 = ((uint32_t)aux[(bits/8)-3] << 16) |
-             ((uint32_t)aux[(bits/8)-2] << 8) |
-              (uint32_t)aux[(bits/8)-1];
-      crc2 = mode_s_checksum(aux, bits);
-
-      if (crc1 == crc2) {
-        // The error is fixed. Overwrite the original buffer with the
-        // corrected sequence, and returns the error bit position.
-        memcpy(msg, aux, bits/8);
-        // We return the two bits as a 16 bit integer by shifting 'i'
-        // on the left. This is possible since 'i' will always be
-        // non-zero because i starts from j+1.
-        return j | (i<<8);
-      }
+// Try to fix single bit errors using the checksum. On success modifies the
+// original buffer with the fixed version, and returns the position of the
+// error bit. Otherwise if fixing failed -1 is returned.
+int fix_single_bit_errors(unsigned char *msg, int bits) {
+  const mode_s_syndrome_t *e;
+
+  if (bits == MODE_S_LONG_MSG_BITS)
+    e = syndrome_find(syndrome_long, MODE_S_LONG_MSG_BITS,
+                      message_syndrome(msg, bits));
+  else
+    e = syndrome_find(syndrome_short, MODE_S_SHORT_MSG_BITS,
+                      message_syndrome(msg, bits));
+  if (e == NULL)
+    return -1;
+
+  msg[e->bit1/8] ^= 1 << (7-(e->bit1%8));
+  return e->bit1;
+}
+
+// Similar to fix_single_bit_errors() but for two bit errors. Only try it
+// against DF17 messages that don't pass the checksum, and only in Aggressive
+// Mode: any of the 6216 pairs of a 112 bit message matches one random
+// syndrome in about 2700.
+int fix_two_bits_errors(unsigned char *msg, int bits) {
+  const mode_s_syndrome_t *e;
+
+  if (syndrome_long_pairs == NULL) {
+    syndrome_short_pairs = malloc(sizeof(mode_s_syndrome_t) * MODE_S_SHORT_MSG_PAIRS);
+    syndrome_long_pairs = malloc(sizeof(mode_s_syndrome_t) * MODE_S_LONG_MSG_PAIRS);
+    if (syndrome_short_pairs == NULL || syndrome_long_pairs == NULL) {
+      free(syndrome_short_pairs);
+      free(syndrome_long_pairs);
+      syndrome_short_pairs = syndrome_long_pairs = NULL;
+      return -1;
     }
+    syndrome_build_pairs(syndrome_short_pairs, MODE_S_SHORT_MSG_BITS);
+    syndrome_build_pairs(syndrome_long_pairs, MODE_S_LONG_MSG_BITS);
   }
-  return -1;
+
+  if (bits == MODE_S_LONG_MSG_BITS)
+    e = syndrome_find(syndrome_long_pairs, MODE_S_LONG_MSG_PAIRS,
+                      message_syndrome(msg, bits));
+  else
+    e = syndrome_find(syndrome_short_pairs, MODE_S_SHORT_MSG_PAIRS,
+                      message_syndrome(msg, bits));
+  if (e == NULL)
+    return -1;
+
+  msg[e->bit1/8] ^= 1 << (7-(e->bit1%8));
+  msg[e->bit2/8] ^= 1 << (7-(e->bit2%8));
+  // We return the two bits as a 16 bit integer by shifting the second one
+  // on the left. This is possible since it is never zero, being larger
+  // than the first.
+  return e->bit1 | (e->bit2<<8);
 }
 
 // Hash the ICAO address to index our cache of MODE_S_ICAO_CACHE_LEN elements,
@@ -556,6 +661,91 @@ void apply_phase_correction(uint16_t *mag) {
   }
 }
 
+// First check of relations between the first 10 samples representing a valid
+// preamble, see mode_s_detect(). Most samples fail it, so it is done for 8
+// samples at once where there is SIMD.
+static inline int preamble_shape(const uint16_t *m) {
+  return m[0] > m[1] &&
+         m[1] < m[2] &&
+         m[2] > m[3] &&
+         m[3] < m[0] &&
+         m[4] < m[0] &&
+         m[5] < m[0] &&
+         m[6] < m[0] &&
+         m[7] > m[8] &&
+         m[8] < m[9] &&
+         m[9] > m[6];
+}
+
+#if defined(MODE_S_SIMD_SSE2)
+// SSE2 only compares signed words: flip the sign bits to compare unsigned.
+#define SSE2_LOADU16(p) \
+  _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p)), _mm_set1_epi16(-0x8000))
+#endif
+
+// Return the first offset in [j, end) where preamble_shape() holds, or end.
+// Reads up to mag[end+8].
+static uint32_t preamble_scan(const uint16_t *mag, uint32_t j, uint32_t end) {
+#if defined(MODE_S_SIMD_SSE2)
+  for (; j + 8 <= end; j += 8) {
+    const uint16_t *m = mag + j;
+    __m128i m0 = SSE2_LOADU16(m),   m1 = SSE2_LOADU16(m+1);
+    __m128i m2 = SSE2_LOADU16(m+2), m3 = SSE2_LOADU16(m+3);
+    __m128i m4 = SSE2_LOADU16(m+4), m5 = SSE2_LOADU16(m+5);
+    __m128i m6 = SSE2_LOADU16(m+6), m7 = SSE2_LOADU16(m+7);
+    __m128i m8 = SSE2_LOADU16(m+8), m9 = SSE2_LOADU16(m+9);
+    __m128i ok;
+    int mask;
+
+    ok = _mm_and_si128(_mm_cmpgt_epi16(m0, m1), _mm_cmpgt_epi16(m2, m1));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m2, m3));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m0, m3));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m0, m4));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m0, m5));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m0, m6));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m7, m8));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m9, m8));
+    ok = _mm_and_si128(ok, _mm_cmpgt_epi16(m9, m6));
+
+    // Two mask bits per sample.
+    mask = _mm_movemask_epi8(ok);
+    if (mask)
+      return j + __builtin_ctz(mask) / 2;
+  }
+#elif defined(MODE_S_SIMD_NEON)
+  for (; j + 8 <= end; j += 8) {
+    const uint16_t *m = mag + j;
+    uint16x8_t m0 = vld1q_u16(m),   m1 = vld1q_u16(m+1);
+    uint16x8_t m2 = vld1q_u16(m+2), m3 = vld1q_u16(m+3);
+    uint16x8_t m4 = vld1q_u16(m+4), m5 = vld1q_u16(m+5);
+    uint16x8_t m6 = vld1q_u16(m+6), m7 = vld1q_u16(m+7);
+    uint16x8_t m8 = vld1q_u16(m+8), m9 = vld1q_u16(m+9);
+    uint16x8_t ok;
+    uint64_t mask;
+
+    ok = vandq_u16(vcgtq_u16(m0, m1), vcgtq_u16(m2, m1));
+    ok = vandq_u16(ok, vcgtq_u16(m2, m3));
+    ok = vandq_u16(ok, vcgtq_u16(m0, m3));
+    ok = vandq_u16(ok, vcgtq_u16(m0, m4));
+    ok = vandq_u16(ok, vcgtq_u16(m0, m5));
+    ok = vandq_u16(ok, vcgtq_u16(m0, m6));
+    ok = vandq_u16(ok, vcgtq_u16(m7, m8));
+    ok = vandq_u16(ok, vcgtq_u16(m9, m8));
+    ok = vandq_u16(ok, vcgtq_u16(m9, m6));
+
+    // Narrow to one byte per sample, lowest sample in the low byte.
+    mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(ok)), 0);
+    if (mask)
+      return j + __builtin_ctzll(mask) / 8;
+  }
+#endif
+  for (; j < end; j++) {
+    if (preamble_shape(mag + j))
+      return j;
+  }
+  return end;
+}
+
 // Detect a Mode S messages inside the magnitude buffer pointed by 'mag' and of
 // size 'maglen' bytes. Every detected Mode S message is convert it into a
 // stream of bits and passed to the function to display it.
@@ -563,7 +753,7 @@ void mode_s_detect(mode_s_t *self, uint16_t *mag, uint32_t maglen, mode_s_callba
   unsigned char bits[MODE_S_LONG_MSG_BITS];
   unsigned char msg[MODE_S_LONG_MSG_BITS/2];
   uint16_t aux[MODE_S_LONG_MSG_BITS*2];
-  uint32_t j;
+  uint32_t j, end = maglen - MODE_S_FULL_LEN*2;
   int use_correction = 0;
 
   // The Mode S preamble is made of impulses of 0.5 microseconds at the
@@ -588,28 +778,17 @@ void mode_s_detect(mode_s_t *self, uint16_t *mag, uint32_t maglen, mode_s_callba
   // 7   ------------------
   // 8   --
   // 9   -------------------
-  for (j = 0; j < maglen - MODE_S_FULL_LEN*2; j++) {
+  for (j = 0; j < end; j++) {
     int low, high, delta, i, errors;
     int good_message = 0;
 
     if (use_correction) goto good_preamble; // We already checked it.
 
-    // First check of relations between the first 10 samples representing a
-    // valid preamble. We don't even investigate further if this simple
-    // test is not passed.
-    if (!(mag[j] > mag[j+1] &&
-        mag[j+1] < mag[j+2] &&
-        mag[j+2] > mag[j+3] &&
-        mag[j+3] < mag[j] &&
-        mag[j+4] < mag[j] &&
-        mag[j+5] < mag[j] &&
-        mag[j+6] < mag[j] &&
-        mag[j+7] > mag[j+8] &&
-        mag[j+8] < mag[j+9] &&
-        mag[j+9] > mag[j+6]))
-    {
-      continue;
-    }
+    // Skip to the next sample that passes the first check of relations
+    // between the first 10 samples representing a valid preamble. We don't
+    // even investigate further if this simple test is not passed.
+    j = preamble_scan(mag, j, end);
+    if (j >= end) break;
 
     // The samples between the two spikes must be < than the average of the
     // high spikes level. We don't test bits too near to the high levels as
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <time.h>
+#include "mode-s.h"
+
+// Benchmark of the decoder on a synthetic 2 MS/s I/Q stream: noise with Mode S
+// frames at random offsets, some of them damaged in one or two bits. Reports
+// the time per second of signal of each stage, and a digest of the decoded
+// messages that does not depend on how they were found.
+
+#define MODE_S_SAMPLE_RATE 2000000
+#define MODE_S_FRAME_SAMPLES (2*(8+112))
+
+#define MODE_S_NOTUSED(V) ((void) V)
+
+uint32_t mode_s_checksum(unsigned char *msg, int bits);
+
+static uint32_t seed = 1;
+
+static uint32_t rnd(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int clamp(int v) {
+  return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// Small noise, roughly gaussian.
+static int noise(void) {
+  return (int)(rnd() % 5) + (int)(rnd() % 5) - 4;
+}
+
+// Build a DF17 or DF11 message with a good CRC, flip 'flips' bits of it.
+static int make_frame(unsigned char *msg, int flips) {
+  int bits = (rnd() & 1) ? 112 : 56;
+  uint32_t crc;
+  int j;
+
+  msg[0] = bits == 112 ? (17 << 3) | 5 : (11 << 3) | 5;
+  for (j = 1; j < bits/8 - 3; j++) msg[j] = rnd();
+  crc = mode_s_checksum(msg, bits);
+  msg[bits/8-3] = crc >> 16;
+  msg[bits/8-2] = crc >> 8;
+  msg[bits/8-1] = crc;
+
+  // Keep the downlink format, so that the length stays the same.
+  while (flips--) {
+    int b = 5 + rnd() % (bits - 5);
+    msg[b/8] ^= 1 << (7-(b%8));
+  }
+  return bits;
+}
+
+// Write the pulses of a frame, 2 samples per bit, at a random phase.
+static void put_frame(unsigned char *iq, unsigned char *msg, int bits) {
+  static const int preamble[16] = {1,0,1,0,0,0,0,1,0,1,0,0,0,0,0,0};
+  double phase = (rnd() % 628) / 100.0;
+  int a = 30 + rnd() % 90;
+  int ci = (int)(a * cos(phase)), cq = (int)(a * sin(phase));
+  int k;
+
+  for (k = 0; k < 16 + bits*2; k++) {
+    int on;
+
+    if (k < 16) {
+      on = preamble[k];
+    } else {
+      int b = (k-16)/2;
+      int one = (msg[b/8] >> (7-(b%8))) & 1;
+      on = ((k-16) & 1) ? !one : one;
+    }
+    if (on) {
+      iq[2*k] = clamp(127 + ci + noise());
+      iq[2*k+1] = clamp(127 + cq + noise());
+    }
+  }
+}
+
+static uint32_t digest = 2166136261u;
+static uint32_t delivered = 0;
+static uint32_t corrected = 0;
+
+static void fnv(const void *p, size_t n) {
+  const unsigned char *b = p;
+  while (n--) digest = (digest ^ *b++) * 16777619u;
+}
+
+static void on_msg(mode_s_t *self, struct mode_s_msg *mm) {
+  MODE_S_NOTUSED(self);
+  fnv(mm->msg, mm->msgbits/8);
+  fnv(&mm->errorbit, sizeof(mm->errorbit));
+  delivered++;
+  if (mm->errorbit != -1) corrected++;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+    "usage: bench [-s seconds] [-r frames/s] [-i iterations] [-a]\n"
+    "  -s  seconds of 2 MS/s signal (1)\n"
+    "  -r  frames per second, 1 in 4 with one bad bit, 1 in 8 with two (2000)\n"
+    "  -i  passes over the signal (10)\n"
+    "  -a  aggressive mode, corrects two bit errors of DF17\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  mode_s_t state;
+  int seconds = 1, rate = 2000, iterations = 10, aggressive = 0;
+  uint32_t samples, data_len, frames = 0, damaged[3] = {0}, pos;
+  unsigned char *data, msg[MODE_S_LONG_MSG_BYTES];
+  uint16_t *mag;
+  double t, t_mag = 0, t_detect = 0, t_decode;
+  int i, c;
+
+  while ((c = getopt(argc, argv, "s:r:i:a")) != -1) {
+    switch (c) {
+    case 's': seconds = atoi(optarg); break;
+    case 'r': rate = atoi(optarg); break;
+    case 'i': iterations = atoi(optarg); break;
+    case 'a': aggressive = 1; break;
+    default: usage();
+    }
+  }
+  if (seconds < 1 || rate < 0 || iterations < 1) usage();
+
+  samples = seconds * MODE_S_SAMPLE_RATE;
+  data_len = samples * 2;
+  if ((data = malloc(data_len)) == NULL ||
+    (mag = malloc(sizeof(uint16_t) * samples)) == NULL) {
+    fprintf(stderr, "Out of memory allocating data buffer.\n");
+    exit(1);
+  }
+
+  for (pos = 0; pos < data_len; pos++) data[pos] = clamp(127 + noise());
+
+  // Frames at random gaps, never overlapping.
+  pos = 0;
+  if (rate > 0) {
+    uint32_t gap = MODE_S_SAMPLE_RATE / rate;
+
+    while (1) {
+      int r = rnd() % 8, bits;
+
+      pos += MODE_S_FRAME_SAMPLES + 16 + rnd() % (gap > MODE_S_FRAME_SAMPLES ?
+                                                  2*(gap - MODE_S_FRAME_SAMPLES) : 1);
+      if (pos + MODE_S_FRAME_SAMPLES*2 >= samples) break;
+      c = r < 2 ? 1 : r == 2 ? 2 : 0;
+      bits = make_frame(msg, c);
+      damaged[c]++;
+      put_frame(data + 2*pos, msg, bits);
+      frames++;
+    }
+  }
+
+  mode_s_init(&state);
+  state.aggressive = aggressive;
+
+  for (i = 0; i < iterations; i++) {
+    digest = 2166136261u;
+    delivered = corrected = 0;
+
+    t = now_us();
+    mode_s_compute_magnitude_vector(data, mag, data_len);
+    t_mag += now_us() - t;
+
+    t = now_us();
+    mode_s_detect(&state, mag, samples, on_msg);
+    t_detect += now_us() - t;
+  }
+  t_mag /= iterations * seconds;
+  t_detect /= iterations * seconds;
+
+  printf("signal:  %d s, %u frames (%u damaged in 1 bit, %u in 2)\n",
+         seconds, frames, damaged[1], damaged[2]);
+  printf("magnitude: %8.0f us per second of signal\n", t_mag);
+  printf("detect:    %8.0f us per second of signal\n", t_detect);
+  printf("load:      %8.1f %% of real time at 2 MS/s\n",
+         (t_mag + t_detect) / 1e4);
+  printf("messages:  %u, %u corrected, digest %08x\n",
+         delivered, corrected, digest);
+
+  // CRC correction alone: decode damaged DF17 messages.
+  {
+    unsigned char bad[64][MODE_S_LONG_MSG_BYTES];
+    struct mode_s_msg mm;
+    int n = 100000, ok = 0;
+
+    for (i = 0; i < 64; i++) {
+      do {
+        c = make_frame(bad[i], 1 + (i & aggressive));
+      } while (c != 112);
+    }
+    t = now_us();
+    for (i = 0; i < n; i++) {
+      mode_s_decode(&state, &mm, bad[i & 63]);
+      ok += mm.crcok;
+    }
+    t_decode = (now_us() - t) / n;
+    printf("decode:    %8.2f us per damaged DF17, %d of %d corrected\n",
+           t_decode, ok, n);
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+
+'''
+    Cuts a regional geoid grid for SoftRF out of a GeographicLib geoid
+    model (egm96-5.pgm, egm2008-2_5.pgm, ... from
+    https://geographiclib.sourceforge.io/C++/doc/geoid.html).
+
+    geoid_grid.py egm96-5.pgm NORTH SOUTH WEST EAST GEOID.BIN
+
+    Degrees, south and west negative.  Copy the result to the root of the
+    SD card (ESP32), or pass it with -g (Raspberry Pi).  The file layout is
+    described in firmware/source/SoftRF/src/Geoid.h
+'''
+
+import sys
+import math
+import struct
+
+MAX_CELLS = 65536
+
+def read_pgm(name):
+    with open(name, 'rb') as f:
+        if f.readline().strip() != b'P5':
+            raise ValueError('not a binary PGM file')
+        offset, scale = 0.0, 1.0
+        while True:
+            line = f.readline().strip()
+            if line.startswith(b'#'):
+                words = line[1:].split()
+                if len(words) == 2 and words[0] == b'Offset':
+                    offset = float(words[1])
+                elif len(words) == 2 and words[0] == b'Scale':
+                    scale = float(words[1])
+                continue
+            width, height = map(int, line.split())
+            break
+        f.readline()                                # maxval
+        data = f.read()
+    return width, height, offset, scale, data
+
+def main():
+    if len(sys.argv) != 7:
+        sys.exit(__doc__)
+    pgm = sys.argv[1]
+    north, south, west, east = map(float, sys.argv[2:6])
+    out = sys.argv[6]
+
+    width, height, offset, scale, data = read_pgm(pgm)
+    step = 360.0 / width                            # rows from 90N, columns from 0E
+
+    r0 = int(math.floor((90.0 - north) / step))
+    r1 = int(math.ceil((90.0 - south) / step))
+    c0 = int(math.floor(west / step))
+    c1 = int(math.ceil(east / step))
+    rows, cols = r1 - r0 + 1, c1 - c0 + 1
+    if r0 < 0 or r1 >= height or rows < 2 or cols < 2:
+        sys.exit('bad region')
+    if rows * cols > MAX_CELLS:
+        sys.exit('region too large for the grid step, %d cells' % (rows * cols))
+
+    cm = []
+    for r in range(r0, r1 + 1):
+        for c in range(c0, c1 + 1):
+            i = 2 * (r * width + (c % width))
+            raw = (data[i] << 8) | data[i + 1]      # big-endian in the PGM
+            cm.append(int(round((offset + scale * raw) * 100)))
+
+    with open(out, 'wb') as f:
+        f.write(b'SRGD')
+        f.write(struct.pack('<iiiHH', int(round((90.0 - r0 * step) * 1e6)),
+                            int(round(c0 * step * 1e6)), int(round(step * 1e6)),
+                            rows, cols))
+        f.write(struct.pack('<%dh' % len(cm), *cm))
+
+    print('%d x %d cells, %.4f degree step, %d bytes' %
+          (rows, cols, step, 20 + 2 * len(cm)))
+
+if __name__ == '__main__':
+    main()
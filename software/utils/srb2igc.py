@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+
+'''
+    Converts a SoftRF binary flight recording (.SRB) to IGC and CSV.
+
+    srb2igc.py FLIGHT.SRB [-i out.igc] [-c out.csv]
+
+    The IGC file holds the own-ship fixes as B-records, the CSV file
+    one line per received packet and alarm decision.  Without options
+    both are written next to the input file.
+
+    The frame layout is in firmware/source/SoftRF/src/protocol/data/Recorder.h
+'''
+
+import sys
+import time
+import struct
+import argparse
+
+FRAME_SIZE = 24
+
+HEAD    = struct.Struct('<BBH')                     # type, info, dt
+HEADER  = struct.Struct('<4sIBBB9x')
+KEY     = struct.Struct('<Iiih6x')
+OWN     = struct.Struct('<hhhhHHHhhBB')
+TRAFFIC = struct.Struct('<3sBBBhhhHHhbb')
+
+TRAFFIC_TYPES = {ord('P'): 'packet', ord('A'): 'alarm', ord('N'): 'notify'}
+
+def frames(f):
+    while True:
+        buf = f.read(FRAME_SIZE)
+        if len(buf) < FRAME_SIZE:
+            return
+        yield HEAD.unpack_from(buf), buf[HEAD.size:]
+
+def igc_coord(value, pos, neg, width):
+    hemi = pos if value >= 0 else neg
+    value = abs(value)
+    deg = int(value)
+    mmin = int(round((value - deg) * 60000))
+    if mmin == 60000:
+        deg, mmin = deg + 1, 0
+    return '%0*d%05d%s' % (width, deg, mmin, hemi)
+
+def convert(src, igc, csv):
+    key_utc = None
+    lat = lon = 0
+    own = None
+    header = None
+    counts = {}
+
+    csv.write('time,type,alarm_level,count,addr,aircraft_type,protocol,flags,'
+              'dx,dy,dz,distance,speed,course,vs,turnrate,rssi,'
+              'own_lat,own_lon,own_alt,own_speed,own_course\n')
+
+    for (ftype, info, dt), body in frames(src):
+        counts[ftype] = counts.get(ftype, 0) + 1
+
+        if ftype == ord('H'):
+            magic, addr, actype, proto, alarm = HEADER.unpack(body)
+            if magic != b'SRB1':
+                raise ValueError('not a SoftRF recording')
+            header = (addr, actype, proto, alarm)
+            igc.write('AXSR%06X\r\n' % addr)
+            igc.write('HFFTYFRTYPE:SoftRF binary recorder\r\n')
+
+        elif ftype == ord('K'):
+            key_utc, lat, lon, geoid = KEY.unpack(body)
+            if counts[ftype] == 1:
+                igc.write('HFDTE%s\r\n' % time.strftime('%d%m%y', time.gmtime(key_utc)))
+
+        elif ftype == ord('O'):
+            if key_utc is None:
+                continue
+            (dlat, dlon, alt, palt, course, heading, speed, vs, turnrate,
+             wind_dir, wind_speed) = OWN.unpack(body)
+            lat += dlat
+            lon += dlon
+            t = key_utc + dt / 1000.0
+            own = (lat * 1e-7, lon * 1e-7, alt, speed / 10.0, course / 100.0)
+            igc.write('B%s%s%sA%05d%05d\r\n' % (
+                time.strftime('%H%M%S', time.gmtime(int(t))),
+                igc_coord(own[0], 'N', 'S', 2), igc_coord(own[1], 'E', 'W', 3),
+                max(palt, 0), max(alt, 0)))
+
+        elif ftype in TRAFFIC_TYPES:
+            if key_utc is None:
+                continue
+            (addr, actype, proto, flags, dx, dy, dz, speed, course, vs,
+             turnrate, rssi) = TRAFFIC.unpack(body)
+            addr = addr[0] | (addr[1] << 8) | (addr[2] << 16)
+            level, count = info & 0x0F, info >> 4
+            t = key_utc + dt / 1000.0
+            o = own or (0.0, 0.0, 0, 0.0, 0.0)
+            csv.write('%s.%03d,%s,%d,%d,%06X,%d,%d,%d,%d,%d,%d,%d,%.1f,%.2f,%d,%d,%d,'
+                      '%.6f,%.6f,%d,%.1f,%.2f\n' % (
+                time.strftime('%Y-%m-%dT%H:%M:%S', time.gmtime(int(t))),
+                int((t % 1) * 1000), TRAFFIC_TYPES[ftype], level, count,
+                addr, actype, proto, flags, dx, dy, dz,
+                int(round((dx * dx + dy * dy) ** 0.5)),
+                speed / 10.0, course / 100.0, vs, turnrate, rssi,
+                o[0], o[1], o[2], o[3], o[4]))
+
+    return counts
+
+def main():
+    parser = argparse.ArgumentParser(description='SoftRF .SRB to IGC and CSV')
+    parser.add_argument('srb')
+    parser.add_argument('-i', '--igc')
+    parser.add_argument('-c', '--csv')
+    args = parser.parse_args()
+
+    base = args.srb.rsplit('.', 1)[0]
+    igcname = args.igc or base + '.rec.igc'
+    csvname = args.csv or base + '.csv'
+
+    with open(args.srb, 'rb') as src, \
+         open(igcname, 'w', newline='') as igc, \
+         open(csvname, 'w') as csv:
+        counts = convert(src, igc, csv)
+
+    print(', '.join('%s: %d' % (chr(t), n) for t, n in sorted(counts.items())))
+
+if __name__ == '__main__':
+    main()